@@ -87,7 +87,8 @@ bool Arbiter::verifyKeys(const MerkleProof* proof) {
 		// 2. hash them
 		hashedBlocks[i] = proof->getPTContract()->hash(decryptedBlocks[i]);
 		// 3. check if they match the public plaintext hashes
-		validDecryption = hashedBlocks[i] == proof->getPTextProof()[i][0].node;
+		validDecryption = Digest::fromHash(hashedBlocks[i]) == 
+						  proof->getPTextProof()[i][0].node;
 		i++;
 	} while(validDecryption && i < cTextBlocks.size());
 
@@ -115,7 +116,8 @@ bool Arbiter::verifyDecryption(const MerkleProof* proof){
 		decryptedBlocks[i] = cTextBlocks[i]->decrypt(keys[index], 
 													 contract.getEncAlgA());
 		hashedBlocks[i] = proof->getCTContract()->hash(decryptedBlocks[i]);
-		validDecryption = hashedBlocks[i] == proof->getPTextProof()[i][0].node;
+		validDecryption = Digest::fromHash(hashedBlocks[i]) == 
+						  proof->getPTextProof()[i][0].node;
 		i++;
 	} while(validDecryption && i < cTextBlocks.size());
 
@@ -0,0 +1,62 @@
+#include "AtomicFile.h"
+#include "CashException.h"
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+AtomicFile::AtomicFile(const string &fname, const string &who)
+	: fname(fname), tmpName(fname + ".tmp"), who(who), fd(-1)
+{
+	fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		fail("Could not open", tmpName);
+}
+
+AtomicFile::~AtomicFile() {
+	if (fd >= 0) {
+		::close(fd);
+		unlink(tmpName.c_str());
+	}
+}
+
+void AtomicFile::write(const void *data, size_t bytes) {
+	const char *p = (const char*) data;
+	while (bytes > 0) {
+		ssize_t n = ::write(fd, p, bytes);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			fail("Could not write", tmpName);
+		p += n;
+		bytes -= n;
+	}
+}
+
+void AtomicFile::commit() {
+	if (fsync(fd) != 0)
+		fail("Could not sync", tmpName);
+	int closed = ::close(fd);
+	fd = -1;
+	if (closed != 0 || rename(tmpName.c_str(), fname.c_str()) != 0) {
+		unlink(tmpName.c_str());
+		fail("Could not write", fname);
+	}
+
+	// the rename is only durable once the directory entry is on disk
+	size_t slash = fname.rfind('/');
+	string dir = slash == string::npos ? "." :
+				 slash == 0 ? "/" : fname.substr(0, slash);
+	int dfd = open(dir.c_str(), O_RDONLY);
+	if (dfd < 0)
+		fail("Could not open", dir);
+	int synced = fsync(dfd);
+	::close(dfd);
+	if (synced != 0)
+		fail("Could not sync", dir);
+}
+
+void AtomicFile::fail(const char *what, const string &name) {
+	throw CashException(CashException::CE_IO_ERROR, "[%s] %s %s",
+						who.c_str(), what, name.c_str());
+}
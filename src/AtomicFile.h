@@ -0,0 +1,37 @@
+#ifndef _ATOMICFILE_H_
+#define _ATOMICFILE_H_
+
+#include <string>
+#include <boost/noncopyable.hpp>
+
+using namespace std;
+
+/*! \brief Replaces a file all at once: data is written to fname.tmp,
+ * which commit() flushes to disk and then renames over fname.
+ *
+ * Readers (and a process restarting after a crash or power loss) see
+ * either the old file or the complete new one, never a half-written one.
+ * If commit() is never reached, the temporary file is removed.
+ */
+class AtomicFile : private boost::noncopyable {
+	public:
+		/*! opens fname.tmp; who prefixes error messages, e.g.
+		 * "BloomFilter::save" */
+		AtomicFile(const string &fname, const string &who);
+		~AtomicFile();
+
+		void write(const void *data, size_t bytes);
+		void write(const string &data) { write(data.data(), data.size()); }
+
+		/*! syncs the temporary file, renames it to fname and syncs the
+		 * directory, so the rename itself survives a power loss */
+		void commit();
+
+	private:
+		void fail(const char *what, const string &name);
+
+		string fname, tmpName, who;
+		int fd;
+};
+
+#endif /*_ATOMICFILE_H_*/
@@ -1,6 +1,10 @@
 		
 #include "BankTool.h"
 #include "ZKP/InterpreterVerifier.h"
+#include "CLSignatureVerifier.h"
+#include "ThreadPool.h"
+#include <boost/bind.hpp>
+#include <algorithm>
 
 BankTool::BankTool(int st, int l, int modLen, const hashalg_t &ha, 
 				   vector<int> &coinDenoms)
@@ -72,6 +76,76 @@ bool BankTool::verifyCoin(const Coin &coin) const {
 	return coin.verifyCoin();
 }
 
+vector<bool> BankTool::verifyCoins(const vector<Coin> &coins) const {
+	vector<char> ok(coins.size(), 0);
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	// a few slices per thread, so the pool can balance them; every slice
+	// sets up its own verifiers (which are cache hits after the first)
+	size_t parts = pool ? min(coins.size(), (size_t) pool->size() * 4) : 1;
+	ThreadPool::task_t slice = boost::bind(&BankTool::verifyCoinSlice, this,
+										   &coins, &ok, parts, _1);
+	if (pool)
+		pool->parallelFor(parts, slice);
+	else if (!coins.empty())
+		slice(0);
+	return vector<bool>(ok.begin(), ok.end());
+}
+
+void BankTool::verifyCoinSlice(const vector<Coin> *coins, vector<char> *ok,
+							   size_t parts, size_t part) const {
+	size_t begin = coins->size() * part / parts;
+	size_t end = coins->size() * (part + 1) / parts;
+	if (begin == end)
+		return;
+
+	// S and T are formed correctly: the cash group has prime order, so
+	// the slice's proofs are verified as one batch, each for its own R
+	InterpreterVerifier verifier;
+	group_map cashG;
+	cashG["cashGroup"] = bankParameters->getCashGroup();
+	verifier.check(CommonFunctions::getZKPDir()+"/ecash.txt", cashG);
+	vector<ProofMessage> proofs;
+	vector<variable_map> perCoin(end - begin);
+	for (size_t i = begin; i < end; i++) {
+		proofs.push_back((*coins)[i].getCoinProof());
+		perCoin[i - begin]["R"] = (*coins)[i].getR();
+	}
+	vector<bool> cashOK = verifier.verifyBatch(variable_map(), perCoin, 
+											   proofs, stat);
+	for (size_t i = begin; i < end; i++)
+		(*ok)[i] = cashOK[i - begin];
+
+	// the CL signatures, one verifier (bank key) per denomination
+	map<int, vector<size_t> > byDenom;
+	for (size_t i = begin; i < end; i++)
+		byDenom[(*coins)[i].getDenom()].push_back(i);
+	const vector<int> denoms = bankParameters->getDenominations();
+	for (map<int, vector<size_t> >::const_iterator it = byDenom.begin();
+		 it != byDenom.end(); ++it) {
+		const vector<size_t> &which = it->second;
+		// not one of our denominations: these coins are bad
+		if (find(denoms.begin(), denoms.end(), it->first) == denoms.end()) {
+			for (unsigned k = 0; k < which.size(); k++)
+				(*ok)[which[k]] = false;
+			continue;
+		}
+		CLSignatureVerifier clVerifier(bankParameters->getBankKey(it->first),
+									   bankParameters->getCashGroup(), lx,
+									   vector<ZZ>(), 3, 1);
+		for (unsigned k = 0; k < which.size(); k++) {
+			const Coin &coin = (*coins)[which[k]];
+			if (!(*ok)[which[k]])
+				continue;
+			vector<ZZ> coms;
+			coms.push_back(coin.getB());
+			coms.push_back(coin.getSCommitment());
+			coms.push_back(coin.getTCommitment());
+			(*ok)[which[k]] = clVerifier.verify(&coin.getCLProof(), coms, 
+												stat);
+		}
+	}
+}
+
 bool BankTool::isCoinDoubleSpent(const Coin &coin1, const Coin &coin2) const {
 	// throw an exception if these coins do not share the same S value
 	if(coin1.getSPrime() != coin2.getSPrime())
@@ -114,3 +188,18 @@ ZZ BankTool::identifyDoubleSpender(const Coin& coin1, const ZZ &tPrime2,
 ZZ BankTool::identifyDoubleSpender(const Coin& coin1, const Coin& coin2) const {
     return identifyDoubleSpender(coin1, coin2.getTPrime(), coin2.getR());
 }
+
+BankTool::deposit_status BankTool::depositCoin(const Coin &coin, 
+											   SpentCoinDB &db,
+											   ZZ &cheater) const {
+	SpentCoinDB::Spend previous;
+	if (db.insert(SpentCoinDB::serialKey(coin.getSPrime()),
+				  SpentCoinDB::Spend(coin.getTPrime(), coin.getR()), previous))
+		return DEPOSIT_OK;
+	// same R means the same transaction, so the merchant is just
+	// depositing twice
+	if (previous.r == coin.getR())
+		return DEPOSIT_REPEATED;
+	cheater = identifyDoubleSpender(coin, previous.tPrime, previous.r);
+	return DEPOSIT_DOUBLE_SPENT;
+}
@@ -5,6 +5,7 @@
 #include "BankWithdrawTool.h"
 #include "Wallet.h"
 #include "BankParameters.h"
+#include "SpentCoinDB.h"
 
 class BankTool {
 	public:
@@ -49,6 +50,15 @@ class BankTool {
 		/*! Returns true if a coin is formed correctly */
 		bool verifyCoin(const Coin &coin) const;
 
+		/*! Returns, for every coin, true if it is formed correctly.  The
+		 * coins are split up over the shared ThreadPool (if there is one),
+		 * and each part checks its programs once (per denomination).  It
+		 * verifies its coins' proofs about S and T as one batch (see
+		 * InterpreterVerifier::verifyBatch), and their CL proofs one by
+		 * one, since those are in an RSA group, where batching can't be
+		 * made sound. */
+		vector<bool> verifyCoins(const vector<Coin> &coins) const;
+
 		/*! Returns true if coin is double spent, false if merchant is just
 		 * trying to deposit twice. */
 		bool isCoinDoubleSpent(const Coin &coin, const Coin &coin2) const;
@@ -59,7 +69,22 @@ class BankTool {
 		ZZ identifyDoubleSpender(const Coin& coin1, const ZZ& t2,
 								 const ZZ& r2) const;
 
+		enum deposit_status { DEPOSIT_OK, DEPOSIT_REPEATED, 
+							  DEPOSIT_DOUBLE_SPENT };
+
+		/*! Records coin (which should already be verified) in db.  Returns
+		 * DEPOSIT_OK for a coin not seen before, DEPOSIT_REPEATED if the
+		 * same spend was deposited before, and DEPOSIT_DOUBLE_SPENT if the
+		 * coin was spent twice, setting cheater to the public key of the
+		 * user who withdrew it. */
+		deposit_status depositCoin(const Coin &coin, SpentCoinDB &db,
+								   ZZ &cheater) const;
+
 	private:
+		/*! verifies the part-th of parts equal slices of coins */
+		void verifyCoinSlice(const vector<Coin> *coins, vector<char> *ok,
+							 size_t parts, size_t part) const;
+
 		int stat, lx;
 		hashalg_t hashAlg;
 		BankParameters* bankParameters;
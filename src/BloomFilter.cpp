@@ -0,0 +1,145 @@
+#include "BloomFilter.h"
+#include "CashException.h"
+#include "AtomicFile.h"
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BLOOMFILTER_MAGIC "CASHBLMF"
+// bits in a block, which is a cache line
+#define BLOCK_BITS 512
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+// extra bits per key making up for the accuracy lost to blocking
+#define BLOCKING_OVERHEAD 1.2
+#define MAX_HASHES 16
+
+struct file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t k;
+	uint64_t blocks;
+	uint64_t items;
+	uint64_t maxItems;
+};
+
+// FNV-1a, then a 64-bit finalizer (from MurmurHash3) to spread the bits
+static uint64_t mix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static uint64_t hashKey(const string &key) {
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < key.size(); i++) {
+		h ^= (unsigned char) key[i];
+		h *= 1099511628211ULL;
+	}
+	return mix(h);
+}
+
+BloomFilter::BloomFilter(size_t n, double fpRate)
+	: items(0), maxItems(max(n, (size_t) 1))
+{
+	if (fpRate <= 0 || fpRate >= 1)
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[BloomFilter] False positive rate must be between 0 and 1");
+	double bitsPerItem = -log(fpRate) / (M_LN2 * M_LN2);
+	k = max(1, min(MAX_HASHES, (int) floor(bitsPerItem * M_LN2 + 0.5)));
+	double total = ceil(bitsPerItem * BLOCKING_OVERHEAD * maxItems);
+	blocks = max((size_t) 1, (size_t) ceil(total / BLOCK_BITS));
+	allocate();
+}
+
+void BloomFilter::allocate() {
+	storage.assign(blocks * BLOCK_WORDS + BLOCK_WORDS - 1, 0);
+	uintptr_t p = (uintptr_t) &storage[0];
+	bits = (uint64_t*) ((p + BLOCK_BITS / 8 - 1) / (BLOCK_BITS / 8) *
+						(BLOCK_BITS / 8));
+}
+
+size_t BloomFilter::sizeInBytes() const {
+	return blocks * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+BloomFilter::BloomFilter(const string &fname) {
+	ifstream in(fname.c_str(), ios::in | ios::binary);
+	file_header h;
+	if (!in || !in.read((char*) &h, sizeof(h)) ||
+		memcmp(h.magic, BLOOMFILTER_MAGIC, sizeof(h.magic)) != 0)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[BloomFilter] Could not read %s", fname.c_str());
+	if (h.version != VERSION)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[BloomFilter] %s has version %u, expected %u", fname.c_str(),
+			h.version, VERSION);
+	// don't trust the header: a bad k or block count would make every
+	// lookup read out of bounds, or the allocation fail
+	in.seekg(0, ios::end);
+	uint64_t dataBytes = (uint64_t) in.tellg() - sizeof(h);
+	if (h.k < 1 || h.k > MAX_HASHES || h.blocks == 0 ||
+		dataBytes % (BLOCK_BITS / 8) != 0 ||
+		h.blocks != dataBytes / (BLOCK_BITS / 8))
+		throw CashException(CashException::CE_IO_ERROR,
+			"[BloomFilter] %s has a bad header or is truncated", 
+			fname.c_str());
+	k = h.k;
+	blocks = h.blocks;
+	items = h.items;
+	maxItems = h.maxItems;
+	allocate();
+	in.seekg(sizeof(h));
+	if (!in.read((char*) bits, sizeInBytes()))
+		throw CashException(CashException::CE_IO_ERROR,
+			"[BloomFilter] Could not read %s", fname.c_str());
+}
+
+void BloomFilter::save(const string &fname) const {
+	file_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, BLOOMFILTER_MAGIC, sizeof(h.magic));
+	h.version = VERSION;
+	h.k = k;
+	h.blocks = blocks;
+	h.items = items;
+	h.maxItems = maxItems;
+
+	// a crash never leaves a half-written filter behind
+	AtomicFile out(fname, "BloomFilter::save");
+	out.write(&h, sizeof(h));
+	out.write(bits, sizeInBytes());
+	out.commit();
+}
+
+size_t BloomFilter::locate(const string &key, uint64_t &h1,
+						   uint64_t &h2) const {
+	uint64_t h = hashKey(key);
+	h1 = h;
+	h2 = mix(h ^ 0x9e3779b97f4a7c15ULL) | 1;
+	return (size_t) (mix(h + blocks) % blocks) * BLOCK_WORDS;
+}
+
+void BloomFilter::add(const string &key) {
+	uint64_t h1, h2;
+	uint64_t *block = bits + locate(key, h1, h2);
+	for (unsigned i = 0; i < k; i++, h1 += h2) {
+		unsigned b = h1 % BLOCK_BITS;
+		block[b / 64] |= 1ULL << (b % 64);
+	}
+	items++;
+}
+
+bool BloomFilter::mightContain(const string &key) const {
+	uint64_t h1, h2;
+	const uint64_t *block = bits + locate(key, h1, h2);
+	for (unsigned i = 0; i < k; i++, h1 += h2) {
+		unsigned b = h1 % BLOCK_BITS;
+		if (!(block[b / 64] & (1ULL << (b % 64))))
+			return false;
+	}
+	return true;
+}
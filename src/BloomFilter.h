@@ -0,0 +1,67 @@
+#ifndef _BLOOMFILTER_H_
+#define _BLOOMFILTER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+using namespace std;
+
+/*! \brief A Bloom filter over byte-string keys: it answers either
+ * "definitely not added" or "maybe added", with false positives at
+ * (about) the rate it was sized for.
+ *
+ * The filter is blocked: every key sets all of its bits within a single
+ * 64-byte block, so a query reads one cache line no matter how many bits
+ * it checks.  That costs a little accuracy over a classic Bloom filter,
+ * which the sizing makes up for with slightly more bits per key.  At a 1%
+ * false positive rate that is about 1.4 bytes per key, so tens of
+ * millions of keys fit in a few tens of megabytes.
+ *
+ * Keys are expected to be digests, but any strings work.  The filter does
+ * no locking: adding keys while other threads query it is not safe.
+ */
+class BloomFilter : private boost::noncopyable {
+	public:
+		static const unsigned VERSION = 1;
+
+		/*! an empty filter for up to items keys with false positive rate
+		 * fpRate (which is exceeded once more keys are added) */
+		BloomFilter(size_t items = 1, double fpRate = 0.01);
+
+		/*! loads a filter written by save() */
+		BloomFilter(const string &fname);
+
+		void add(const string &key);
+
+		/*! false only if key was never added */
+		bool mightContain(const string &key) const;
+
+		/*! writes the filter to fname */
+		void save(const string &fname) const;
+
+		/*! number of keys added */
+		size_t size() const { return items; }
+		/*! number of keys the filter was sized for */
+		size_t capacity() const { return maxItems; }
+		/*! bytes of filter data */
+		size_t sizeInBytes() const;
+		unsigned numHashes() const { return k; }
+
+	private:
+		/*! the first word of key's block, and the two hashes its bits
+		 * within the block are taken from */
+		size_t locate(const string &key, uint64_t &h1, uint64_t &h2) const;
+		/*! sets up cleared, cache-line aligned bits for blocks */
+		void allocate();
+
+		unsigned k;
+		size_t blocks;
+		size_t items;
+		size_t maxItems;
+		vector<uint64_t> storage;
+		uint64_t *bits; // in storage, aligned to a block
+};
+
+#endif /*_BLOOMFILTER_H_*/
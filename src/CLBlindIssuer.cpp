@@ -47,8 +47,8 @@ CLBlindIssuer::CLBlindIssuer(const GroupRSA* sk, int lx, int numPrivates,
 	for (unsigned i = 0; i < coms.size(); i++) {
 		v["c_"+lexical_cast<string>(i+1)] = coms[i].comValue;
 	}
-	string fname = ProgramMaker::makeCLObtain(pMap, coms);
-	verifier.check(fname, inputs, g);
+	string program = ProgramMaker::makeCLObtain(pMap, coms);
+	verifier.checkSource(program, inputs, g);
 }
 
 CLBlindIssuer::CLBlindIssuer(const CLBlindIssuer &o) 
@@ -52,10 +52,10 @@ CLBlindRecipient::CLBlindRecipient(const GroupRSA* pk, int lx, int numPrivates,
 		v["c_"+lexical_cast<string>(i+1)] = coms[i].comValue;
 	}
 	
-	string fname = ProgramMaker::makeCLObtain(pMap, coms);
+	string program = ProgramMaker::makeCLObtain(pMap, coms);
 	inputs["l"] = to_ZZ(numPrivates);
 	inputs["k"] = to_ZZ(numPublics);
-	prover.check(fname, inputs, g);
+	prover.checkSource(program, inputs, g);
 }
 
 ProofMessage* CLBlindRecipient::getC(const vector<SecretValue>& privates,
@@ -48,10 +48,10 @@ CLSignatureProver::CLSignatureProver(const GroupRSA* pk, int lx,
 	for (unsigned i = 0; i < coms.size(); i++) {
 		v["c_"+lexical_cast<string>(i+1)] = coms[i].comValue;
 	}
-	string fname = ProgramMaker::makeCLProve(pMap, coms);
+	string program = ProgramMaker::makeCLProve(pMap, coms);
 	inputs["l"] = numPrivates;
 	inputs["k"] = numPublics;
-	prover.check(fname, inputs, g);
+	prover.checkSource(program, inputs, g);
 }
 
 ProofMessage* CLSignatureProver::getProof(const vector<ZZ>& sig, 
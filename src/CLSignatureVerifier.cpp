@@ -45,8 +45,8 @@ CLSignatureVerifier::CLSignatureVerifier(const GroupRSA* pk, int lx,
 	for (unsigned i = 0; i < coms.size(); i++) {
 		v["c_"+lexical_cast<string>(i+1)] = coms[i].comValue;
 	}
-	string fname = ProgramMaker::makeCLProve(pMap, coms);
-	verifier.check(fname, inputs);
+	string program = ProgramMaker::makeCLProve(pMap, coms);
+	verifier.checkSource(program, inputs);
 }	
 
 bool CLSignatureVerifier::verify(const ProofMessage* pm, int stat) {
@@ -57,3 +57,16 @@ bool CLSignatureVerifier::verify(const ProofMessage* pm, int stat) {
 	return verifier.verify(proof, stat);
 }
 
+bool CLSignatureVerifier::verify(const ProofMessage* pm, 
+								 const vector<ZZ> &coms, int stat) const {
+	// the commitments are verifier inputs (never publics, which the
+	// prover's own commitments would override), and each proof starts
+	// from the checked program
+	variable_map vars = v;
+	for (unsigned i = 0; i < coms.size(); i++) {
+		vars["c_"+lexical_cast<string>(i+1)] = coms[i];
+	}
+	InterpreterVerifier single(verifier);
+	single.compute(vars, pm->proof.getCommitments(), pm->publics, g);
+	return single.verify(pm->proof, stat);
+}
@@ -18,6 +18,12 @@ class CLSignatureVerifier {
 		/*! checks to see if a signature composed of A, e, and v is valid */
 		bool verify(const ProofMessage* pm, int stat);
 
+		/*! as above, but with coms as the commitments, replacing any
+		 * given to the constructor; unlike verify(pm, stat), this can be
+		 * called for any number of proofs */
+		bool verify(const ProofMessage* pm, const vector<ZZ> &coms, 
+					int stat) const;
+
 	private:
 		group_map g;
 		variable_map v;
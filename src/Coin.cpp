@@ -6,28 +6,32 @@
 #include "CLSignatureProver.h"
 #include "CLSignatureVerifier.h"
 #include "Timer.h"
+#include <NTL/Scratch.h>
+
+// the values computed by ecash.txt that don't depend on R
+static const char* preparedValues[] = { "r_B", "r_C", "r_D", "x1", "x2", 
+										"r_y", "alpha", "beta", "B", "C", 
+										"D", "y", "S" };
 
 Coin::Coin(const BankParameters* params, int wSize, int index,
 		   const ZZ &skIn, const ZZ &sIn, const ZZ &tIn, 
 		   const vector<ZZ> &clSig, int st, int l, 
-		   const ZZ &rVal, int denom, const hashalg_t &ha) 
+		   const ZZ &rVal, int denom, const hashalg_t &ha,
+		   const PreparedCoin *prepared) 
 	: stat(st), lx(l), coinDenom(denom), parameters(params), walletSize(wSize), 
 	  coinIndex(index), sk_u(skIn), s(sIn), t(tIn), R(rVal), hashAlg(ha), 
 	  signature(clSig)
 {  
+	if (prepared && prepared->coinIndex != index)
+		throw CashException(CashException::CE_UNKNOWN_ERROR,
+			"[Coin] Coin was prepared for index %d, not %d", 
+			prepared->coinIndex, index);
+
 	// first do all the stuff to prove S and T are correctly formed
-	group_map g;
-	variable_map v;
-	g["cashGroup"] = parameters->getCashGroup();
-	v["sk_u"] = sk_u;
-	v["s"] = s;
-	v["t"] = t;
-	v["J"] = coinIndex;
-	
 	InterpreterProver prover;
-	prover.check(CommonFunctions::getZKPDir()+"/ecash.txt", g);
-	prover.compute(v);
-	Environment env = prover.getEnvironment();
+	Environment env = computeCoin(prover, parameters, coinIndex, sk_u, s, t,
+								  R, prepared ? prepared->values : 
+											  variable_map());
 
 	// want to store all commitments
 	B = env.getCommitmentValue("sk_u");
@@ -41,31 +45,85 @@ Coin::Coin(const BankParameters* params, int wSize, int index,
 	endorsement.push_back(env.variables.at("x2"));
 	endorsement.push_back(env.variables.at("r_y"));
 
-	coinProof = ProofMessage(prover.getPublicVariables(), 
+	// a prepared proof only has to be finished for the relation of T
+	coinProof = ProofMessage(prover.getPublicVariables(), prepared ?
+							 prover.computeProof(hashAlg, prepared->proof) :
 		   					 prover.computeProof(hashAlg));
 
-	// now need to do CL stuff
+	// the CL proof only involves B, C and D, so a prepared one is as good
+	if (prepared)
+		clProof = prepared->clProof;
+	else
+		clProof = proveSignature(env, parameters, walletSize, sk_u, s, t,
+								 signature, lx, coinDenom, hashAlg);
+}
+
+PreparedCoin Coin::prepare(const BankParameters* params, int wSize, 
+						   int index, const ZZ &skIn, const ZZ &sIn, 
+						   const ZZ &tIn, const vector<ZZ> &clSig, int l, 
+						   int denom, const hashalg_t &ha) {
+	// T (and so the relation for T in the proof) has to wait for R, but
+	// computing the coin now fixes the randomness, and everything else
+	// with it; the T computed here, and what the proof prepares for its
+	// relation, is thrown away, so any R will do
+	InterpreterProver prover;
+	Environment env = computeCoin(prover, params, index, skIn, sIn, tIn,
+								  to_ZZ(0), variable_map());
+	PreparedCoin p;
+	p.coinIndex = index;
+	for (unsigned i = 0; i < sizeof(preparedValues) / sizeof(char*); i++)
+		p.values[preparedValues[i]] = env.variables.at(preparedValues[i]);
+	p.proof = prover.prepareProof();
+	p.clProof = proveSignature(env, params, wSize, skIn, sIn, tIn, clSig, l,
+							   denom, ha);
+	return p;
+}
+
+Environment Coin::computeCoin(InterpreterProver &prover, 
+							  const BankParameters* params, int index, 
+							  const ZZ &skIn, const ZZ &sIn, const ZZ &tIn,
+							  const ZZ &rVal, const variable_map &known) {
+	group_map g;
+	variable_map v;
+	g["cashGroup"] = params->getCashGroup();
+	v["sk_u"] = skIn;
+	v["s"] = sIn;
+	v["t"] = tIn;
+	v["J"] = index;
+	v["R"] = rVal;
+	
+	prover.check(CommonFunctions::getZKPDir()+"/ecash.txt", g);
+	prover.compute(v, known);
+	return prover.getEnvironment();
+}
+
+ProofMessage Coin::proveSignature(const Environment &env, 
+								  const BankParameters* params, int wSize,
+								  const ZZ &skIn, const ZZ &sIn, 
+								  const ZZ &tIn, const vector<ZZ> &clSig, 
+								  int l, int denom, const hashalg_t &ha) {
 	// public message is the wallet size W
 	// secret messages are sk_u, s, and t
-	const GroupRSA* pk = parameters->getBankKey(coinDenom);
-	const GroupPrime* comGroup = parameters->getCashGroup();
+	const GroupRSA* pk = params->getBankKey(denom);
+	const GroupPrime* comGroup = params->getCashGroup();
 	vector<ZZ> coms;
-	coms.push_back(B);
-	coms.push_back(C);
-	coms.push_back(D);
+	coms.push_back(env.getCommitmentValue("sk_u"));
+	coms.push_back(env.getCommitmentValue("s"));
+	coms.push_back(env.getCommitmentValue("t"));
 
 	startTimer();
-	CLSignatureProver clProver(pk, comGroup, lx, coms, 3, 1);
+	CLSignatureProver clProver(pk, comGroup, l, coms, 3, 1);
 	vector<SecretValue> privates;
-	privates.push_back(make_pair(sk_u, env.variables.at("r_B")));
-	privates.push_back(make_pair(s, env.variables.at("r_C")));
-	privates.push_back(make_pair(t, env.variables.at("r_D")));
+	privates.push_back(make_pair(skIn, env.variables.at("r_B")));
+	privates.push_back(make_pair(sIn, env.variables.at("r_C")));
+	privates.push_back(make_pair(tIn, env.variables.at("r_D")));
 	vector<ZZ> publics;
-	publics.push_back(walletSize);
-	ProofMessage* pm = clProver.getProof(signature, privates, publics,
-										 hashAlg);
+	publics.push_back(wSize);
+	ProofMessage* pm = clProver.getProof(clSig, privates, publics, ha);
 	printTimer("[Coin] got proof for CL");
-	clProof = *pm;
+	ProofMessage ret(*pm);
+	delete pm;
+	return ret;
 }
 
 Coin::Coin(const Coin &o) 
@@ -108,6 +166,8 @@ bool Coin::verifyCoin() const {
 	verifier.check(CommonFunctions::getZKPDir()+"/ecash.txt", cashG);
 	printTimer("[Coin] Verifier checked ST part");
 	variable_map cashV;
+	// the proof must be about the R this coin was spent with
+	cashV["R"] = R;
 	variable_map coinPub = coinProof.publics;
 	SigmaProof cashProof = coinProof.proof;
 	verifier.compute(cashV, coinPub);
@@ -132,15 +192,26 @@ bool Coin::verifyCoin() const {
 }
 
 ZZ Coin::getSPrime() const {
-	ZZ g = parameters->getCashGroup()->getGenerator(1);
-	ZZ mod = parameters->getCashGroup()->getModulus();
-	return MulMod(S, InvMod(PowerMod(g, endorsement[0], mod), mod), mod);
+	ZZ r;
+	removeEndorsement(r, S, endorsement[0]);
+	return r;
 }
 
 ZZ Coin::getTPrime() const {
-	ZZ g = parameters->getCashGroup()->getGenerator(1);
-	ZZ mod = parameters->getCashGroup()->getModulus();
-	return MulMod(T, InvMod(PowerMod(g, endorsement[1], mod), mod), mod);
+	ZZ r;
+	removeEndorsement(r, T, endorsement[1]);
+	return r;
+}
+
+void Coin::removeEndorsement(ZZ &r, const ZZ &x, const ZZ &e) const {
+	// r = x * g^(-e), using a scratch ZZ for g^e
+	const GroupPrime* cashG = parameters->getCashGroup();
+	const ZZ &mod = cashG->getModulus();
+	ScratchFrame frame;
+	ZZ &t = frame.zz();
+	PowerMod(t, cashG->getGenerator(1), e, mod);
+	InvMod(t, t, mod);
+	MulMod(r, x, t, mod);
 }
 
 hash_t Coin::hash() const {
@@ -7,6 +7,34 @@
 #include "Hash.h"
 #include "BankParameters.h"
 
+class InterpreterProver;
+
+/*! \brief The parts of a coin that don't depend on the merchant's R: the
+ * values of ecash.txt's computation other than T (the randomness, the
+ * commitments B, C, D, the endorsement commitment y, and S), the first
+ * messages of the proof of S and T for its relations that don't involve
+ * R, and the (whole) proof of a signature on the wallet, which only
+ * involves B, C and D.  Made ahead of time by Coin::prepare; what waits
+ * for R is T = g^(sk_u + R*beta + x2), the first message of its relation,
+ * and the challenge and responses, as the challenge covers T.  Each one
+ * holds secrets and must be used for one coin only. */
+struct PreparedCoin {
+	int coinIndex;
+	variable_map values;
+	PreparedProof proof;
+	ProofMessage clProof;
+
+	friend class boost::serialization::access;
+	template <class Archive>
+	void serialize(Archive& ar, const unsigned int ver) {
+		ar	& auto_nvp(coinIndex)
+			& auto_nvp(values)
+			& auto_nvp(proof)
+			& auto_nvp(clProof)
+			;
+	}
+};
+
 class Coin {
 
 	public:
@@ -16,7 +44,18 @@ class Coin {
 		Coin(const BankParameters* params, int wSize, int index,
 			 const ZZ &skIn, const ZZ &sIn, const ZZ &tIn, 
 			 const vector<ZZ> &clSig, int st, int l, const ZZ &rVal, 
-			 int denom, const hashalg_t &hashAlg);
+			 int denom, const hashalg_t &hashAlg,
+			 const PreparedCoin *prepared = 0);
+
+		/*! does the work of the constructor above that doesn't depend on
+		 * R, so that with the result, the constructor only has to
+		 * compute T and the parts of the proof of S and T that involve
+		 * it */
+		static PreparedCoin prepare(const BankParameters* params, int wSize,
+									int index, const ZZ &skIn, const ZZ &sIn,
+									const ZZ &tIn, const vector<ZZ> &clSig,
+									int l, int denom, 
+									const hashalg_t &hashAlg);
 
 		Coin(const char *fname, const BankParameters *params)
 			: parameters(params)
@@ -56,6 +95,10 @@ class Coin {
 		int getDenom() const { return coinDenom; }
 		// XXX: right now, I think this only exists for testing
 		int getIndex() const { return coinIndex; }
+		/*! the proofs that S and T are well formed, and that the user
+		 * has a signature on the wallet */
+		const ProofMessage& getCoinProof() const { return coinProof; }
+		const ProofMessage& getCLProof() const { return clProof; }
 
 		ZZ getSPrime() const;
 		ZZ getTPrime() const;
@@ -65,6 +108,27 @@ class Coin {
 		hash_t hash() const;
 
 	private:
+		/*! runs the computation in ecash.txt for the merchant's rVal,
+		 * taking the values in known from there */
+		static Environment computeCoin(InterpreterProver &prover,
+									   const BankParameters* params, 
+									   int index, const ZZ &skIn, 
+									   const ZZ &sIn, const ZZ &tIn, 
+									   const ZZ &rVal,
+									   const variable_map &known);
+		/*! proves knowledge of a signature on the values committed to in
+		 * env */
+		static ProofMessage proveSignature(const Environment &env,
+										   const BankParameters* params,
+										   int wSize, const ZZ &skIn, 
+										   const ZZ &sIn, const ZZ &tIn,
+										   const vector<ZZ> &clSig, int l, 
+										   int denom, 
+										   const hashalg_t &hashAlg);
+
+		// r = x * g^(-e)
+		void removeEndorsement(ZZ &r, const ZZ &x, const ZZ &e) const;
+
 		int stat, lx, coinDenom;
 		const BankParameters *parameters; // NOT serialized
 		int walletSize; // this is W
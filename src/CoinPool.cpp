@@ -0,0 +1,172 @@
+#include "CoinPool.h"
+#include "Ciphertext.h"
+#include "Hash.h"
+#include "AtomicFile.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <boost/bind.hpp>
+#include <openssl/crypto.h>
+
+// followed by the version and a newline, the MAC, and the ciphertext
+#define COINPOOL_MAGIC "CASHPOOL "
+#define COINPOOL_CIPHER Ciphertext::AES_128_CBC
+#define COINPOOL_MAC Hash::SHA1
+#define COINPOOL_MAC_BYTES 20
+
+const unsigned CoinPool::VERSION;
+
+// the caller's key is only used to derive one key for encryption and
+// another for the MAC
+static string deriveKey(const string &key, const string &purpose, 
+						size_t length) {
+	string derived = Hash::hash("CoinPool " + purpose, COINPOOL_MAC, key,
+								Hash::TYPE_PLAIN).str();
+	return derived.substr(0, length);
+}
+
+// the MAC covers the header and the wallet as well as the ciphertext, so
+// a pool can't be passed off as another version or another wallet's
+static string poolMac(const string &key, const string &header, 
+					  const Wallet &wallet, const string &ctext) {
+	string macKey = deriveKey(key, "MAC", COINPOOL_MAC_BYTES);
+	return Hash::hash(header + ZZToBytes(wallet.getId()) + ctext, 
+					  COINPOOL_MAC, macKey, Hash::TYPE_PLAIN).str();
+}
+
+CoinPool::CoinPool(Wallet &wallet, int size, int lowWater)
+	: wallet(wallet), size(size), lowWater(min(lowWater, size)),
+	  stopping(false), wanted(true), working(false)
+{
+	wallet.setSpendListener(boost::bind(&CoinPool::wake, this));
+	worker.reset(new boost::thread(boost::bind(&CoinPool::run, this)));
+}
+
+CoinPool::~CoinPool() {
+	wallet.setSpendListener(boost::function<void ()>());
+	{
+		boost::mutex::scoped_lock l(lock);
+		stopping = true;
+		wakeup.notify_all();
+	}
+	// coins being prepared right now are finished first
+	worker->join();
+}
+
+bool CoinPool::low() const {
+	return wallet.getNumPrepared() < min(lowWater, wallet.getNumCoinsLeft());
+}
+
+bool CoinPool::full() const {
+	return wallet.getNumPrepared() >= min(size, wallet.getNumCoinsLeft());
+}
+
+void CoinPool::wake() {
+	boost::mutex::scoped_lock l(lock);
+	if (low()) {
+		wanted = true;
+		wakeup.notify_all();
+	}
+}
+
+void CoinPool::run() {
+	boost::mutex::scoped_lock l(lock);
+	while (!stopping) {
+		if (!wanted) {
+			wakeup.wait(l);
+			continue;
+		}
+		wanted = false;
+		working = true;
+		l.unlock();
+		try {
+			wallet.precompute(size);
+		} catch (...) {
+			boost::mutex::scoped_lock l2(lock);
+			error = boost::current_exception();
+		}
+		l.lock();
+		working = false;
+		filled.notify_all();
+	}
+}
+
+void CoinPool::waitUntilFull() {
+	boost::mutex::scoped_lock l(lock);
+	while (!error && (working || wanted || !full())) {
+		if (!working && !wanted) {
+			// e.g., coins were spent without going below the low-water mark
+			wanted = true;
+			wakeup.notify_all();
+		}
+		filled.wait(l);
+	}
+	if (error) {
+		boost::exception_ptr e = error;
+		error = boost::exception_ptr();
+		boost::rethrow_exception(e);
+	}
+}
+
+void CoinPool::save(const string &fname, const string &key) const {
+	if (key.size() != Ciphertext::keyLength(COINPOOL_CIPHER))
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[CoinPool::save] Key has %u bytes, expected %u",
+			(unsigned) key.size(),
+			(unsigned) Ciphertext::keyLength(COINPOOL_CIPHER));
+	string ctext;
+	Ciphertext::encrypt(deriveKey(key, "encryption", key.size()), ctext,
+						saveString(wallet.getPrepared()), COINPOOL_CIPHER);
+	string header = COINPOOL_MAGIC + lexical_cast<string>(VERSION) + "\n";
+	string mac = poolMac(key, header, wallet, ctext);
+
+	AtomicFile out(fname, "CoinPool::save");
+	out.write(header);
+	out.write(mac);
+	out.write(ctext);
+	out.commit();
+}
+
+int CoinPool::load(const string &fname, const string &key) {
+	ifstream in(fname.c_str(), ios::in | ios::binary);
+	if (!in)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[CoinPool::load] Could not open %s", fname.c_str());
+	stringstream contents;
+	contents << in.rdbuf();
+	string file = contents.str();
+
+	size_t body = file.find('\n');
+	unsigned version = 0;
+	if (file.compare(0, strlen(COINPOOL_MAGIC), COINPOOL_MAGIC) == 0 &&
+		body != string::npos) {
+		size_t start = strlen(COINPOOL_MAGIC);
+		version = atoi(file.substr(start, body - start).c_str());
+	}
+	if (version != VERSION)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[CoinPool::load] %s is not a version %u coin pool",
+			fname.c_str(), VERSION);
+	string header = file.substr(0, body + 1);
+	string mac = file.substr(body + 1, COINPOOL_MAC_BYTES);
+	string ctext = file.substr(min(file.size(),
+								   body + 1 + COINPOOL_MAC_BYTES));
+	string expected = poolMac(key, header, wallet, ctext);
+	// compared in constant time, so the MAC can't be guessed bytewise
+	if (ctext.empty() || mac.size() != expected.size() ||
+		CRYPTO_memcmp(mac.data(), expected.data(), mac.size()) != 0)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[CoinPool::load] %s is corrupt, was saved with another key "
+			"or is for another wallet", fname.c_str());
+
+	string ptext;
+	Ciphertext::decrypt(deriveKey(key, "encryption", key.size()), ptext, 
+						ctext, COINPOOL_CIPHER);
+	vector<PreparedCoin> coins;
+	loadString(coins, ptext);
+	int before = wallet.getNumPrepared();
+	wallet.addPrepared(coins);
+	return wallet.getNumPrepared() - before;
+}
@@ -0,0 +1,75 @@
+#ifndef _COINPOOL_H_
+#define _COINPOOL_H_
+
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "Wallet.h"
+
+/*! \brief Keeps coins of a wallet ready to spend, so that starting a
+ * purchase never waits for a whole coin to be built.
+ *
+ * A coin can't be finished before the merchant's R is known, so what the
+ * pool keeps are prepared coins (see PreparedCoin): everything but T and
+ * the parts of the proof of S and T that involve it.  A background
+ * thread prepares the next size coins in spend order whenever fewer than
+ * lowWater are left (on the shared ThreadPool, if there is one).
+ * Wallet::nextCoin uses them, so anything spending from the wallet, e.g.
+ * FEInitiator::setup, draws from the pool.
+ *
+ * Prepared coins hold the secret randomness of the coins, so save()
+ * encrypts them (and authenticates the result, along with the wallet they
+ * belong to) with keys derived from one that the caller keeps, e.g. one
+ * from Ciphertext::generateKey().
+ */
+class CoinPool : private boost::noncopyable {
+	public:
+		// 2: separate keys, bound to the wallet
+		// 3: prepared coins keep the computed values and the first
+		//    messages of the proof of S and T
+		static const unsigned VERSION = 3;
+
+		/*! starts keeping coins of wallet ready; the wallet must outlive
+		 * the pool, and no coins may be spent while it is destroyed */
+		CoinPool(Wallet &wallet, int size, int lowWater);
+		~CoinPool();
+
+		/*! number of coins ready to spend */
+		int available() const { return wallet.getNumPrepared(); }
+
+		/*! blocks until the pool is full (or the wallet has no more coins
+		 * to prepare); rethrows any error from preparing coins */
+		void waitUntilFull();
+
+		/*! writes the coins ready to spend to fname, encrypted with key
+		 * (of Ciphertext::keyLength(Ciphertext::AES_128_CBC) bytes) */
+		void save(const string &fname, const string &key) const;
+
+		/*! adds the coins saved to fname (with key, from this wallet)
+		 * that haven't been spent since; returns the number of coins
+		 * added */
+		int load(const string &fname, const string &key);
+
+	private:
+		void run();
+		void wake();
+		/*! true if fewer coins than the low-water mark are ready (and
+		 * there are more to prepare); call with lock held */
+		bool low() const;
+		/*! true if all the coins that can be ready are */
+		bool full() const;
+
+		Wallet &wallet;
+		int size, lowWater;
+		boost::mutex lock; // guards everything below
+		boost::condition_variable wakeup, filled;
+		bool stopping, wanted, working;
+		boost::exception_ptr error;
+		boost::scoped_ptr<boost::thread> worker;
+};
+
+#endif /*_COINPOOL_H_*/
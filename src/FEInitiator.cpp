@@ -86,7 +86,8 @@ printTimer("Verifiable escrow generation");
 }
 
 void FEInitiator::makeCoin(Wallet* wallet, const ZZ& R) {
-	// get a coin
+	// get a coin (if the wallet has a CoinPool, it was prepared ahead of
+	// time, and only the part depending on R is left to do here)
 #ifdef TIMER
 startTimer();
 #endif
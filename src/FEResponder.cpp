@@ -259,7 +259,7 @@ MerkleProof* FEResponder::resolveII(vector<unsigned> &challenges){
 	const hash_t& pt = contract->getPTHashB();
 	if(pt.type == Hash::TYPE_MERKLE){
 			MerkleContract ptContract(pt.key, pt.alg);
-			MerkleProver ptProver = MerkleProver(ptextB, ptContract);
+			MerkleProver ptProver(ptextB, ptContract);
 			hash_matrix ptProofs = ptProver.generateProofs(challenges);
 			return new MerkleProof(ctextBlocks, ctProofs, ptProofs, 
 								   new MerkleContract(ctContract), 
@@ -305,7 +305,7 @@ MerkleProof* FEResponder::proveIncorrectKeys(const vector<string> &keys) {
 	const hash_t& pt = contract->getPTHashB();
 	if(pt.type == Hash::TYPE_MERKLE){
 			MerkleContract ptContract(pt.key, pt.alg);
-			MerkleProver ptProver = MerkleProver(ptextB, ptContract);
+			MerkleProver ptProver(ptextB, ptContract);
 			hash_matrix ptProofs = ptProver.generateProofs(challenges);
 			return new MerkleProof(ctextBlock, ctProofs, ptProofs, 
 								   new MerkleContract(ctContract), 
@@ -49,11 +49,11 @@ class Group {
 		// getters
 		int getModulusLength() const { return modulusLength; }
 		int getOrderLength() const { return orderLength; }
-		ZZ getModulus() const { return modulus; }
+		const ZZ& getModulus() const { return modulus; }
 		vector<ZZ> getGenerators() const { return generators; }
 		// returns the first generator
-		ZZ getGenerator() const { return generators[0]; }
-		ZZ getGenerator(int i) const { 
+		const ZZ& getGenerator() const { return generators[0]; }
+		const ZZ& getGenerator(int i) const { 
 			assert((size_t)i < generators.size());
 			return generators[i]; 
 		}
@@ -29,17 +29,26 @@ GroupPrime::GroupPrime(const string &owner, int modLength, int oLength, int st)
 
 	stat = st;
 
-	// decide on an order for the group
-	order = GenPrime_ZZ(orderLength, stat);
 	int factorLength = modulusLength - orderLength;
-
-	// find a prime modulus of suitable length
-	ZZ tempFactor;
-	do {
-		tempFactor = RandomLen_ZZ(factorLength);
-		modulus = order*tempFactor + 1;
-	} while(!ProbPrime(modulus, stat) || NumBits(modulus) != modulusLength);
-	factor = tempFactor;
+	if (factorLength == 1) {
+		// a safe prime: modulus = 2*order + 1, so the group is the
+		// quadratic residues
+		order = GenGermainPrime_ZZ(orderLength, stat);
+		modulus = 2*order + 1;
+		factor = 2;
+	} else {
+		// decide on an order for the group
+		order = GenPrime_ZZ(orderLength, stat);
+
+		// find a prime modulus of suitable length
+		ZZ tempFactor;
+		do {
+			tempFactor = RandomLen_ZZ(factorLength);
+			modulus = order*tempFactor + 1;
+		} while(!ProbPrime(modulus, stat) || 
+				NumBits(modulus) != modulusLength);
+		factor = tempFactor;
+	}
 
 	// come up with a generator for the group
 	ZZ gammaPrime, generator;
@@ -75,6 +84,9 @@ bool GroupPrime::isElement(const ZZ &value) const {
 		return false;
 	if(value >= modulus)
 		return false;
+	// for a safe prime, the group is the quadratic residues
+	if(hasCheapMembership())
+		return mpz_jacobi(MPZ(value), MPZ(modulus)) == 1;
 	if(PowerMod(value, getOrder(), modulus) != 1)
 		return false;
 	return true;
@@ -12,7 +12,8 @@ class GroupPrime : public Group {
 		/*! Create a new prime-order group with the specified owner,
 		 * a modulus of length modulusLength, a group
 		 * order of length orderLength, and a statistical security
-		 * parameter "stat" */
+		 * parameter "stat".  If orderLength is modulusLength - 1, the
+		 * modulus is a safe prime (2*order + 1) */
 		GroupPrime(const string &owner, int modulusLength,
 				   int orderLength, int stat);
 		
@@ -36,6 +37,10 @@ class GroupPrime : public Group {
 		/*! Check if value is an element of our group */
 		virtual bool isElement(const ZZ &value) const;
 
+		/*! true if isElement() costs a Jacobi symbol rather than an
+		 * exponentiation, i.e. if the modulus is 2*order + 1 */
+		bool hasCheapMembership() const { return factor == 2; }
+
 		/*! Check if gen is a generator for this group */
 		virtual bool isGenerator(const ZZ &gen) const;
 
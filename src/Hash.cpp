@@ -53,8 +53,9 @@ hash_t Hash::hash(const char* data, size_t len,
 		return hash(data, len, alg, key);
 	} else if (hashType == Hash::TYPE_MERKLE) {
 		MerkleContract contract(key, alg);
-		MerkleTree tree(data, len, contract);
-		return tree.getRoot();
+		MerkleBuilder builder(contract);
+		builder.add(data, len);
+		return builder.finish();
 	} else {
 		throw CashException(CashException::CE_HASH_ERROR,
 							"[Hash::hash] Unknown hash type used");
@@ -177,6 +178,86 @@ vector<hash_t> Hash::hashChunks(const char *buf, size_t len, const alg_t alg,
 
 
 
+HashContext::HashContext(hashalg_t alg, const string &key)
+	: alg(alg), key(key), inner(EVP_MD_CTX_create()), 
+	  outer(EVP_MD_CTX_create()), work(EVP_MD_CTX_create())
+{
+	const EVP_MD *m = Hash::get_MD(alg);
+	EVP_DigestInit_ex(inner, m, NULL);
+	if (key.empty())
+		return;
+
+	// HMAC (RFC 2104): H(key ^ opad, H(key ^ ipad, data))
+	size_t blockSize = EVP_MD_block_size(m);
+	string k = key;
+	if (k.size() > blockSize) {
+		char digest[EVP_MAX_MD_SIZE];
+		unsigned int dlen;
+		EVP_DigestUpdate(inner, k.data(), k.size());
+		EVP_DigestFinal_ex(inner, (unsigned char *)digest, &dlen);
+		EVP_DigestInit_ex(inner, m, NULL);
+		k.assign(digest, dlen);
+	}
+	k.resize(blockSize, '\0');
+	string ipad(blockSize, '\0'), opad(blockSize, '\0');
+	for (size_t i = 0; i < blockSize; i++) {
+		ipad[i] = k[i] ^ 0x36;
+		opad[i] = k[i] ^ 0x5c;
+	}
+	EVP_DigestUpdate(inner, ipad.data(), blockSize);
+	EVP_DigestInit_ex(outer, m, NULL);
+	EVP_DigestUpdate(outer, opad.data(), blockSize);
+}
+
+HashContext::~HashContext() {
+	EVP_MD_CTX_destroy(inner);
+	EVP_MD_CTX_destroy(outer);
+	EVP_MD_CTX_destroy(work);
+}
+
+Digest HashContext::digest(const char* data1, size_t len1, 
+							const char* data2, size_t len2) {
+	Digest d = Digest();
+	d.alg = alg;
+	unsigned int dlen;
+	EVP_MD_CTX_copy_ex(work, inner);
+	EVP_DigestUpdate(work, data1, len1);
+	if (len2)
+		EVP_DigestUpdate(work, data2, len2);
+	EVP_DigestFinal_ex(work, d.bytes, &dlen);
+	if (!key.empty()) {
+		EVP_MD_CTX_copy_ex(work, outer);
+		EVP_DigestUpdate(work, d.bytes, dlen);
+		EVP_DigestFinal_ex(work, d.bytes, &dlen);
+	}
+	return d;
+}
+
+size_t Digest::length(hashalg_t alg) {
+	switch (alg) {
+		case Hash::SHA1:
+			return 20;
+		case Hash::SHA256:
+			return 32;
+		case Hash::MD5:
+			return 16;
+		default:
+			throw CashException(CashException::CE_HASH_ERROR,
+								"[Digest::length] Unknown digest %d", alg);
+	}
+}
+
+Digest Digest::fromHash(const hash_t &h) {
+	Digest d = Digest();
+	if (h.size() != length(h.alg))
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[Digest::fromHash] Hash has %u bytes, expected %u", 
+			(unsigned) h.size(), (unsigned) length(h.alg));
+	memcpy(d.bytes, h.data(), h.size());
+	d.alg = h.alg;
+	return d;
+}
+
 /* HMACFUNCTION */
 /*
 HmacFunction::HmacFunction(const hashalg_t hashAlgorithm, const string& hashKey)
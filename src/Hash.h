@@ -3,8 +3,11 @@
 
 #include <string>
 #include <vector>
+#include <string.h>
+#include <stdint.h>
 #include "NTL/ZZ.h"
 #include <openssl/evp.h>
+#include <boost/noncopyable.hpp>
 #include "CashException.h"
 
 using namespace std;
@@ -12,6 +15,7 @@ using NTL::ZZ;
 
 class Buffer;
 class EncBuffer;
+class HashContext;
 
 class Hash {
 	
@@ -119,6 +123,8 @@ class Hash {
 		static hash_t hash(const vector<hash_t>& hashes, const alg_t& alg,
 						   const string &key, const int hashType);
 	protected:
+		friend class HashContext;
+
 		// Plain hash functions on char*
 		static hash_t hash(const char* data, size_t len, 
 				const alg_t alg, const string &key);
@@ -151,6 +157,89 @@ class Hash {
 typedef Hash::hash_t hash_t;
 typedef Hash::alg_t hashalg_t;
 
+/*! \brief A digest as a plain value: its bytes and the algorithm that
+ * made them, which gives its length.
+ *
+ * Unlike a hash_t, a Digest has no strings (so no allocations) and no
+ * copy of the key: where there are many digests made with the same
+ * algorithm and key, e.g., the nodes of a Merkle tree, those are kept
+ * once (in the MerkleContract) and the digests can sit in one contiguous
+ * array.  Use toHash() to get a hash_t back.
+ */
+struct Digest {
+	// room for the longest digest (SHA-256)
+	enum { MAX_SIZE = 32 };
+
+	uint8_t bytes[MAX_SIZE];
+	uint8_t alg;
+
+	/*! length in bytes of digests made with alg */
+	static size_t length(hashalg_t alg);
+
+	size_t size() const { return length((hashalg_t) alg); }
+	const char* data() const { return (const char*) bytes; }
+	string str() const { return string(data(), size()); }
+
+	/*! the hash_t of this digest, made with key */
+	hash_t toHash(const string &key, int type = Hash::TYPE_PLAIN) const {
+		return hash_t(data(), size(), (hashalg_t) alg, type, key);
+	}
+	static Digest fromHash(const hash_t &h);
+
+	bool operator==(const Digest &o) const {
+		return alg == o.alg && memcmp(bytes, o.bytes, size()) == 0;
+	}
+	bool operator!=(const Digest &o) const { return !(*this == o); }
+
+	friend class boost::serialization::access;
+	template <class Archive> 
+	void serialize(Archive& ar, const unsigned int ver) {
+		ar & auto_nvp(bytes) & auto_nvp(alg);
+	}
+};
+
+/*! \brief Hashes many messages with the same algorithm and key, giving
+ * the same values as Hash::hash(data, len, alg, key, Hash::TYPE_PLAIN).
+ *
+ * The digest (and, with a key, both padded HMAC keys) is set up once, so
+ * each message only costs the blocks of the message itself: for the short
+ * inputs of a Merkle tree that halves the work of an HMAC.  A context is
+ * not thread-safe; use one per thread.
+ */
+class HashContext : private boost::noncopyable {
+	public:
+		HashContext(hashalg_t alg, const string &key);
+		~HashContext();
+
+		Digest digest(const char* data, size_t len) {
+			return digest(data, len, 0, 0);
+		}
+		/*! the digest of the two buffers one after the other, without
+		 * copying them together */
+		Digest digest(const char* data1, size_t len1, 
+					  const char* data2, size_t len2);
+		/*! the digest of two digests, e.g., the children of a Merkle
+		 * tree node */
+		Digest digest(const Digest &left, const Digest &right) {
+			return digest(left.data(), left.size(), right.data(), right.size());
+		}
+
+		hash_t hash(const char* data, size_t len) {
+			return digest(data, len).toHash(key);
+		}
+		hash_t hash(const hash_t &left, const hash_t &right) {
+			return digest(left.data(), left.size(), 
+						  right.data(), right.size()).toHash(key);
+		}
+
+	private:
+		hashalg_t alg;
+		string key;
+		EVP_MD_CTX *inner; // ready for the message
+		EVP_MD_CTX *outer; // ready for the inner digest (with a key)
+		EVP_MD_CTX *work;
+};
+
 namespace __gnu_cxx {
 	// XXX make this more efficient
 	inline size_t hash_string(const char* __s, size_t len) {
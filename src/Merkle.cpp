@@ -1,6 +1,27 @@
 #include "Merkle.h"
+#include "ThreadPool.h"
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 
-MerkleTree::MerkleTree(const char* buff, int buffSize, 
+// fewer nodes than this (a level, or the leaves) are hashed by the
+// calling thread alone, as handing them out would cost more than it saves
+#define MIN_PARALLEL_NODES 1024
+
+typedef boost::function<void (size_t, size_t)> slice_t;
+
+// calls slice(parts, part) for every part of n nodes: a few parts per
+// thread of the shared pool, so the pool can balance them
+static void hashSlices(size_t n, const slice_t &slice) {
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	if (!pool || n < MIN_PARALLEL_NODES) {
+		slice(1, 0);
+		return;
+	}
+	size_t parts = min(n / (MIN_PARALLEL_NODES / 4), (size_t) pool->size() * 4);
+	pool->parallelFor(parts, boost::bind(slice, parts, _1));
+}
+
+MerkleTree::MerkleTree(const char* buff, size_t buffSize, 
 					   const MerkleContract &contract) 
 	: contract(contract)
 {
@@ -21,78 +42,197 @@ MerkleTree::MerkleTree(const vector<hash_t> &hashBlocks,
 	init(hashBlocks);
 }
 
-vector<hash_t> MerkleTree::initHashChunks(const char* buff, int buffSize){	
-	unsigned numChunks = buffSize/CHUNK_SIZE;
+void MerkleTree::initHashChunks(const char* buff, size_t buffSize){	
+	// the last chunk may be short; empty data is one (padding) leaf
+	unsigned numChunks = (buffSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
 	padStart = numChunks;
 
-	unsigned nextTwoPow = nextPowerOfTwo(numChunks);
+	unsigned nextTwoPow = numChunks ? nextPowerOfTwo(numChunks) : 1;
 	height = log_2(nextTwoPow);
 
-	//create a hash_t array of the leaf nodes
-	vector<hash_t> hashChunks(nextTwoPow);
+	//a binary tree has 2 * numLeaves -1 nodes; the leaves go last
+	nodes.resize(2*nextTwoPow-1);
+	hashSlices(nextTwoPow, boost::bind(&MerkleTree::hashChunkSlice, this, 
+									   buff, buffSize, numChunks, _1, _2));
+}
 
-	for(unsigned i = 0; i<nextTwoPow; i++){
+void MerkleTree::hashChunkSlice(const char* buff, size_t buffSize, 
+								unsigned numChunks, size_t parts, 
+								size_t part) {
+	unsigned begin = getNumLeaves() * part / parts;
+	unsigned end = getNumLeaves() * (part + 1) / parts;
+	Digest *leaves = &nodes[getNumLeaves() - 1];
+	HashContext ctx(contract.getAlg(), contract.getKey());
+	for(unsigned i = begin; i<end; i++){
 		if(i<numChunks){
-			hashChunks[i] = contract.hash(buff+i*CHUNK_SIZE , ((i==numChunks-1 && buffSize %CHUNK_SIZE) ? buffSize % CHUNK_SIZE  : CHUNK_SIZE ));
+			size_t offset = (size_t) i * CHUNK_SIZE;
+			leaves[i] = ctx.digest(buff + offset, 
+								   min((size_t) CHUNK_SIZE, buffSize - offset));
 		}else {
-			hashChunks[i] = contract.hash((char *)&i, sizeof(i));
+			leaves[i] = ctx.digest((char *)&i, sizeof(i));
 		}
 	}
-	//return a pointer to the leaf nodes array
-	return hashChunks;
 }
 
-vector<hash_t> MerkleTree::pad(const vector<hash_t> &hashBlocks){
+void MerkleTree::pad(const vector<hash_t> &hashBlocks){
 	unsigned numChunks = hashBlocks.size();
 	padStart = numChunks;
 	
 	unsigned nextTwoPow = nextPowerOfTwo(numChunks);
 	height = log_2(nextTwoPow);
 
-	//create a hash_t array of the leaf nodes
-	vector<hash_t> hashChunks(nextTwoPow);
+	//a binary tree has 2 * numLeaves -1 nodes; the leaves go last
+	nodes.resize(2*nextTwoPow-1);
+	Digest *leaves = &nodes[nextTwoPow - 1];
+	HashContext ctx(contract.getAlg(), contract.getKey());
 
 	for(unsigned i = 0; i<nextTwoPow; i++){
 		if(i<numChunks){
-			hashChunks[i] = hashBlocks[i];
+			leaves[i] = Digest::fromHash(hashBlocks[i]);
 		}else {
-			hashChunks[i] = contract.hash((char *)&i, sizeof(i));
+			leaves[i] = ctx.digest((char *)&i, sizeof(i));
 		}
 	}
-	//return a pointer to the leaf nodes array
-	return hashChunks;
-	
-	
 }
-hash_t MerkleTree::makeRoot(const vector<hash_t> &chunks){
-	//a binary tree has 2 * numLeaves -1 nodes
-	unsigned treeSize = 2*getNumLeaves()-1;
-	//create an array to hold the binary tree
-	vector<hash_t> m_tree(treeSize);
-	//initialize the leaves to chunks
-	int x;
-	int y;
-	for(x = treeSize -1, y = getNumLeaves()-1; y>=0; x--, y--){
-		m_tree[x]=chunks[y];
+
+void MerkleTree::makeRoot(){
+	//compute the rest of the hash tree, a level at a time from the bottom
+	//(the nodes of a level only depend on the level below)
+	for(int level = height-1; level>=0; level--){
+		size_t first = (1 << level) - 1;
+		size_t count = 1 << level;
+		hashSlices(count, boost::bind(&MerkleTree::hashNodeSlice, this, 
+									  first, count, _1, _2));
 	}
-	//compute the rest of the hash tree
-	for(int x = treeSize-1-getNumLeaves(); x>=0; x--){
-		m_tree[x] = contract.hash(m_tree[2*x+1], m_tree[2*x+2]);
+	root = nodes[0].toHash(contract.getKey(), Hash::TYPE_MERKLE);
+}
+
+void MerkleTree::hashNodeSlice(size_t first, size_t count, size_t parts, 
+							   size_t part) {
+	size_t begin = first + count * part / parts;
+	size_t end = first + count * (part + 1) / parts;
+	HashContext ctx(contract.getAlg(), contract.getKey());
+	for(size_t x = begin; x<end; x++){
+		nodes[x] = ctx.digest(nodes[2*x+1], nodes[2*x+2]);
 	}
-	//return the root
-	return m_tree[0];
 }
 
-void MerkleTree::init(const char* buff, int buffSize){
-	leaves = initHashChunks(buff, buffSize);
-	root = makeRoot(leaves);
-	root.type=Hash::TYPE_MERKLE;
+void MerkleTree::init(const char* buff, size_t buffSize){
+	initHashChunks(buff, buffSize);
+	makeRoot();
 }
 
 void MerkleTree::init(const vector<hash_t> &hashBlocks){
-	leaves = pad(hashBlocks);
-	root = makeRoot(leaves);
-	root.type=Hash::TYPE_MERKLE;
+	pad(hashBlocks);
+	makeRoot();
+}
+
+MerkleBuilder::MerkleBuilder(const MerkleContract &contract)
+	: contract(contract), ctx(contract.getAlg(), contract.getKey()), 
+	  numLeaves(0), height(0), finished(false)
+{
+}
+
+MerkleBuilder::MerkleBuilder(const MerkleContract &contract, 
+							 const string &leafFile)
+	: contract(contract), ctx(contract.getAlg(), contract.getKey()), 
+	  numLeaves(0), height(0), finished(false),
+	  leafOut(new ofstream(leafFile.c_str(), 
+						   ios::out | ios::binary | ios::trunc))
+{
+	if (!*leafOut)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleBuilder] Could not open %s", leafFile.c_str());
 }
 
+void MerkleBuilder::add(const char* buff, size_t len) {
+	if (finished)
+		throw CashException(CashException::CE_UNKNOWN_ERROR,
+			"[MerkleBuilder::add] Tree is already finished");
+	// complete a chunk started by an earlier call
+	if (!partial.empty()) {
+		size_t take = min(len, CHUNK_SIZE - partial.size());
+		partial.append(buff, take);
+		buff += take;
+		len -= take;
+		if (partial.size() < CHUNK_SIZE)
+			return;
+		push(ctx.digest(partial.data(), partial.size()));
+		partial.clear();
+	}
+	// whole chunks straight from the caller's buffer
+	for (; len >= CHUNK_SIZE; buff += CHUNK_SIZE, len -= CHUNK_SIZE)
+		push(ctx.digest(buff, CHUNK_SIZE));
+	partial.assign(buff, len);
+}
 
+void MerkleBuilder::addLeaf(const hash_t &leaf) {
+	if (finished || !partial.empty())
+		throw CashException(CashException::CE_UNKNOWN_ERROR,
+			"[MerkleBuilder::addLeaf] Tree is finished or has data");
+	push(Digest::fromHash(leaf));
+}
+
+void MerkleBuilder::push(const Digest &leaf) {
+	if (leafOut)
+		leafOut->write(leaf.data(), leaf.size());
+	numLeaves++;
+	// carry up the tree like adding one to a binary counter
+	Digest node = leaf;
+	unsigned level = 0;
+	for (; level < waiting.size() && waiting[level]; level++) {
+		node = ctx.digest(frontier[level], node);
+		waiting[level] = false;
+	}
+	if (level == waiting.size()) {
+		frontier.push_back(Digest());
+		waiting.push_back(false);
+	}
+	frontier[level] = node;
+	waiting[level] = true;
+}
+
+hash_t MerkleBuilder::finish() {
+	if (finished)
+		throw CashException(CashException::CE_UNKNOWN_ERROR,
+			"[MerkleBuilder::finish] Tree is already finished");
+	if (!partial.empty()) {
+		push(ctx.digest(partial.data(), partial.size()));
+		partial.clear();
+	}
+	// pad with the same leaves as MerkleTree
+	uint64_t dataLeaves = numLeaves, leaves = 1;
+	for (height = 0; leaves < dataLeaves; height++)
+		leaves <<= 1;
+	for (unsigned i = dataLeaves; i < leaves; i++)
+		push(ctx.digest((char *)&i, sizeof(i)));
+	numLeaves = dataLeaves;
+	finished = true;
+	if (leafOut) {
+		leafOut->close();
+		if (!*leafOut)
+			throw CashException(CashException::CE_IO_ERROR,
+				"[MerkleBuilder::finish] Could not write the leaves");
+	}
+
+	// with a power of two leaves, the root is the only node left
+	return frontier[height].toHash(contract.getKey(), Hash::TYPE_MERKLE);
+}
+
+hash_t MerkleBuilder::hashFile(const string &fname, 
+							   const MerkleContract &contract) {
+	ifstream in(fname.c_str(), ios::in | ios::binary);
+	if (!in)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleBuilder::hashFile] Could not open %s", fname.c_str());
+	MerkleBuilder builder(contract);
+	vector<char> buff(256 * CHUNK_SIZE);
+	while (in) {
+		in.read(&buff[0], buff.size());
+		builder.add(&buff[0], in.gcount());
+	}
+	if (in.bad())
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleBuilder::hashFile] Could not read %s", fname.c_str());
+	return builder.finish();
+}
@@ -2,6 +2,9 @@
 #define _MERKLE_H_
 
 #include "MerkleContract.h"
+#include <fstream>
+#include <stdint.h>
+#include <boost/scoped_ptr.hpp>
 
 //constructs a binary representation
 inline pathbits binaryRepresentation(int x){
@@ -38,29 +41,97 @@ inline unsigned nextPowerOfTwo(int x){
 class MerkleTree {
 
 	public:
-		MerkleTree(const char* buff, int buffSize, 
+		MerkleTree(const char* buff, size_t buffSize, 
 				   const MerkleContract &contract);
 		MerkleTree(const string& str, const MerkleContract &contract);
 		MerkleTree(const vector<hash_t> &hashBlocks, 
 				   const MerkleContract &contract);
 		
 		unsigned getHeight() const {return height;}
-		vector<hash_t> getLeaves() const {return leaves;}
+		vector<Digest> getLeaves() const {
+			return vector<Digest>(nodes.end() - getNumLeaves(), nodes.end());
+		}
 		hash_t getRoot() const {return root;}
 		unsigned getNumLeaves() const {return 1 << height;}
 
+		/*! the whole tree a level at a time, root first: the children of
+		 * node x are 2x+1 and 2x+2, and the leaves are the last
+		 * getNumLeaves() nodes */
+		const vector<Digest>& getNodes() const {return nodes;}
+
 	private:		
-		vector<hash_t> initHashChunks(const char* buff, int buffSize);
-		hash_t makeRoot(const vector<hash_t> &chunks);
-		void init(const char* buff, int buffSize);
+		void initHashChunks(const char* buff, size_t buffSize);
+		void makeRoot();
+		void init(const char* buff, size_t buffSize);
 		void init(const vector<hash_t> &hashBlocks);
-		vector<hash_t> pad(const vector<hash_t> &hashBlocks);
+		void pad(const vector<hash_t> &hashBlocks);
+		void hashChunkSlice(const char* buff, size_t buffSize, 
+							unsigned numChunks, size_t parts, 
+							size_t part);
+		void hashNodeSlice(size_t first, size_t count, size_t parts, 
+						   size_t part);
 		
 		MerkleContract contract;
 		hash_t root;
-		vector<hash_t> leaves;
+		vector<Digest> nodes;
 		unsigned padStart;
 		unsigned height;
 };
 
+/*! \brief Computes the root a MerkleTree would have, from data that
+ * arrives in pieces of any size (e.g., as it is read from a file or a
+ * socket), without ever holding all of it.
+ *
+ * Only the frontier of the tree is kept: at most one node per level that
+ * is waiting for its right sibling, so memory stays O(log n) however big
+ * the input is.  Optionally, every leaf hash (padding included) is also
+ * written to a file as it is made, so the leaves can be used later
+ * without hashing the data again.
+ */
+class MerkleBuilder {
+
+	public:
+		MerkleBuilder(const MerkleContract &contract);
+
+		/*! also writes the leaf hashes, one after another, to leafFile */
+		MerkleBuilder(const MerkleContract &contract, 
+					  const string &leafFile);
+
+		/*! adds the next len bytes of data */
+		void add(const char* buff, size_t len);
+		void add(const string &str) { add(str.data(), str.size()); }
+
+		/*! adds the hash of the next block, for trees over hashed blocks
+		 * (like MerkleTree(vector<hash_t>)); can't be mixed with add() */
+		void addLeaf(const hash_t &leaf);
+
+		/*! pads the leaves to a power of two and returns the root; nothing
+		 * can be added afterwards */
+		hash_t finish();
+
+		/*! the Merkle root of the file fname, read a piece at a time */
+		static hash_t hashFile(const string &fname, 
+							   const MerkleContract &contract);
+
+		/*! number of leaves added so far (not counting padding) */
+		uint64_t getNumLeaves() const { return numLeaves; }
+		/*! height of the tree, once finished */
+		unsigned getHeight() const { return height; }
+
+	private:
+		void push(const Digest &leaf);
+
+		MerkleContract contract;
+		HashContext ctx;
+		// frontier[i] is a finished node at height i waiting for its
+		// right sibling, if waiting[i]
+		vector<Digest> frontier;
+		vector<bool> waiting;
+		string partial; // the start of a chunk not yet complete
+		uint64_t numLeaves;
+		unsigned height;
+		bool finished;
+		boost::scoped_ptr<ofstream> leafOut;
+};
+
 #endif
@@ -7,13 +7,32 @@
 
 typedef bitset<32> pathbits;
 
+// a node of a Merkle proof; its algorithm and key are the contract's
 struct hashDirect{
-	hash_t node;
+	Digest node;
 	pathbits path;
 };
 
 typedef vector<vector<hashDirect> > hash_matrix;	
 
+/*! a proof for several blocks at once, which sends each node it needs
+ * only once: the challenged blocks (sorted, without repeats) and their
+ * leaves, then the siblings that can't be computed from those, in the
+ * order a bottom-up pass over the tree uses them */
+struct multiProof{
+	vector<unsigned> challenges;
+	vector<Digest> leaves;
+	vector<Digest> siblings;
+
+	friend class boost::serialization::access;
+	template <class Archive> 
+	void serialize(Archive& ar, const unsigned int ver) {
+		ar  & auto_nvp(challenges)
+			& auto_nvp(leaves)
+			& auto_nvp(siblings);
+	}
+};
+
 class MerkleContract {
 	public:	
 		MerkleContract(){}
@@ -37,6 +56,9 @@ class MerkleContract {
 		hash_t hash(const string& str) const {
 			return hash(str.data(), str.size());
 		}
+
+		const string& getKey() const { return key; }
+		hashalg_t getAlg() const { return alg; }
 		
 	private:
 		string key;
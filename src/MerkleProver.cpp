@@ -1,84 +1,214 @@
 #include "MerkleProver.h"
+#include "AtomicFile.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-MerkleProver::MerkleProver(const vector<hash_t> &hashBlocks, 
-						   const MerkleContract &contract) 
-	: contract(contract)
+#define MERKLEPROVER_MAGIC "CASHMRKL"
+
+const unsigned MerkleProver::VERSION;
+
+struct file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t alg;
+	uint32_t height;
+	uint32_t nodeBytes;
+	char unused[40];
+};
+
+MerkleProver::MerkleProver(const vector<hash_t> &hashBlocks,
+						   const MerkleContract &contract)
+	: contract(contract), mapping(0), mapped(0)
 {
-	tree = new MerkleTree(hashBlocks, contract);
+	init(new MerkleTree(hashBlocks, contract));
 }
 
-MerkleProver::MerkleProver(const char* buff, int buffSize, 
-						   const MerkleContract& contract) 
-	: contract(contract), tree(0) 
+MerkleProver::MerkleProver(const char* buff, size_t buffSize,
+						   const MerkleContract& contract)
+	: contract(contract), mapping(0), mapped(0)
 {
 	init(buff, buffSize);
 }
 
 
-MerkleProver::MerkleProver(const string &str, const MerkleContract &contract) 
-	: contract(contract)
+MerkleProver::MerkleProver(const string &str, const MerkleContract &contract)
+	: contract(contract), mapping(0), mapped(0)
 {
 	init(str.data(), str.size());
 }
 
-MerkleProver::MerkleProver(const vector<EncBuffer*> &encBuffs, 
-						   const MerkleContract &contract) 
-	: contract(contract)
+MerkleProver::MerkleProver(const vector<EncBuffer*> &encBuffs,
+						   const MerkleContract &contract)
+	: contract(contract), mapping(0), mapped(0)
 {
 	vector<hash_t> hashBlocks(encBuffs.size());
 	for(unsigned x=0; x<encBuffs.size(); x++){
 		hashBlocks[x] = contract.hash(encBuffs[x]);
 	}
-	tree = new MerkleTree(hashBlocks, contract);
+	init(new MerkleTree(hashBlocks, contract));
 }
 
-MerkleProver::MerkleProver(const vector<const Buffer*>& buffs, 
-						   const MerkleContract &contract) 
-	: contract(contract)
+MerkleProver::MerkleProver(const vector<const Buffer*>& buffs,
+						   const MerkleContract &contract)
+	: contract(contract), mapping(0), mapped(0)
 {
 	vector<hash_t> hashBlocks(buffs.size());
 	for(unsigned x=0; x<buffs.size(); x++){
 		hashBlocks[x] = contract.hash(buffs[x]);
 	}
-	tree = new MerkleTree(hashBlocks, contract);
+	init(new MerkleTree(hashBlocks, contract));
 }
-hash_matrix MerkleProver::generateProofs(const vector<unsigned> &challenges){
-	hash_matrix toReturn;
-	unsigned treeSize = 2*getNumBlocks()-1;
-	vector<hash_t> m_tree(treeSize);
-	//initialize the leaves to chunks
-	vector<hash_t> leaves = tree->getLeaves();
-	int x;
-	int y;
-	for(x = treeSize -1, y = getNumBlocks()-1; y>=0; x--, y--){
-		m_tree[x]=leaves[y];
+
+MerkleProver::MerkleProver(const MerkleContract &contract)
+	: contract(contract), nodes(0), height(0), mapping(0), mapped(0)
+{
+}
+
+MerkleProver::~MerkleProver() {
+	if (mapping)
+		munmap(mapping, mapped);
+}
+
+MerkleProver* MerkleProver::load(const string &fname,
+								 const MerkleContract &contract) {
+	int fd = open(fname.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		if (fd >= 0)
+			close(fd);
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleProver::load] Could not open %s", fname.c_str());
+	}
+	void *p = MAP_FAILED;
+	if ((size_t) st.st_size >= sizeof(file_header))
+		p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleProver::load] Could not map %s", fname.c_str());
+
+	// from here on, the mapping is the prover's to unmap
+	MerkleProver *prover = new MerkleProver(contract);
+	prover->mapping = p;
+	prover->mapped = st.st_size;
+
+	file_header h;
+	memcpy(&h, p, sizeof(h));
+	size_t treeSize = ((size_t) 2 << min(h.height, 31u)) - 1;
+	if (memcmp(h.magic, MERKLEPROVER_MAGIC, sizeof(h.magic)) != 0 ||
+		h.version != VERSION || h.nodeBytes != sizeof(Digest) ||
+		h.height > 31 ||
+		(size_t) st.st_size != sizeof(h) + treeSize * sizeof(Digest)) {
+		delete prover;
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleProver::load] %s is not a version %u Merkle tree",
+			fname.c_str(), VERSION);
 	}
-	
+	prover->nodes = (const Digest*) ((const char*) p + sizeof(h));
+	prover->height = h.height;
+
+	// the root has to be the hash of its children under this contract
+	const Digest *nodes = prover->nodes;
+	HashContext ctx(contract.getAlg(), contract.getKey());
+	if (h.alg != (uint32_t) contract.getAlg() ||
+		(h.height > 0 && ctx.digest(nodes[1], nodes[2]) != nodes[0])) {
+		delete prover;
+		throw CashException(CashException::CE_IO_ERROR,
+			"[MerkleProver::load] %s was made with another contract",
+			fname.c_str());
+	}
+	return prover;
+}
+
+void MerkleProver::save(const string &fname) const {
+	file_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MERKLEPROVER_MAGIC, sizeof(h.magic));
+	h.version = VERSION;
+	h.alg = contract.getAlg();
+	h.height = height;
+	h.nodeBytes = sizeof(Digest);
+
+	AtomicFile out(fname, "MerkleProver::save");
+	out.write(&h, sizeof(h));
+	out.write(nodes, (2 * (size_t) getNumBlocks() - 1) * sizeof(Digest));
+	out.commit();
+}
+
+hash_matrix MerkleProver::generateProofs(const vector<unsigned> &challenges)
+		const {
+	hash_matrix toReturn;
 	for(unsigned x = 0; x<challenges.size(); x++){
-		toReturn.push_back(generateProof(challenges[x], m_tree));
+		toReturn.push_back(generateProof(challenges[x]));
 	}
 	return toReturn;
 }
 
-vector<hashDirect> MerkleProver::generateProof(unsigned challenge, 
-											   vector<hash_t> &m_tree){
+multiProof MerkleProver::generateMultiProof(const vector<unsigned> &challenges)
+		const {
+	multiProof proof;
+	proof.challenges = challenges;
+	sort(proof.challenges.begin(), proof.challenges.end());
+	proof.challenges.erase(unique(proof.challenges.begin(), 
+								  proof.challenges.end()), 
+						   proof.challenges.end());
+
+	vector<unsigned> level;
+	for(unsigned x = 0; x<proof.challenges.size(); x++){
+		unsigned challenge = proof.challenges[x];
+		if (challenge >= getNumBlocks())
+			throw CashException(CashException::CE_SIZE_ERROR,
+				"[MerkleProver::generateMultiProof] Challenged block %u of %u",
+				challenge, getNumBlocks());
+		level.push_back(getNumBlocks() - 1 + challenge);
+		proof.leaves.push_back(nodes[level.back()]);
+	}
+
+	// a level at a time from the bottom: each known node needs its
+	// sibling, which is only sent if it isn't known too
+	while(!level.empty() && level[0] != 0){
+		vector<unsigned> parents;
+		for(unsigned i = 0; i<level.size(); i++){
+			unsigned x = level[i];
+			if(x % 2 && i+1 < level.size() && level[i+1] == x+1){
+				i++;
+			} else {
+				proof.siblings.push_back(nodes[x % 2 ? x+1 : x-1]);
+			}
+			parents.push_back((x-1)/2);
+		}
+		level.swap(parents);
+	}
+	return proof;
+}
+
+vector<hashDirect> MerkleProver::generateProof(unsigned challenge) const {
+	if (challenge >= getNumBlocks())
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[MerkleProver::generateProof] Challenged block %u of %u",
+			challenge, getNumBlocks());
 	vector<hashDirect> toReturn;
-	
+
 	//construct a binary represention of the chunk index
 	pathbits path = binaryRepresentation(challenge);
 
 	//push back the chunk itself
 	hashDirect chunk;
-	chunk.node=m_tree[getNumBlocks() - 1 + challenge];
+	chunk.node=nodes[getNumBlocks() - 1 + challenge];
 	chunk.path = path;
 	toReturn.push_back(chunk);
-	
+
 	//should get all the neighbors
-	for(unsigned height = tree->getHeight(); height>=1; height--){
+	for(unsigned h = height; h>=1; h--){
 		hashDirect temp;
 		path.flip(0);
-		unsigned index = (1<<height)- 1 + binToInt(path);
-		temp.node = computeSubTree(index, m_tree);
+		unsigned index = (1<<h)- 1 + binToInt(path);
+		temp.node = nodes[index];
 		temp.path = path;
 		//get the neighbor
 		toReturn.push_back(temp);
@@ -87,18 +217,12 @@ vector<hashDirect> MerkleProver::generateProof(unsigned challenge,
 	return toReturn;
 }
 
-hash_t MerkleProver::computeSubTree(unsigned index, vector<hash_t> &m_tree){
-	if(m_tree[index].empty()){
-		m_tree[index] = contract.hash(computeSubTree(index*2 +1, m_tree), 
-									  computeSubTree(index*2+2, m_tree));
-	}
-	return m_tree[index];
+void MerkleProver::init(const char* buff, size_t buffSize){
+	init(new MerkleTree(buff, buffSize, contract));
 }
 
-
-void MerkleProver::init(const char* buff, int buffSize){
-	tree = new MerkleTree(buff, buffSize, contract);
+void MerkleProver::init(MerkleTree *t){
+	tree.reset(t);
+	nodes = &tree->getNodes()[0];
+	height = tree->getHeight();
 }
-
-
-
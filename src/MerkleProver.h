@@ -2,40 +2,72 @@
 #define _MERKLEPROVER_H_
 
 #include "Merkle.h"
+#include <boost/noncopyable.hpp>
 
-class MerkleProver {
+/*! \brief Answers challenges for blocks of a Merkle tree.
+ *
+ * The prover keeps the whole tree (every node, a level at a time), so
+ * answering a challenge just looks up the log n siblings on its path;
+ * nothing is hashed after the tree is built.  A tree can be saved to a
+ * file and loaded later: the file is mapped rather than read, so only
+ * the pages holding the challenged paths are ever brought in.
+ */
+class MerkleProver : private boost::noncopyable {
 
 	public:
-		MerkleProver(const vector<EncBuffer*> &encBuffs, 
+		static const unsigned VERSION = 1;
+
+		MerkleProver(const vector<EncBuffer*> &encBuffs,
 					 const MerkleContract &contract);
 
-		MerkleProver(const vector<const Buffer*> &buffs, 
+		MerkleProver(const vector<const Buffer*> &buffs,
 					 const MerkleContract &contract);
 
 		MerkleProver(const string &str, const MerkleContract &contract);
-		
-		MerkleProver(const char* buff, int buffSize, 
+
+		MerkleProver(const char* buff, size_t buffSize,
 					 const MerkleContract &contract);
-		
-		MerkleProver(const vector<hash_t> &hashBlocks, 
+
+		MerkleProver(const vector<hash_t> &hashBlocks,
 					 const MerkleContract &contract);
-		
-		hash_matrix generateProofs(const vector<unsigned> &challenges);
-		
-		unsigned getNumBlocks() const { return tree->getNumLeaves(); }
-		hash_t getRoot() const { return tree->getRoot(); }
-	
-	private:	
-		vector<hashDirect> generateProof(unsigned challenge, 
-										 vector<hash_t> &m_tree);
-		
-		void init(const char* buff, int buffSize);
-		
-		hash_t computeSubTree(unsigned index, vector<hash_t> &m_tree);
-		
-		MerkleContract contract;
-		MerkleTree* tree;
 
+		~MerkleProver();
+
+		/*! loads a tree written by save(); contract must be the one the
+		 * tree was made with (which is checked, unless the tree is a
+		 * single block) */
+		static MerkleProver* load(const string &fname,
+								  const MerkleContract &contract);
+
+		/*! writes the whole tree to fname */
+		void save(const string &fname) const;
+
+		hash_matrix generateProofs(const vector<unsigned> &challenges) const;
+
+		/*! one proof for all of challenges, with no node sent twice */
+		multiProof generateMultiProof(const vector<unsigned> &challenges) 
+			const;
+
+		unsigned getNumBlocks() const { return 1 << height; }
+		unsigned getHeight() const { return height; }
+		hash_t getRoot() const {
+			return nodes[0].toHash(contract.getKey(), Hash::TYPE_MERKLE);
+		}
+
+	private:
+		MerkleProver(const MerkleContract &contract);
+
+		vector<hashDirect> generateProof(unsigned challenge) const;
+
+		void init(const char* buff, size_t buffSize);
+		void init(MerkleTree *t);
+
+		MerkleContract contract;
+		boost::scoped_ptr<MerkleTree> tree; // unless the nodes are mapped
+		const Digest *nodes; // laid out as in MerkleTree::getNodes()
+		unsigned height;
+		void *mapping;
+		size_t mapped;
 };
 
 #endif
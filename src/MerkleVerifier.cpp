@@ -1,19 +1,25 @@
 #include "MerkleVerifier.h"
 #include <algorithm>
-#define numChallenges 22
 #define MIN(x, y) ( (x) < (y) ? (x) : (y) )
 
+const unsigned MerkleVerifier::NUM_CHALLENGES;
+
 MerkleVerifier::MerkleVerifier(const hash_t &rt, unsigned numLeaves, 
-							   const MerkleContract &contract) 
+							   const MerkleContract &contract,
+							   unsigned nChallenges) 
 	: contract(contract)
 {
 	numBlocks = numLeaves;
+	// the tree is padded out to a power of two leaves
+	treeLeaves = 1;
+	while(treeLeaves < numBlocks)
+		treeLeaves <<= 1;
 	root = rt;
-	challenges = generateChallenges();
+	challenges = generateChallenges(nChallenges);
 }
 
-vector<unsigned> MerkleVerifier::generateChallenges() {
-	unsigned nChallenges = MIN(numBlocks, numChallenges);	
+vector<unsigned> MerkleVerifier::generateChallenges(unsigned nChallenges) {
+	nChallenges = MIN(numBlocks, nChallenges);	
 	vector<unsigned> toReturn;
 	while(toReturn.size() < nChallenges) {
 		unsigned rand = NTL::RandomBnd(numBlocks);
@@ -21,7 +27,7 @@ vector<unsigned> MerkleVerifier::generateChallenges() {
 												  toReturn.end(), rand);
 		if (it != toReturn.end())
 			continue;
-		toReturn.push_back(NTL::RandomBnd(numBlocks));
+		toReturn.push_back(rand);
 	}
 	return toReturn;
 }
@@ -29,27 +35,67 @@ vector<unsigned> MerkleVerifier::generateChallenges() {
 bool MerkleVerifier::verifyProofs(const hash_matrix &proofs){
 	bool valid = true;
 	unsigned i = 0;
+	HashContext ctx(contract.getAlg(), contract.getKey());
 	do {
 		vector<hashDirect> ith = proofs[i];
-		valid = checkProof(ith);
+		valid = checkProof(ith, ctx);
 		i++;
 	} while(valid && i < proofs.size());
 	return valid;
 }
 
-bool MerkleVerifier::checkProof(vector<hashDirect> &proof) {
-	if(proof.size() == 1){
-		proof[0].node.type = Hash::TYPE_MERKLE;
-		return (proof[0].node == root);
-	}
+bool MerkleVerifier::checkProof(vector<hashDirect> &proof, HashContext &ctx) {
 	for(unsigned i = 0; i < proof.size()-1; i++) {
 		if(proof[i+1].path[0]){
-			proof[i+1].node = contract.hash(proof[i].node, proof[i+1].node);
+			proof[i+1].node = ctx.digest(proof[i].node, proof[i+1].node);
 		} else {
-			proof[i+1].node = contract.hash(proof[i+1].node, proof[i].node);
+			proof[i+1].node = ctx.digest(proof[i+1].node, proof[i].node);
 		}
 	}
-	proof[proof.size()-1].node.type = Hash::TYPE_MERKLE;
-	return (proof[proof.size()-1].node == root);
+	return (proof[proof.size()-1].node.toHash(contract.getKey(), 
+											  Hash::TYPE_MERKLE) == root);
 }
 
+
+bool MerkleVerifier::verifyMultiProof(const multiProof &proof) const {
+	vector<unsigned> expected = challenges;
+	sort(expected.begin(), expected.end());
+	expected.erase(unique(expected.begin(), expected.end()), expected.end());
+	if(expected.empty() || proof.challenges != expected || 
+	   proof.leaves.size() != expected.size())
+		return false;
+
+	vector<unsigned> level;
+	for(unsigned i = 0; i < expected.size(); i++)
+		level.push_back(treeLeaves - 1 + expected[i]);
+	vector<Digest> values = proof.leaves;
+
+	// the same pass as MerkleProver::generateMultiProof, computing each
+	// parent from its children as they become known
+	HashContext ctx(contract.getAlg(), contract.getKey());
+	unsigned next = 0;
+	while(level[0] != 0) {
+		vector<unsigned> parents;
+		vector<Digest> parentValues;
+		for(unsigned i = 0; i < level.size(); i++) {
+			unsigned x = level[i];
+			if(x % 2 && i+1 < level.size() && level[i+1] == x+1) {
+				parentValues.push_back(ctx.digest(values[i], values[i+1]));
+				i++;
+			} else if(next == proof.siblings.size()) {
+				return false;
+			} else if(x % 2) {
+				parentValues.push_back(ctx.digest(values[i], 
+												  proof.siblings[next++]));
+			} else {
+				parentValues.push_back(ctx.digest(proof.siblings[next++], 
+												  values[i]));
+			}
+			parents.push_back((x-1)/2);
+		}
+		level.swap(parents);
+		values.swap(parentValues);
+	}
+	return (next == proof.siblings.size() &&
+			values[0].toHash(contract.getKey(), Hash::TYPE_MERKLE) == root);
+}
@@ -6,24 +6,33 @@
 class MerkleVerifier {
 
 	public:
+		static const unsigned NUM_CHALLENGES = 22;
+
+		/*! challenges min(numLeaves, nChallenges) random blocks */
 		MerkleVerifier(const hash_t &rt, unsigned numLeaves, 
-					   const MerkleContract &contract);	
+					   const MerkleContract &contract,
+					   unsigned nChallenges = NUM_CHALLENGES);	
 
 		vector<unsigned> getChallenges() const { return challenges; }
 		
 		/*! checks to see if each proof is valid (using checkProof) */
 		bool verifyProofs(const hash_matrix &proofs);
 
+		/*! checks a proof for all the challenged blocks at once, in one
+		 * pass up the tree */
+		bool verifyMultiProof(const multiProof &proof) const;
+
 	private:	
 		/*! generates pseudorandom challenges of the appropriate size */
-		vector<unsigned> generateChallenges();
+		vector<unsigned> generateChallenges(unsigned nChallenges);
 		
 		/*! checks an individual proof to see if it is valid */
-		bool checkProof(vector<hashDirect> &proof);
+		bool checkProof(vector<hashDirect> &proof, HashContext &ctx);
 		
 		MerkleContract contract;
 		hash_t root;
-		unsigned numBlocks;
+		unsigned numBlocks; // challenges are only for these
+		unsigned treeLeaves; // numBlocks rounded up to a power of two
 		vector<unsigned> challenges;
 };
 
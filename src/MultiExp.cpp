@@ -1,9 +1,11 @@
 #include "MultiExp.h"
-#include "Hash.h"
 #include "CommonFunctions.h"
-#include <ext/hash_map>
+#include <NTL/Montgomery.h>
+#include <NTL/Scratch.h>
+#include <list>
 #include <sys/time.h>
 #include <boost/thread/tss.hpp>
+#include <boost/unordered_map.hpp>
 
 using namespace std;
 
@@ -15,40 +17,93 @@ using namespace std;
 #define TV_DIFF_US(a, b) \
     (((b).tv_sec - (a).tv_sec) * 1000000 + ((b).tv_usec - (a).tv_usec))
 
-namespace __gnu_cxx {
-    template <>
-    struct hash<vector<ZZ> > {
-        size_t operator() (const vector<ZZ> &x) const {
-			// XXX SHA1 too slow?
-			hash_t h = Hash::hash(saveString(x), Hash::SHA1, string(), 
-								  Hash::TYPE_PLAIN);
-			// XXX need to base64_encode if hash<char*> wants a C string?
-            // return hash<const char*>()(base64_encode(h.data(), h.size()).c_str());
-            return hash<const char*>()(h.c_str());
-        }
-    };
-}
+// at most this many precomputed tables are kept per thread (LRU)
+#ifndef MULTIEXP_CACHE_ENTRIES
+#define MULTIEXP_CACHE_ENTRIES 256
+#endif
 
 struct MultiExpCacher {
 
-	// single cache entry: a precomputed table G_i
-	typedef vector<ZZ> cache_entry_t;
+	// single cache entry: the bases and modulus it was built for (compared
+	// in full on lookup) and the precomputed table G_i, whose entries are
+	// n limbs each in Montgomery form
+	struct cache_entry_t {
+		vector<ZZ> bases;
+		ZZ mod;
+		MontgomeryContext mont;
+		vector<mp_limb_t> G;
+	};
+
+	// the multi-exponentiation cache: entries in LRU order (most recently
+	// used first), indexed by a hash over the limbs of the bases and modulus
+	typedef list<cache_entry_t> lru_t;
+	typedef boost::unordered_multimap<size_t, lru_t::iterator> index_t;
+	lru_t lru;
+	index_t index;
 
-	// the multi-exponentiation cache
-	typedef __gnu_cxx::hash_map<hash_t, cache_entry_t> cache_t;
-	cache_t cache;
+	static size_t key(const vector<ZZ>& bases, const ZZ& mod) {
+		size_t h = HashLimbs(mod, bases.size());
+		for (unsigned i = 0; i < bases.size(); i++)
+			h = HashLimbs(bases[i], h);
+		return h;
+	}
+
+	// returns the cached entry for these bases, or 0 if there is none
+	const cache_entry_t* find(size_t h, const vector<ZZ>& bases, 
+							  const ZZ& mod) {
+		pair<index_t::iterator, index_t::iterator> r = index.equal_range(h);
+		for (index_t::iterator it = r.first; it != r.second; ++it) {
+			lru_t::iterator e = it->second;
+			if (e->mod == mod && e->bases == bases) {
+				lru.splice(lru.begin(), lru, e); // move to front
+				return &*e;
+			}
+		}
+		return 0;
+	}
 
-	ZZ exp(const vector<ZZ>& bases, const vector<ZZ>& exponents, const ZZ& mod) {
-		hash_t h = Hash::hash(saveString(bases) +
-							  ZZToBytes(mod), 
-							  Hash::SHA1, string(), Hash::TYPE_PLAIN);
-		//cout << "[MultiExpCacher::exp] multi-exp bases length " << bases.length() 
-		//	 << " hash " << base64_encode(h.c_str(), h.size()) << endl;
+	// like find, but leaves the LRU order alone
+	bool contains(const vector<ZZ>& bases, const ZZ& mod) const {
+		pair<index_t::const_iterator, index_t::const_iterator> r = 
+			index.equal_range(key(bases, mod));
+		for (index_t::const_iterator it = r.first; it != r.second; ++it) {
+			if (it->second->mod == mod && it->second->bases == bases)
+				return true;
+		}
+		return false;
+	}
 
-		vector<ZZ> G;
-		cache_t::iterator ci = cache.find(h);
+	// makes room for and returns a new entry for these bases, with an
+	// empty table
+	cache_entry_t& insert(size_t h, const vector<ZZ>& bases, const ZZ& mod) {
+		if (lru.size() >= MULTIEXP_CACHE_ENTRIES) {
+			// evict least recently used table
+			lru_t::iterator victim = --lru.end();
+			pair<index_t::iterator, index_t::iterator> r = 
+				index.equal_range(key(victim->bases, victim->mod));
+			for (index_t::iterator it = r.first; it != r.second; ++it) {
+				if (it->second == victim) {
+					index.erase(it);
+					break;
+				}
+			}
+			lru.erase(victim);
+		}
+		lru.push_front(cache_entry_t());
+		cache_entry_t& e = lru.front();
+		e.bases = bases;
+		e.mod = mod;
+		index.insert(make_pair(h, lru.begin()));
+		return e;
+	}
+
+	// mod must be odd (see MontgomeryContext::usable), exponents >= 0
+	void exp(ZZ& A, const vector<ZZ>& bases, const vector<ZZ>& exponents, 
+			 const ZZ& mod) {
+		size_t h = key(bases, mod);
+		const cache_entry_t* cached = find(h, bases, mod);
 		int blen = bases.size();
-		if (ci == cache.end()) {
+		if (cached == 0) {
 #ifdef PROFILE_MODEXP
 			misses++;
 #endif
@@ -57,57 +112,92 @@ struct MultiExpCacher {
 			// can only handle between 2 and 4 bases right now
 			assert(blen > 1 && blen <= 4);
 
-			vector<ZZ> Gi(1 << blen);
-			Gi[0] = to_ZZ(1);
-			if (blen > 1) {
-				Gi[1] = bases[0];
-				Gi[2] = bases[1];
-				Gi[3] = MulMod(bases[0], bases[1], mod);
-			}
-			if (blen > 2) {
-				Gi[4] = bases[2];
-				Gi[5] = MulMod(bases[0], Gi[4], mod);
-				Gi[6] = MulMod(bases[1], Gi[4], mod);
-				Gi[7] = MulMod(bases[0], Gi[6], mod);
+			cache_entry_t& e = insert(h, bases, mod);
+			e.mont.init(mod);
+			const MontgomeryContext& M = e.mont;
+			size_t n = M.size();
+			e.G.resize((1 << blen) * n);
+			ScratchFrame frame;
+			mp_limb_t* scratch = frame.limbs(M.scratchSize());
+			// G_i is the product of the bases whose bits are set in i
+			memcpy(&e.G[0], M.one(), n * sizeof(mp_limb_t));
+			for (int i = 1; i < (1 << blen); i++) {
+				int low = i & -i;
+				if (i == low) {
+					int j = 0;
+					while ((1 << j) != low)
+						j++;
+					M.toMont(&e.G[i*n], bases[j]);
+				} else {
+					M.mul(&e.G[i*n], &e.G[(i^low)*n], &e.G[low*n], scratch);
+				}
 			}
-			if (blen > 3) {
-				Gi[8]  = bases[3];
-				Gi[9]  = MulMod(bases[0], Gi[8], mod);
-				Gi[10] = MulMod(bases[1], Gi[8], mod);
-				Gi[11] = MulMod(bases[0], Gi[10], mod);
-				Gi[12] = MulMod(bases[2], Gi[8], mod);
-				Gi[13] = MulMod(bases[0], Gi[12], mod);
-				Gi[14] = MulMod(bases[1], Gi[12], mod);
-				Gi[15] = MulMod(bases[0], Gi[14], mod);
-			}
-			cache[h] = Gi;
-			G = Gi;
+			cached = &e;
 		} else {
 #ifdef PROFILE_MODEXP
 			hits++;
 #endif
-			G = ci->second;
 		}
+		const MontgomeryContext& M = cached->mont;
+		const mp_limb_t* G = &cached->G[0];
+		size_t n = M.size();
 
-		// simultaneous multiple exponentiation
-		ZZ A = to_ZZ(1);
+		// simultaneous multiple exponentiation, accumulated in Montgomery
+		// form in scratch limbs
+		ScratchFrame frame;
+		mp_limb_t* acc = frame.limbs(n + M.scratchSize());
+		mp_limb_t* scratch = acc + n;
+		memcpy(acc, M.one(), n * sizeof(mp_limb_t));
 		long t = 0; // max bits considered
 		for (int i=0; i < blen; i++)
 			t = max(t, NumBits(exponents[i]));
 
+		bool one = true;
 		for (long i=1; i <= t; i++) {
 			// A <- A * A
-			SqrMod(A, A, mod);
+			if (!one)
+				M.sqr(acc, acc, scratch);
 			
 			// A <- A * G_Ii
 			unsigned short expcol = 0;
 			for (int j=0; j < blen; j++)
 				expcol |= (bit(exponents[j], t-i) << j);
 
-			if (expcol)
-				MulMod(A, A, G[expcol], mod);
+			if (expcol) {
+				M.mul(acc, acc, G + expcol*n, scratch);
+				one = false;
+			}
+		}
+		M.fromMont(A, acc, scratch);
+	}
+
+	// the table only covers non-negative exponents: split the exponents
+	// into positive and negative parts and do one inversion at the end
+	void signedExp(ZZ& r, const vector<ZZ>& bases, 
+				   const vector<ZZ>& exponents, const ZZ& mod) {
+		bool negative = false;
+		for (unsigned i = 0; i < exponents.size(); i++)
+			if (sign(exponents[i]) < 0)
+				negative = true;
+		if (!negative) {
+			exp(r, bases, exponents, mod);
+			return;
+		}
+
+		vector<ZZ> pos(exponents.size()), neg(exponents.size());
+		for (unsigned i = 0; i < exponents.size(); i++) {
+			if (sign(exponents[i]) < 0)
+				neg[i] = -exponents[i];
+			else
+				pos[i] = exponents[i];
 		}
-		return A;
+		ZZ d;
+		exp(r, bases, pos, mod);
+		exp(d, bases, neg, mod);
+		if (!mpz_invert(MPZ(d), MPZ(d), MPZ(mod)))
+			throw CashException(CashException::CE_NTL_ERROR,
+				"[MultiExpCacher::signedExp] bases are not invertible");
+		MulMod(r, r, d, mod);
 	}
 
 #ifdef PROFILE_MULTIEXP
@@ -124,8 +214,264 @@ struct MultiExpCacher {
 
 boost::thread_specific_ptr<MultiExpCacher> multiexp_cache;
 
+/*
+ * General multi-exponentiation engine: used whenever the cached
+ * simultaneous-exponentiation table above can't be (more than 4 bases,
+ * negative exponents, or bases that won't be seen again).
+ *
+ * Two strategies are implemented, and MultiExpAuto() picks whichever has
+ * the lower estimated multiplication count for the given number of bases
+ * and exponent lengths:
+ *   - interleaved sliding windows: each base gets its own table of odd
+ *     powers and all bases share a single chain of squarings (good for a
+ *     handful of bases)
+ *   - Pippenger's bucket method: exponents are cut into c-bit windows, and
+ *     in each window every base is multiplied into the bucket named by its
+ *     digit; buckets are then combined with a running product (good for
+ *     many bases, since no per-base table is needed)
+ * Negative exponents are handled by inverting the base once up front.
+ */
+
+// replace b^e (e < 0) by (b^-1)^|e|, so the engines only see e >= 0
+static void normalizeSigns(vector<ZZ> &bs, vector<ZZ> &es, 
+						   const vector<ZZ> &bases, 
+						   const vector<ZZ> &exponents, const ZZ &modulus) {
+	bs = bases;
+	es = exponents;
+	for (unsigned i = 0; i < es.size(); i++) {
+		if (sign(es[i]) < 0) {
+			if (!mpz_invert(MPZ(bs[i]), MPZ(bases[i]), MPZ(modulus)))
+				throw CashException(CashException::CE_NTL_ERROR,
+					"[MultiExp] base %u is not invertible, but its exponent "
+					"is negative", i);
+			mpz_neg(MPZ(es[i]), MPZ(es[i]));
+		}
+	}
+}
+
+// window size minimizing 2^(w-1) table entries + bits/(w+1) multiplications
+static unsigned interleavedWindow(long bits) {
+	unsigned best = 1;
+	long bestCost = bits;
+	for (unsigned w = 2; w <= 7; w++) {
+		long cost = (1L << (w-1)) + bits/(w+1);
+		if (cost < bestCost) {
+			best = w;
+			bestCost = cost;
+		}
+	}
+	return best;
+}
+
+// bucket window size minimizing ceil(bits/c) * (nbases + 2^(c+1))
+static unsigned bucketWindow(long bits, long nbases, long *costOut = 0) {
+	unsigned best = 1;
+	long bestCost = -1;
+	for (unsigned c = 1; c <= 16; c++) {
+		long cost = ((bits + c - 1) / c) * (nbases + (2L << c));
+		if (bestCost < 0 || cost < bestCost) {
+			best = c;
+			bestCost = cost;
+		}
+	}
+	if (costOut) *costOut = bestCost;
+	return best;
+}
+
+// one sliding window: multiply by table[digit/2] once the squaring chain
+// has reached bit position pos
+struct exp_window {
+	long pos;
+	unsigned digit;
+};
+
+static void interleaved(ZZ &A, const vector<ZZ> &bases, const vector<ZZ> &exps,
+						const ZZ &mod) {
+	unsigned n = bases.size();
+	long t = 0;
+	vector<vector<ZZ> > tables(n);
+	vector<vector<exp_window> > windows(n);
+	for (unsigned i = 0; i < n; i++) {
+		long bits = NumBits(exps[i]);
+		t = max(t, bits);
+		if (bits == 0)
+			continue;
+		unsigned w = interleavedWindow(bits);
+
+		// odd powers b, b^3, ..., b^(2^w-1)
+		vector<ZZ> &tab = tables[i];
+		tab.resize(1 << (w-1));
+		tab[0] = bases[i] % mod;
+		if (tab.size() > 1) {
+			ZZ b2;
+			SqrMod(b2, tab[0], mod);
+			for (unsigned j = 1; j < tab.size(); j++)
+				MulMod(tab[j], tab[j-1], b2, mod);
+		}
+
+		// left-to-right sliding window decomposition of exps[i]
+		for (long k = bits - 1; k >= 0; ) {
+			if (!bit(exps[i], k)) {
+				k--;
+				continue;
+			}
+			long l = max(k - (long)w + 1, 0L);
+			while (!bit(exps[i], l))
+				l++;
+			exp_window win;
+			win.pos = l;
+			win.digit = 0;
+			for (long j = k; j >= l; j--)
+				win.digit = (win.digit << 1) | bit(exps[i], j);
+			windows[i].push_back(win);
+			k = l - 1;
+		}
+	}
+
+	A = 1;
+	bool one = true; // skip squarings until A picks up a factor
+	vector<unsigned> next(n, 0);
+	for (long k = t - 1; k >= 0; k--) {
+		if (!one)
+			SqrMod(A, A, mod);
+		for (unsigned i = 0; i < n; i++) {
+			if (next[i] < windows[i].size() && windows[i][next[i]].pos == k) {
+				const ZZ &f = tables[i][windows[i][next[i]].digit >> 1];
+				if (one) {
+					A = f;
+					one = false;
+				} else {
+					MulMod(A, A, f, mod);
+				}
+				next[i]++;
+			}
+		}
+	}
+}
+
+// c-bit digit of e starting at bit position pos
+static inline unsigned digitAt(const ZZ &e, long pos, unsigned c) {
+	unsigned d = 0;
+	for (unsigned j = 0; j < c; j++)
+		d |= bit(e, pos + j) << j;
+	return d;
+}
+
+static void pippenger(ZZ &A, const vector<ZZ> &bases, const vector<ZZ> &exps,
+					  const ZZ &mod) {
+	unsigned n = bases.size();
+	long t = 0;
+	for (unsigned i = 0; i < n; i++)
+		t = max(t, NumBits(exps[i]));
+	unsigned c = bucketWindow(t, n);
+	long numWindows = (t + c - 1) / c;
+
+	// buckets[d-1] collects all bases whose current digit is d
+	vector<ZZ> buckets((1 << c) - 1);
+	vector<bool> used(buckets.size());
+	ZZ S, T;
+
+	A = 1;
+	bool one = true;
+	for (long win = numWindows - 1; win >= 0; win--) {
+		if (!one)
+			for (unsigned j = 0; j < c; j++)
+				SqrMod(A, A, mod);
+
+		std::fill(used.begin(), used.end(), false);
+		for (unsigned i = 0; i < n; i++) {
+			unsigned d = digitAt(exps[i], win * c, c);
+			if (d == 0)
+				continue;
+			if (used[d-1]) {
+				MulMod(buckets[d-1], buckets[d-1], bases[i], mod);
+			} else {
+				buckets[d-1] = bases[i] % mod;
+				used[d-1] = true;
+			}
+		}
+
+		// T = prod_d buckets[d]^d, via running products S (suffix product 
+		// of buckets) and T (product of all suffixes)
+		bool sOne = true, tOne = true;
+		for (long d = buckets.size() - 1; d >= 0; d--) {
+			if (used[d]) {
+				if (sOne) {
+					S = buckets[d];
+					sOne = false;
+				} else {
+					MulMod(S, S, buckets[d], mod);
+				}
+			}
+			if (!sOne) {
+				if (tOne) {
+					T = S;
+					tOne = false;
+				} else {
+					MulMod(T, T, S, mod);
+				}
+			}
+		}
+		if (!tOne) {
+			if (one) {
+				A = T;
+				one = false;
+			} else {
+				MulMod(A, A, T, mod);
+			}
+		}
+	}
+}
+
+void MultiExpInterleaved(ZZ &result, const vector<ZZ> &bases, 
+						 const vector<ZZ> &exponents, const ZZ &modulus) {
+	vector<ZZ> bs, es;
+	normalizeSigns(bs, es, bases, exponents, modulus);
+	interleaved(result, bs, es, modulus);
+}
+
+void MultiExpPippenger(ZZ &result, const vector<ZZ> &bases, 
+					   const vector<ZZ> &exponents, const ZZ &modulus) {
+	vector<ZZ> bs, es;
+	normalizeSigns(bs, es, bases, exponents, modulus);
+	pippenger(result, bs, es, modulus);
+}
+
+bool MultiExpPicksPippenger(const vector<ZZ> &exponents) {
+	// estimate multiplications (excluding the shared squarings) for each
+	long t = 0, interleavedCost = 0, bucketCost;
+	for (unsigned i = 0; i < exponents.size(); i++) {
+		long bits = NumBits(exponents[i]);
+		unsigned w = interleavedWindow(bits);
+		t = max(t, bits);
+		interleavedCost += (1L << (w-1)) + bits/(w+1);
+	}
+	bucketWindow(t, exponents.size(), &bucketCost);
+	return bucketCost < interleavedCost;
+}
+
+void MultiExpAuto(ZZ &result, const vector<ZZ> &bases, 
+				  const vector<ZZ> &exponents, const ZZ &modulus) {
+	vector<ZZ> bs, es;
+	normalizeSigns(bs, es, bases, exponents, modulus);
+	if (MultiExpPicksPippenger(es))
+		pippenger(result, bs, es, modulus);
+	else
+		interleaved(result, bs, es, modulus);
+}
+
+
 #define USE_MULTIEXP
 
+size_t MultiExpCacheCapacity() {
+	return MULTIEXP_CACHE_ENTRIES;
+}
+
+bool MultiExpCached(const vector<ZZ> &bases, const ZZ &modulus) {
+	return multiexp_cache.get() != 0 && 
+		   multiexp_cache->contains(bases, modulus);
+}
+
 #ifdef PROFILE_MULTIEXP
 ZZ MultiExp_(const vector<ZZ> &bases, const vector<ZZ> &exponents, 
 			 const ZZ &modulus, bool cacheBases, const char* fn, unsigned line)
@@ -149,15 +495,9 @@ ZZ MultiExp(const vector<ZZ> &bases, const vector<ZZ> &exponents,
 		multiexp_cache.reset(new MultiExpCacher());
 
 	// can we use the multi-exponentiation optimization?
-	multiexp_ok = (bases.size() <= 4 && bases.size() >= 2) && cacheBases;
-	if (multiexp_ok) 
-		for (unsigned i=0; i < exponents.size(); i++) {
-		// XXX multi-exponentiation doesn't work with negative exponents right now
-		if (exponents[i] < 0) {
-			multiexp_ok = false;
-			break;
-		}
-	}
+	// (the tables are in Montgomery form, which needs an odd modulus)
+	multiexp_ok = (bases.size() <= 4 && bases.size() >= 2) && cacheBases &&
+				  MontgomeryContext::usable(modulus);
 #endif
 
 	ZZ result = to_ZZ(1);
@@ -170,22 +510,23 @@ ZZ MultiExp(const vector<ZZ> &bases, const vector<ZZ> &exponents,
 
 #ifdef USE_MULTIEXP
 	if (multiexp_ok) {
-		result = multiexp_cache->exp(bases, exponents, modulus);
-#ifdef MULTIEXP_DOUBLE_CHECK
-		ZZ check = to_ZZ(1);
-		for(unsigned i = 0; i < bases.size(); i++)
-			check = MulMod(check, PowerMod(bases[i], exponents[i], modulus), 
-						   modulus);
-		assert(check == result);
-#endif
+		multiexp_cache->signedExp(result, bases, exponents, modulus);
 	} else {
-#endif
-		// regular, slow MulMod + PowerMod exponentiation: probably okay for 2 bases?
-		for(unsigned i = 0; i < bases.size(); i++)
-			result = MulMod(result, PowerMod(bases[i], exponents[i], modulus), 
-							modulus);
-#ifdef USE_MULTIEXP
+		// interleaved windows or Pippenger buckets, whichever is cheaper
+		MultiExpAuto(result, bases, exponents, modulus);
 	}
+#else
+	// regular, slow MulMod + PowerMod exponentiation
+	for(unsigned i = 0; i < bases.size(); i++)
+		result = MulMod(result, PowerMod(bases[i], exponents[i], modulus), 
+						modulus);
+#endif
+#ifdef MULTIEXP_DOUBLE_CHECK
+	ZZ check = to_ZZ(1);
+	for(unsigned i = 0; i < bases.size(); i++)
+		check = MulMod(check, PowerMod(bases[i], exponents[i], modulus), 
+					   modulus);
+	assert(check == result);
 #endif
 
 #ifdef PROFILE_MULTIEXP
@@ -26,4 +26,23 @@ ZZ MultiExp_(const vector<ZZ> &bases, const vector<ZZ> &exponents,
 #define MultiExpOnce(b,e,m) MultiExp_((b),(e),(m),false,__FILE__,__LINE__)
 #endif
 
+// MultiExp keeps the tables for 2 to 4 bases in a per-thread cache, which
+// drops the least recently used table once it holds this many
+size_t MultiExpCacheCapacity();
+// true if this thread's cache has a table for bases (doesn't count as a use)
+bool MultiExpCached(const vector<ZZ> &bases, const ZZ &modulus);
+
+// uncached multi-exponentiation engines (exponents may be negative)
+// interleaved sliding windows: best for a few bases
+void MultiExpInterleaved(ZZ &result, const vector<ZZ> &bases, 
+						 const vector<ZZ> &exponents, const ZZ &modulus);
+// Pippenger's bucket method: best for many bases
+void MultiExpPippenger(ZZ &result, const vector<ZZ> &bases, 
+					   const vector<ZZ> &exponents, const ZZ &modulus);
+// picks one of the above from the number of bases and exponent lengths
+void MultiExpAuto(ZZ &result, const vector<ZZ> &bases, 
+				  const vector<ZZ> &exponents, const ZZ &modulus);
+// true if MultiExpAuto would use Pippenger's method for these exponents
+bool MultiExpPicksPippenger(const vector<ZZ> &exponents);
+
 #endif
@@ -0,0 +1,107 @@
+#ifndef __MONTGOMERY_H__
+#define __MONTGOMERY_H__
+#include <NTL/ZZ.h>
+#include <vector>
+#include <string.h>
+
+namespace NTL {
+
+/*
+ * Montgomery multiplication modulo a fixed odd modulus m of n limbs,
+ * working directly on limb arrays with GMP's mpn_ functions.
+ *
+ * Numbers are kept in Montgomery form, x*R mod m with R = 2^(n*GMP_NUMB_BITS),
+ * as arrays of exactly n limbs.  mul() and sqr() take a caller-provided
+ * scratch area of scratchSize() limbs, so the inner loops of the cached
+ * exponentiation code do no allocation and no division.
+ */
+class MontgomeryContext {
+public:
+	MontgomeryContext() : n(0), minv(0) {}
+	explicit MontgomeryContext(const ZZ& mod) { init(mod); }
+
+	static bool usable(const ZZ& mod) { return mod > 1 && IsOdd(mod); }
+
+	void init(const ZZ& mod) {
+		if (!usable(mod))
+			throw CashException(CashException::CE_NTL_ERROR,
+				"MontgomeryContext: modulus must be odd");
+		n = mpz_size(MPZ(mod));
+		modulus = mod;
+		m.assign(mpz_limbs_read(MPZ(mod)), mpz_limbs_read(MPZ(mod)) + n);
+		// -m^-1 mod 2^GMP_NUMB_BITS by Newton iteration; m*m = 1 mod 8
+		// so the first guess is good to 3 bits, and each step doubles that
+		mp_limb_t inv = m[0];
+		for (int i = 0; i < 6; i++)
+			inv *= 2 - m[0] * inv;
+		minv = -inv;
+		oneR.resize(n);
+		toMont(&oneR[0], ZZ(1));
+	}
+
+	mp_size_t size() const { return n; }
+	size_t scratchSize() const { return 2*n; }
+	const mp_limb_t* one() const { return &oneR[0]; }
+
+	// r = t*R^-1 mod m, where t has 2n limbs (and is destroyed)
+	void redc(mp_limb_t* r, mp_limb_t* t) const {
+		mp_limb_t hi = 0;
+		for (mp_size_t i = 0; i < n; i++) {
+			mp_limb_t c = mpn_addmul_1(t + i, &m[0], n, t[i] * minv);
+			hi += mpn_add_1(t + i + n, t + i + n, n - i, c);
+		}
+		// now t[n..2n) + hi*R < 2m
+		if (hi || mpn_cmp(t + n, &m[0], n) >= 0)
+			mpn_sub_n(r, t + n, &m[0], n);
+		else
+			memmove(r, t + n, n * sizeof(mp_limb_t));
+	}
+
+	// r = a*b*R^-1 mod m; r may alias a or b
+	void mul(mp_limb_t* r, const mp_limb_t* a, const mp_limb_t* b,
+			 mp_limb_t* scratch) const {
+		mpn_mul_n(scratch, a, b, n);
+		redc(r, scratch);
+	}
+
+	void sqr(mp_limb_t* r, const mp_limb_t* a, mp_limb_t* scratch) const {
+		mpn_sqr(scratch, a, n);
+		redc(r, scratch);
+	}
+
+	// r = x*R mod m, as n limbs
+	void toMont(mp_limb_t* r, const ZZ& x) const {
+		ZZ t;
+		mpz_mod(MPZ(t), MPZ(x), MPZ(modulus));
+		mpz_mul_2exp(MPZ(t), MPZ(t), n * GMP_NUMB_BITS);
+		mpz_mod(MPZ(t), MPZ(t), MPZ(modulus));
+		size_t tn = mpz_size(MPZ(t));
+		if (tn)
+			memcpy(r, mpz_limbs_read(MPZ(t)), tn * sizeof(mp_limb_t));
+		memset(r + tn, 0, (n - tn) * sizeof(mp_limb_t));
+	}
+
+	ZZ toMont(const ZZ& x) const {
+		ZZ r;
+		toMont(mpz_limbs_write(MPZ(r), n), x);
+		mpz_limbs_finish(MPZ(r), n);
+		return r;
+	}
+
+	// x = a*R^-1 mod m
+	void fromMont(ZZ& x, const mp_limb_t* a, mp_limb_t* scratch) const {
+		memcpy(scratch, a, n * sizeof(mp_limb_t));
+		memset(scratch + n, 0, n * sizeof(mp_limb_t));
+		redc(mpz_limbs_write(MPZ(x), n), scratch);
+		mpz_limbs_finish(MPZ(x), n);
+	}
+
+private:
+	mp_size_t n;
+	mp_limb_t minv;
+	std::vector<mp_limb_t> m, oneR;
+	ZZ modulus;
+};
+
+} // end namespace NTL
+#endif // __MONTGOMERY_H__
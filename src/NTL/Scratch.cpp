@@ -0,0 +1,24 @@
+#include "Scratch.h"
+#include <boost/thread/tss.hpp>
+
+namespace NTL {
+
+static boost::thread_specific_ptr<ScratchArena> arenas;
+
+ScratchArena& ScratchArena::get() {
+	// init arena for this thread (Boost will delete)
+	if (arenas.get() == 0)
+		arenas.reset(new ScratchArena());
+	return *arenas;
+}
+
+ScratchArena::~ScratchArena() {
+	for (size_t i = 0; i < zzs.size(); i++)
+		delete zzs[i];
+	for (size_t i = 0; i < vecs.size(); i++)
+		delete vecs[i];
+	for (size_t i = 0; i < limbs.size(); i++)
+		delete limbs[i];
+}
+
+} // end namespace NTL
@@ -0,0 +1,84 @@
+#ifndef __SCRATCH_H__
+#define __SCRATCH_H__
+#include <NTL/ZZ.h>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace NTL {
+
+/*
+ * Per-thread pools of scratch ZZs, ZZ vectors and limb buffers.
+ *
+ * Temporaries in the exponentiation paths are taken from the pools and
+ * handed back instead of being constructed and destroyed on every call,
+ * so once a thread has warmed up their limbs are already allocated at
+ * the right size and assigning to them doesn't touch the heap.
+ *
+ * Use through a ScratchFrame, which returns everything taken through it
+ * when it goes out of scope (frames nest like the stack).
+ */
+class ScratchArena : private boost::noncopyable {
+public:
+	/* this thread's arena */
+	static ScratchArena& get();
+
+	~ScratchArena();
+
+private:
+	friend class ScratchFrame;
+	ScratchArena() : zzTop(0), vecTop(0), limbTop(0) {}
+
+	std::vector<ZZ*> zzs;
+	std::vector<std::vector<ZZ>*> vecs;
+	std::vector<std::vector<mp_limb_t>*> limbs;
+	size_t zzTop, vecTop, limbTop;
+};
+
+class ScratchFrame : private boost::noncopyable {
+public:
+	ScratchFrame() : arena(ScratchArena::get()), zzTop(arena.zzTop),
+					 vecTop(arena.vecTop), limbTop(arena.limbTop) {}
+	~ScratchFrame() {
+		arena.zzTop = zzTop;
+		arena.vecTop = vecTop;
+		arena.limbTop = limbTop;
+	}
+
+	/* a scratch ZZ, with whatever value it last had */
+	ZZ& zz() {
+		if (arena.zzTop == arena.zzs.size())
+			arena.zzs.push_back(new ZZ());
+		return *arena.zzs[arena.zzTop++];
+	}
+
+	/* a vector of exactly n scratch ZZs, with whatever values they last
+	 * had; don't resize it */
+	std::vector<ZZ>& vec(size_t n) {
+		// resizing would destroy or create ZZs, so look for a free vector
+		// of the right size and move it to the top of the stack
+		size_t i = arena.vecTop;
+		while (i < arena.vecs.size() && arena.vecs[i]->size() != n)
+			i++;
+		if (i == arena.vecs.size())
+			arena.vecs.push_back(new std::vector<ZZ>(n));
+		std::swap(arena.vecs[i], arena.vecs[arena.vecTop]);
+		return *arena.vecs[arena.vecTop++];
+	}
+
+	/* n scratch limbs */
+	mp_limb_t* limbs(size_t n) {
+		if (arena.limbTop == arena.limbs.size())
+			arena.limbs.push_back(new std::vector<mp_limb_t>());
+		std::vector<mp_limb_t>& v = *arena.limbs[arena.limbTop++];
+		if (v.size() < n)
+			v.resize(n);
+		return &v[0];
+	}
+
+private:
+	ScratchArena& arena;
+	size_t zzTop, vecTop, limbTop;
+};
+
+} // end namespace NTL
+#endif // __SCRATCH_H__
@@ -1,15 +1,73 @@
 #include "ZZ.h"
 #include <stdlib.h>
 #include <math.h>
+#include <openssl/rand.h>
+#include <openssl/opensslv.h>
+#include <boost/thread/mutex.hpp>
 
 namespace NTL {
 
-static gmp_randclass _randstate(gmp_randinit_default);
- 
-void SetSeed(const ZZ& z) { _randstate.seed(z); }
-void SetSeed(unsigned long int l) { _randstate.seed(l); }
-ZZ RandomBnd(const ZZ& n) { return _randstate.get_z_range(n); }
-ZZ RandomBits_ZZ(long l) { return _randstate.get_z_bits(l); }
+/* Nonces, blinding factors and batch multipliers come from OpenSSL's
+ * CSPRNG, which seeds itself from the OS.  OpenSSL 1.1 and later lock
+ * internally, so ThreadPool workers draw without waiting on each other;
+ * older versions are only safe with locking callbacks, so there draws go
+ * through _randLock.
+ *
+ * SetSeed switches to GMP's Mersenne Twister, seeded with the given value,
+ * so a test run can be repeated.  Its output is predictable: nothing but
+ * tests may call it, and only before any other thread draws.  That
+ * generator is shared, so its draws are always locked. */
+static boost::mutex* _randLock = new boost::mutex();
+static gmp_randclass* _seeded = NULL;
+
+void SetSeed(const ZZ& z) {
+	boost::mutex::scoped_lock l(*_randLock);
+	if (!_seeded)
+		_seeded = new gmp_randclass(gmp_randinit_default);
+	_seeded->seed(z);
+}
+
+void SetSeed(unsigned long int l) { SetSeed(to_ZZ(l)); }
+
+static void randomBytes(unsigned char *buf, size_t len) {
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	boost::mutex::scoped_lock l(*_randLock);
+#endif
+	if (RAND_bytes(buf, len) != 1)
+		throw CashException(CashException::CE_OPENSSL_ERROR,
+			"NTL::RandomBits_ZZ: RAND_bytes failed");
+}
+
+ZZ RandomBits_ZZ(long l) {
+	ZZ r;
+	if (l <= 0)
+		return r;
+	if (_seeded) {
+		boost::mutex::scoped_lock lock(*_randLock);
+		return _seeded->get_z_bits(l);
+	}
+	std::vector<unsigned char> bytes((l + 7) / 8);
+	randomBytes(&bytes[0], bytes.size());
+	mpz_import(MPZ(r), bytes.size(), 1, 1, 1, 0, &bytes[0]);
+	mpz_tdiv_r_2exp(MPZ(r), MPZ(r), l);
+	return r;
+}
+
+ZZ RandomBnd(const ZZ& n) {
+	if (n <= 1)
+		return to_ZZ(0);
+	if (_seeded) {
+		boost::mutex::scoped_lock lock(*_randLock);
+		return _seeded->get_z_range(n);
+	}
+	// rejection sampling, so every value below n is equally likely
+	long l = NumBits(n);
+	ZZ r;
+	do {
+		r = RandomBits_ZZ(l);
+	} while (r >= n);
+	return r;
+}
 
 #define Error(x) throw CashException(CashException::CE_NTL_ERROR, x)
 
@@ -25,6 +25,9 @@ typedef mpz_class ZZ;
 #define MPZ(x) (x).get_mpz_t() // helpful for using mpz_ functions
 #define to_ZZ(x) ZZ(x) // mpz_class constructor handles NTL::to_ZZ cases
 
+// RandomBnd and RandomBits_ZZ draw from OpenSSL's CSPRNG.  SetSeed makes
+// them a predictable, repeatable sequence instead: for tests only, and
+// called before any other thread draws.
 void SetSeed(const ZZ& z);
 void SetSeed(unsigned long int l);
 
@@ -75,7 +78,8 @@ inline ZZ InvMod(const ZZ& a, const ZZ& n) {
 }
 
 inline void SqrMod(ZZ& x, const ZZ& a, const ZZ& n) { // x = a^2 % n
-	mpz_powm_ui(MPZ(x), MPZ(a), 2, MPZ(n));
+	mpz_mul(MPZ(x), MPZ(a), MPZ(a));
+	mpz_mod(MPZ(x), MPZ(x), MPZ(n));
 }
 
 inline void add(ZZ& r, const ZZ& a, const ZZ& b) { 
@@ -179,6 +183,16 @@ inline long compare(const ZZ& a, const ZZ& b) { // returns sign of a-b (-1, 0, o
 
 inline void swap(ZZ& x, ZZ& y) { mpz_swap(MPZ(x), MPZ(y)); }
 
+// cheap non-cryptographic hash over the raw limbs of a (not in NTL)
+inline size_t HashLimbs(const ZZ& a, size_t seed = 0) {
+	const mp_limb_t* limbs = mpz_limbs_read(MPZ(a));
+	size_t n = mpz_size(MPZ(a));
+	seed ^= sign(a) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	for (size_t i = 0; i < n; i++)
+		seed ^= size_t(limbs[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
 /* copy-pasted from NTL ZZ.c */
 void GenPrime(ZZ& n, long l, long err);
 inline ZZ GenPrime_ZZ(long l, long err = 80) { ZZ r; GenPrime(r, l, err); return r; }
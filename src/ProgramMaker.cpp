@@ -2,7 +2,6 @@
 #include "ProgramMaker.h"
 #include <assert.h>
 #include "ZKP/ASTNode.h"
-#include <fstream>
 
 string ProgramMaker::makeCLObtain(const gen_group_map &grps, 
 								  const vector<CommitmentInfo> &coms) {
@@ -29,17 +28,7 @@ string ProgramMaker::makeCLObtain(const string &grpPart, const string &comPart,
 							"for(i, 1:l, range in pkGroup: (-(2^l_x-1)) <= x_i < 2^l_x) "
 							"C = h^vprime * for(i, 1:l, *, g_i^x_i) ";
 	program += comRelPart;
-	// now write this to file and return the file name
-	ofstream writer;
-	string fname = "ZKP/examples/cl-obtain-temp.txt";
-	writer.open(fname.c_str(), ios::out);
-	if (!writer)
-		throw CashException(CashException::CE_PARSE_ERROR,
-			"[ProgramMaker::makeCLObtain]: Could not write program to file");
-
-	writer << program;
-	writer.close();
-	return fname;
+	return program;
 }
 
 string ProgramMaker::makeCLProve(const gen_group_map &grps, 
@@ -73,16 +62,7 @@ string ProgramMaker::makeCLProve(const string &grpPart, const string &comPart,
 							"C = h^r_C * for(i, 1:l, *, g_i^x_i) "
 							"f = C^(-1) * D^(-1) * (Aprime^e) * h^(r_C-vprime)";
 	program += " " + comRelPart;
-	// again, write to file and return filename
-	ofstream writer;
-	string fname = "ZKP/examples/cl-prove-temp.txt";
-	writer.open(fname.c_str(), ios::out);
-	if (!writer)
-		throw CashException(CashException::CE_PARSE_ERROR,
-			"[ProgramMaker::makeCLProve]: Could not write program to file");
-	writer << program;
-	writer.close();
-	return fname;
+	return program;
 }
 
 string ProgramMaker::makeGeneratorList(const vector<string> &genNames) {
@@ -33,7 +33,8 @@ class ProgramMaker {
 		ProgramMaker() {}
 
 		/*! given the various group and commitment names, creates a CL
-		 * program for obtaining a signature */
+		 * program for obtaining a signature; returns the program text, to
+		 * be compiled with Interpreter::checkSource */
 		static string makeCLObtain(const string &grpPart,
 								   const string &comPart,
 								   const string &comRelPart);
@@ -41,6 +42,7 @@ class ProgramMaker {
 		static string makeCLObtain(const gen_group_map &grps, 
 								   const vector<CommitmentInfo> &coms);
 
+		/*! same, for a program proving knowledge of a CL signature */
 		static string makeCLProve(const string &grpPart, const string &comPart,
 								  const string &comRelPart);
 
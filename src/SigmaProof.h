@@ -43,13 +43,13 @@ class SigmaProof {
 		/*! sets our responses */
 		void setResponse(var_map &rs) { responses = rs; }
 
-		var_map getCommitments() const { return commitments; }
+		const var_map& getCommitments() const { return commitments; }
 
 		/*! gets a vector of possible first-round messages */
-		var_map getRandomizedProofs() const { return randomizedProofs; }
+		const var_map& getRandomizedProofs() const { return randomizedProofs; }
 
 		/*! gets our third-round messages */
-		var_map getResponses() const { return responses; }
+		const var_map& getResponses() const { return responses; }
 
 		// XXX: what about commitments?
 		bool operator==(const SigmaProof& other) {
@@ -75,4 +75,26 @@ class SigmaProof {
 		}
 };
 
+/*! \brief The parts of a sigma proof that can be computed before every
+ * value is known (see InterpreterProver::prepareProof): the random
+ * exponents, and for each relation its randomized proof and commitment,
+ * along with a digest of the values of its bases and exponents, so that
+ * a relation whose values have changed since is computed again.  Holds
+ * secrets, and must be used for one proof only. */
+struct PreparedProof {
+	var_map randExps;
+	var_map randomizedProofs;
+	var_map commitments;
+	var_map digests;
+
+	friend class boost::serialization::access;
+	template <class Archive>
+	void serialize(Archive& ar, const unsigned int ver) {
+		ar	& auto_nvp(randExps)
+			& auto_nvp(randomizedProofs)
+			& auto_nvp(commitments)
+			& auto_nvp(digests);
+	}
+};
+
 #endif /*SIGMAPROOF_H_*/
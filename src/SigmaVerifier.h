@@ -34,7 +34,7 @@ class SigmaVerifier {
 		virtual bool verify(var_map &response) = 0;
 
 		/*! will get first-round message of the sigma proof */
-		var_map getRandomizedProofs() const { return rProof; }
+		const var_map& getRandomizedProofs() const { return rProof; }
 
 	protected:
 		/*! to be used by getChallenge if canGenerateNewChallenge
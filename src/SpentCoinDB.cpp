@@ -0,0 +1,361 @@
+#include "SpentCoinDB.h"
+#include "Hash.h"
+#include "CashException.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace NTL;
+
+#define SPENTDB_MAGIC "CASHSPNT"
+#define SPENTDB_RECORD_MAGIC 0x53504e44u
+// records start (and are padded to) multiples of this
+#define SPENTDB_ALIGN 8
+#define SPENTDB_INITIAL_SIZE (1 << 20)
+// smallest number of keys the filter is sized for
+#define SPENTDB_FILTER_ITEMS (1 << 20)
+
+struct file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t keyBytes;
+	// every record before this offset has been synced to disk
+	uint64_t synced;
+	// the saved filter holds the keys of the records before this offset
+	// (0 if there is none)
+	uint64_t filterEnd;
+	char unused[32];
+};
+
+struct record_header {
+	uint32_t magic;
+	uint16_t tLen, rLen;
+	uint64_t checksum; // of the record, with this field set to 0
+	unsigned char key[SpentCoinDB::KEY_BYTES];
+	uint32_t unused;
+	// followed by tLen bytes of T' and rLen bytes of R
+};
+
+static size_t align(size_t n) {
+	return (n + SPENTDB_ALIGN - 1) / SPENTDB_ALIGN * SPENTDB_ALIGN;
+}
+
+// FNV-1a: records are small and only need protecting from torn writes
+static uint64_t fnv(uint64_t h, const unsigned char *p, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static uint64_t checksum(record_header rh, const char *body) {
+	rh.checksum = 0;
+	uint64_t h = fnv(14695981039346656037ULL,
+					 (const unsigned char*) &rh, sizeof(rh));
+	return fnv(h, (const unsigned char*) body, rh.tLen + rh.rLen);
+}
+
+static void fail(const string &fname, const char *what) {
+	throw CashException(CashException::CE_IO_ERROR,
+		"[SpentCoinDB] %s: %s (%s)", fname.c_str(), what, strerror(errno));
+}
+
+SpentCoinDB::SpentCoinDB(const string &fname, bool syncEach, double fpRate)
+	: fname(fname), syncEach(syncEach), fd(-1), data(0), mapped(0), end(0),
+	  fpRate(fpRate)
+{
+	memset(&stats, 0, sizeof(stats));
+	fd = open(fname.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		fail(fname, "cannot open");
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		fail(fname, "cannot stat");
+
+	if (st.st_size == 0) {
+		file_header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, SPENTDB_MAGIC, sizeof(h.magic));
+		h.version = VERSION;
+		h.keyBytes = KEY_BYTES;
+		h.synced = align(sizeof(h));
+		if (write(fd, &h, sizeof(h)) != (ssize_t) sizeof(h) || fsync(fd))
+			fail(fname, "cannot write header");
+		st.st_size = sizeof(h);
+	}
+	if ((size_t) st.st_size < sizeof(file_header)) {
+		::close(fd);
+		throw CashException(CashException::CE_IO_ERROR,
+			"[SpentCoinDB] %s: not a spent coin file", fname.c_str());
+	}
+	grow(max((size_t) st.st_size, (size_t) SPENTDB_INITIAL_SIZE));
+
+	file_header h;
+	memcpy(&h, data, sizeof(h));
+	if (memcmp(h.magic, SPENTDB_MAGIC, sizeof(h.magic)) != 0 ||
+		h.version != VERSION || h.keyBytes != KEY_BYTES) {
+		munmap(data, mapped);
+		::close(fd);
+		throw CashException(CashException::CE_IO_ERROR,
+			"[SpentCoinDB] %s: not a version %u spent coin file",
+			fname.c_str(), VERSION);
+	}
+	size_t filterItems;
+	try {
+		filterItems = recover();
+	} catch (CashException &e) {
+		munmap(data, mapped);
+		::close(fd);
+		throw;
+	}
+	stats.loaded = loadFilter(filterItems);
+	if (!stats.loaded)
+		rebuildFilter(max((size_t) SPENTDB_FILTER_ITEMS, 2 * index.size()));
+}
+
+SpentCoinDB::~SpentCoinDB() {
+	try {
+		saveFilter();
+	} catch (CashException &e) {
+		// the next open rebuilds the filter (or, with a stale synced end,
+		// can't tell damage from an unsynced tail past it)
+	}
+	munmap(data, mapped);
+	::close(fd);
+}
+
+string SpentCoinDB::serialKey(const ZZ &sPrime) {
+	return Hash::hash(ZZToBytes(sPrime), Hash::SHA1, string(),
+					  Hash::TYPE_PLAIN).str();
+}
+
+uint64_t SpentCoinDB::prefix(const string &key) {
+	uint64_t p = 0;
+	memcpy(&p, key.data(), min(key.size(), sizeof(p)));
+	return p;
+}
+
+bool SpentCoinDB::validRecord(size_t off) const {
+	if (off + sizeof(record_header) > mapped)
+		return false;
+	record_header rh;
+	memcpy(&rh, data + off, sizeof(rh));
+	return rh.magic == SPENTDB_RECORD_MAGIC &&
+		   off + sizeof(rh) + rh.tLen + rh.rLen <= mapped &&
+		   rh.checksum == checksum(rh, data + off + sizeof(rh));
+}
+
+size_t SpentCoinDB::recover() {
+	file_header h;
+	memcpy(&h, data, sizeof(h));
+	size_t off = align(sizeof(file_header));
+	size_t filterItems = NO_FILTER;
+	while (validRecord(off)) {
+		if (off == h.filterEnd)
+			filterItems = index.size();
+		record_header rh;
+		memcpy(&rh, data + off, sizeof(rh));
+		index.insert(make_pair(prefix(string((const char*) rh.key,
+											 KEY_BYTES)), off));
+		off = align(off + sizeof(rh) + rh.tLen + rh.rLen);
+	}
+	end = off;
+	if (off == h.filterEnd)
+		filterItems = index.size();
+	// records before the mark were on disk, so a bad one there means the
+	// file was damaged, and dropping the spends after it would let those
+	// coins be spent again
+	if (end < h.synced)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[SpentCoinDB] %s: bad record at offset %lu, before the synced "
+			"end at offset %lu", fname.c_str(), (unsigned long) end,
+			(unsigned long) h.synced);
+	// past the mark, pages may have been written back in any order before
+	// a crash, so a torn record can be followed by good ones; none of them
+	// were acknowledged by sync, so clear everything after the last good
+	// record for new ones
+	size_t dirty = mapped;
+	while (dirty > end && data[dirty - 1] == 0)
+		dirty--;
+	if (dirty > end) {
+		memset(data + end, 0, dirty - end);
+		syncRange(end, dirty);
+	}
+	return filterItems;
+}
+
+void SpentCoinDB::markSynced() {
+	file_header *h = (file_header*) data;
+	if (h->synced == end)
+		return;
+	h->synced = end;
+	syncRange(0, sizeof(file_header));
+}
+
+string SpentCoinDB::filterFile() const {
+	return fname + ".bloom";
+}
+
+bool SpentCoinDB::loadFilter(size_t items) {
+	const file_header *h = (const file_header*) data;
+	if (h->filterEnd == 0 || items == NO_FILTER)
+		return false;
+	try {
+		filter.reset(new BloomFilter(filterFile()));
+	} catch (CashException &e) {
+		return false;
+	}
+	// a filter saved after the header was last updated, or along with
+	// another copy of the file, need not hold the same keys
+	if (filter->size() != items)
+		return false;
+	addKeys(h->filterEnd);
+	if (filter->size() > filter->capacity())
+		rebuildFilter(2 * filter->size());
+	return true;
+}
+
+void SpentCoinDB::saveFilter() {
+	// the records have to be on disk before a saved filter covers them
+	syncRange(0, end);
+	markSynced();
+	filter->save(filterFile());
+	file_header *h = (file_header*) data;
+	h->filterEnd = end;
+	syncRange(0, sizeof(file_header));
+}
+
+void SpentCoinDB::addKeys(size_t from) {
+	// in file order: going through the index instead touches the records
+	// in random order, which is several times slower on a large file
+	for (size_t off = from; off < end; ) {
+		const record_header *rh = (const record_header*) (data + off);
+		filter->add(string((const char*) rh->key, KEY_BYTES));
+		off = align(off + sizeof(*rh) + rh->tLen + rh->rLen);
+	}
+}
+
+void SpentCoinDB::rebuildFilter(size_t capacity) {
+	filter.reset(new BloomFilter(capacity, fpRate));
+	addKeys(align(sizeof(file_header)));
+}
+
+void SpentCoinDB::syncRange(size_t from, size_t to) {
+	// msync wants a page-aligned address
+	size_t page = sysconf(_SC_PAGESIZE);
+	from = from / page * page;
+	if (msync(data + from, to - from, MS_SYNC) != 0)
+		fail(fname, "cannot sync");
+}
+
+void SpentCoinDB::grow(size_t bytes) {
+	if (bytes <= mapped)
+		return;
+	if (data && munmap(data, mapped) != 0)
+		fail(fname, "cannot unmap");
+	data = 0;
+	if (ftruncate(fd, bytes) != 0)
+		fail(fname, "cannot grow");
+	void *p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		fail(fname, "cannot map");
+	data = (char*) p;
+	mapped = bytes;
+}
+
+bool SpentCoinDB::findLocked(const string &key, Spend &spend) const {
+	if (key.size() != KEY_BYTES)
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[SpentCoinDB] Key has %u bytes, expected %u",
+			(unsigned) key.size(), KEY_BYTES);
+	stats.lookups++;
+	if (!filter->mightContain(key)) {
+		stats.negatives++;
+		return false;
+	}
+	typedef boost::unordered_multimap<uint64_t, uint64_t>::const_iterator
+		iter;
+	pair<iter, iter> r = index.equal_range(prefix(key));
+	for (iter it = r.first; it != r.second; ++it) {
+		const record_header *rh = (const record_header*) (data + it->second);
+		if (memcmp(rh->key, key.data(), KEY_BYTES) != 0)
+			continue;
+		const unsigned char *p = (const unsigned char*) (rh + 1);
+		spend.tPrime = ZZFromBytes(p, rh->tLen);
+		spend.r = ZZFromBytes(p + rh->tLen, rh->rLen);
+		return true;
+	}
+	stats.falsePositives++;
+	return false;
+}
+
+void SpentCoinDB::append(const string &key, const Spend &spend) {
+	string t = ZZToBytes(spend.tPrime), r = ZZToBytes(spend.r);
+	if (t.size() > 0xffff || r.size() > 0xffff)
+		throw CashException(CashException::CE_SIZE_ERROR,
+			"[SpentCoinDB] Spend is too large to record");
+	size_t body = t.size() + r.size();
+	size_t next = align(end + sizeof(record_header) + body);
+	if (next > mapped)
+		grow(max(next, 2 * mapped));
+
+	// body first, then the header that makes it valid
+	char *p = data + end;
+	memcpy(p + sizeof(record_header), t.data(), t.size());
+	memcpy(p + sizeof(record_header) + t.size(), r.data(), r.size());
+	record_header rh;
+	memset(&rh, 0, sizeof(rh));
+	rh.magic = SPENTDB_RECORD_MAGIC;
+	rh.tLen = t.size();
+	rh.rLen = r.size();
+	memcpy(rh.key, key.data(), KEY_BYTES);
+	rh.checksum = checksum(rh, p + sizeof(rh));
+	memcpy(p, &rh, sizeof(rh));
+
+	if (syncEach)
+		syncRange(end, next);
+	index.insert(make_pair(prefix(key), (uint64_t) end));
+	end = next;
+	if (syncEach)
+		markSynced();
+	filter->add(key);
+	if (filter->size() > filter->capacity())
+		rebuildFilter(2 * filter->capacity());
+}
+
+bool SpentCoinDB::insert(const string &key, const Spend &spend,
+						 Spend &previous) {
+	boost::mutex::scoped_lock l(lock);
+	if (findLocked(key, previous))
+		return false;
+	append(key, spend);
+	return true;
+}
+
+bool SpentCoinDB::find(const string &key, Spend &spend) const {
+	boost::mutex::scoped_lock l(lock);
+	return findLocked(key, spend);
+}
+
+size_t SpentCoinDB::size() const {
+	boost::mutex::scoped_lock l(lock);
+	return index.size();
+}
+
+SpentCoinDB::FilterStats SpentCoinDB::filterStats() const {
+	boost::mutex::scoped_lock l(lock);
+	FilterStats st = stats;
+	st.bytes = filter->sizeInBytes();
+	return st;
+}
+
+void SpentCoinDB::sync() {
+	boost::mutex::scoped_lock l(lock);
+	// the records have to be on disk before the mark says so
+	syncRange(0, end);
+	markSynced();
+}
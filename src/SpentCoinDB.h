@@ -0,0 +1,137 @@
+#ifndef _SPENTCOINDB_H_
+#define _SPENTCOINDB_H_
+
+#include <string>
+#include <stdint.h>
+#include <boost/unordered_map.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "NTL/ZZ.h"
+#include "BloomFilter.h"
+
+using namespace std;
+using NTL::ZZ;
+
+/*! \brief The bank's record of every coin deposited so far, for finding
+ * double spending.
+ *
+ * Spends are keyed by a hash of the coin's serial S' (see serialKey), and
+ * each one keeps T' and R, which is all identifyDoubleSpender needs from
+ * the earlier coin.  The file is append-only: a header followed by one
+ * checksummed record per spend.  It is memory-mapped, and an in-memory
+ * hash index maps keys to records, so a deposit is one lookup plus (for
+ * a new serial) one append.  A BloomFilter over the keys sits in front of
+ * the index: as nearly every deposited coin is fresh, most deposits never
+ * look at the index or the file at all.  The filter is doubled in size
+ * whenever it fills up.  Closing the database saves it to fname.bloom,
+ * and the header notes how many records it covers; opening loads it and
+ * adds the keys of any later records (e.g., after a crash), or rebuilds
+ * it from the records if it is missing or doesn't match them.
+ *
+ * A spend is durable once sync() has returned after it (or at once, with
+ * syncEach); the header keeps the offset up to which records have been
+ * synced.  On opening, records are read up to the first one that is
+ * incomplete or fails its checksum.  If it is past that mark (i.e., was
+ * never synced, and the crash may have left any of the pages after it on
+ * disk or not), it and everything after it are discarded; if it is
+ * before the mark, the file is damaged, and opening it throws a
+ * CashException with the offset of the bad record rather than losing
+ * spends.
+ * All functions may be called from several threads.
+ */
+class SpentCoinDB : private boost::noncopyable {
+	public:
+		// 2: the synced end in the header
+		static const unsigned VERSION = 2;
+		static const unsigned KEY_BYTES = 20;
+
+		/*! what is kept about a spent coin */
+		struct Spend {
+			Spend() {}
+			Spend(const ZZ &tPrime, const ZZ &r) : tPrime(tPrime), r(r) {}
+			ZZ tPrime;
+			ZZ r;
+		};
+
+		/*! how often the filter saved a lookup */
+		struct FilterStats {
+			size_t lookups; // inserts and finds
+			size_t negatives; // answered by the filter alone
+			size_t falsePositives; // passed the filter, but not spent
+			size_t bytes; // size of the filter
+			bool loaded; // loaded on opening, rather than rebuilt
+		};
+
+		/*! opens fname, creating it if it doesn't exist; with syncEach,
+		 * every insert is flushed to disk before it returns.  The filter
+		 * is sized for fpRate false positives. */
+		SpentCoinDB(const string &fname, bool syncEach = false,
+					double fpRate = 0.01);
+		~SpentCoinDB();
+
+		/*! the key for serial number sPrime */
+		static string serialKey(const ZZ &sPrime);
+
+		/*! if there is no spend under key yet, records spend and returns
+		 * true; otherwise sets previous to the earlier spend and returns
+		 * false */
+		bool insert(const string &key, const Spend &spend, Spend &previous);
+
+		/*! sets spend to the spend under key and returns true, or returns
+		 * false if there is none */
+		bool find(const string &key, Spend &spend) const;
+
+		/*! number of spends recorded */
+		size_t size() const;
+
+		/*! flushes all spends recorded so far to disk */
+		void sync();
+
+		FilterStats filterStats() const;
+
+	private:
+		bool findLocked(const string &key, Spend &spend) const;
+		void append(const string &key, const Spend &spend);
+		/*! grows the file (and mapping) to at least bytes */
+		void grow(size_t bytes);
+		/*! true if a whole record with the right checksum is at off */
+		bool validRecord(size_t off) const;
+		/*! reads the records, indexing them and setting end; returns the
+		 * number of records before the saved filter's end, or NO_FILTER
+		 * if no record starts (or ends) there */
+		size_t recover();
+		void syncRange(size_t from, size_t to);
+		/*! records end as synced in the header; everything before it has
+		 * to be on disk already */
+		void markSynced();
+		/*! replaces the filter with one for capacity keys, holding
+		 * all keys recorded so far */
+		void rebuildFilter(size_t capacity);
+		/*! adds the keys of the records from offset from on */
+		void addKeys(size_t from);
+		/*! loads the saved filter and adds the later keys; false (and
+		 * the filter has to be rebuilt) if it doesn't hold items keys */
+		bool loadFilter(size_t items);
+		/*! syncs the records, then saves the filter and notes it in the
+		 * header */
+		void saveFilter();
+		string filterFile() const;
+		static uint64_t prefix(const string &key);
+		static const size_t NO_FILTER = (size_t) -1;
+
+		string fname;
+		bool syncEach;
+		int fd;
+		char *data;
+		size_t mapped; // size of the file and the mapping
+		size_t end; // where the next record goes
+		// first bytes of the key -> offset of the record
+		boost::unordered_multimap<uint64_t, uint64_t> index;
+		double fpRate;
+		boost::scoped_ptr<BloomFilter> filter;
+		mutable FilterStats stats;
+		mutable boost::mutex lock;
+};
+
+#endif /*_SPENTCOINDB_H_*/
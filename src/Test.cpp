@@ -11,8 +11,10 @@
 #include <string>
 #include <assert.h>
 #include <vector>
+#include <set>
 #include <boost/unordered_map.hpp>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #define foreach BOOST_FOREACH
 
 #include <NTL/ZZ.h>
@@ -41,6 +43,10 @@
 #include "ZKP/ConstantSub.h"
 #include "ZKP/ConstantProp.h"
 #include "ZKP/Printer.h"
+#include "ZKP/TableFile.h"
+#include "ZKP/ProofPlan.h"
+#include "ZKP/InterpreterCache.h"
+#include "ZKP/ProgramFile.h"
 
 #include "CLBlindRecipient.h"
 #include "CLBlindIssuer.h"
@@ -56,6 +62,12 @@
 #include "BankTool.h"
 #include "Coin.h"
 #include "Arbiter.h"
+#include "ThreadPool.h"
+#include "BloomFilter.h"
+#include "CoinPool.h"
+#include "Merkle.h"
+#include "MerkleProver.h"
+#include "MerkleVerifier.h"
 
 #define MAX_TIMERS 20
 
@@ -82,6 +94,25 @@ double* testBuyResolution();
 double* testBarterResolution();
 double* testSerializeAbstract();
 double* testMultiExp();
+double* testPowerCache();
+double* testCoinAllocations();
+double* testBatchVerify();
+double* testParallelProofs();
+double* testProofPlan();
+double* testVariableSlots();
+double* testInterpreterCache();
+double* testProgramSource();
+double* testProgramFile();
+double* testVerifyCoins();
+double* testSpentCoinDB();
+double* testSpentCoinRecovery();
+double* testBloomFilter();
+double* testPreparedCoins();
+double* testCoinPool();
+double* testMerkleBuilder();
+double* testParallelMerkle();
+double* testMerkleProofs();
+double* testMerkleMultiProofs();
 
 double* multiTest();
 
@@ -113,6 +144,25 @@ test_desc_t test_funcs[] = {
 	{ testBarterResolution, "Barter resolution" },
 	{ testSerializeAbstract, "Test serialization of derived pointers"},
 	{ testMultiExp, "Test multi-exp"},
+	{ testPowerCache, "Test fixed-base power cache"},
+	{ testCoinAllocations, "Count GMP allocations in coin verification"},
+	{ testBatchVerify, "Batch verification of sigma proofs"},
+	{ testParallelProofs, "Sigma proofs on a thread pool"},
+	{ testProofPlan, "Shared proof plans for cached programs"},
+	{ testVariableSlots, "Slot-indexed variable tables"},
+	{ testInterpreterCache, "Concurrent, bounded interpreter cache"},
+	{ testProgramSource, "Compile programs from source text"},
+	{ testProgramFile, "Load precompiled programs"},
+	{ testVerifyCoins, "Coin verification throughput"},
+	{ testSpentCoinDB, "Spent coin database"},
+	{ testSpentCoinRecovery, "Spent coin database after damage"},
+	{ testBloomFilter, "Bloom filter for spent serials"},
+	{ testPreparedCoins, "Spending precomputed coins"},
+	{ testCoinPool, "Background pool of prepared coins"},
+	{ testMerkleBuilder, "Streaming Merkle roots"},
+	{ testParallelMerkle, "Merkle trees on the shared thread pool"},
+	{ testMerkleProofs, "Merkle proofs of challenged blocks"},
+	{ testMerkleMultiProofs, "Merkle multi-proofs against paths"},
 	// add new tests here 
 	{ multiTest, "Multi-tester" },
 };
@@ -2015,11 +2065,7 @@ double* testBarterResolution() {
 	return timers;
 }
 
-BOOST_CLASS_EXPORT(ASTNode)
-BOOST_CLASS_EXPORT(ASTExpr)
-BOOST_CLASS_EXPORT(ASTExprIdentifier)
-BOOST_CLASS_EXPORT(ASTBinaryOp)
-BOOST_CLASS_EXPORT(ASTPow)
+// the AST node types are exported in ZKP/ProgramFile.cpp
 
 double* testSerializeAbstract() {
 	double* timers = new double[MAX_TIMERS];
@@ -2098,5 +2144,1508 @@ double* testMultiExp() {
 		}
     }
 
+	// more than 4 bases, with some negative exponents: goes through the
+	// interleaved-window / Pippenger engine instead of the cached table
+	vector<ZZ> manyBases, manyExps;
+	for (size_t i = 0; i < 10; i++) {
+		manyBases.push_back(gp.randomElement());
+		ZZ e = gp.randomExponent();
+		manyExps.push_back(i % 3 ? e : -e);
+	}
+	ZZ resC, resD = to_ZZ(1);
+	startTimer();
+	for (size_t r=0; r<ROUNDS/10; r++)
+		resC = MultiExp(manyBases, manyExps, mod);
+	timers[timer++] = printTimer(timer, "10-base MultiExps");
+	startTimer();
+	for (size_t r=0; r<ROUNDS/10; r++) {
+		resD = to_ZZ(1);
+		for (size_t i = 0; i < manyBases.size(); i++)
+			resD = MulMod(resD, PowerMod(manyBases[i], manyExps[i], mod), mod);
+	}
+	timers[timer++] = printTimer(timer, "10-base PowerMod/MulMod");
+	if (resC != resD)
+		cout << "ERROR: 10-base result doesn't match" << endl;
+
+	// both engines directly, on a few and on many bases, with negative
+	// and zero exponents (and all-zero exponents, whose product is 1)
+	size_t sizes[] = { 1, 10, 600 };
+	for (unsigned k = 0; k < sizeof(sizes) / sizeof(size_t); k++) {
+		for (int allZero = 0; allZero < 2; allZero++) {
+			vector<ZZ> bs, es;
+			ZZ expected = to_ZZ(1);
+			for (size_t i = 0; i < sizes[k]; i++) {
+				bs.push_back(gp.randomElement());
+				ZZ e = gp.randomExponent();
+				if (allZero || i % 5 == 1)
+					e = 0;
+				else if (i % 3 == 0)
+					e = -e;
+				es.push_back(e);
+				expected = MulMod(expected, PowerMod(bs[i], e, mod), mod);
+			}
+			bool timed = !allZero && sizes[k] == 600;
+			ZZ inter, pipp;
+			if (timed)
+				startTimer();
+			MultiExpInterleaved(inter, bs, es, mod);
+			if (timed) {
+				timers[timer++] = printTimer(timer, "600-base interleaved "
+												  "windows");
+				startTimer();
+			}
+			MultiExpPippenger(pipp, bs, es, mod);
+			if (timed)
+				timers[timer++] = printTimer(timer, "600-base Pippenger "
+												  "buckets");
+			if (inter != expected)
+				cout << "ERROR: interleaved " << sizes[k] << "-base result "
+					 << "doesn't match" << (allZero ? " (zero exponents)" : "")
+					 << endl;
+			if (pipp != expected)
+				cout << "ERROR: Pippenger " << sizes[k] << "-base result "
+					 << "doesn't match" << (allZero ? " (zero exponents)" : "")
+					 << endl;
+		}
+	}
+
+	// MultiExpAuto keeps interleaved windows for a few bases and switches
+	// to buckets for many
+	vector<ZZ> fewExps(10), lotsExps(600);
+	for (size_t i = 0; i < lotsExps.size(); i++) {
+		lotsExps[i] = gp.randomExponent();
+		if (i < fewExps.size())
+			fewExps[i] = -lotsExps[i];
+	}
+	if (MultiExpPicksPippenger(fewExps))
+		cout << "ERROR: MultiExpAuto picks Pippenger for 10 bases" << endl;
+	if (!MultiExpPicksPippenger(lotsExps))
+		cout << "ERROR: MultiExpAuto picks interleaved windows for 600 bases"
+			 << endl;
+
+	// fill the table cache with as many pairs of bases as it holds, use
+	// the oldest pair again, and add one more: the second pair goes
+	size_t capacity = MultiExpCacheCapacity();
+	vector<vector<ZZ> > pairs(capacity + 1);
+	vector<ZZ> ones(2, to_ZZ(1));
+	startTimer();
+	for (size_t i = 0; i < capacity; i++) {
+		pairs[i].push_back(gp.randomElement());
+		pairs[i].push_back(gp.randomElement());
+		MultiExp(pairs[i], ones, mod);
+	}
+	timers[timer++] = printTimer(timer, "Filled MultiExp table cache");
+	MultiExp(pairs[0], ones, mod);
+	pairs[capacity].push_back(gp.randomElement());
+	pairs[capacity].push_back(gp.randomElement());
+	MultiExp(pairs[capacity], ones, mod);
+	if (!MultiExpCached(pairs[0], mod) || 
+		!MultiExpCached(pairs[capacity], mod))
+		cout << "ERROR: recently used table was evicted" << endl;
+	if (MultiExpCached(pairs[1], mod))
+		cout << "ERROR: least recently used table was not evicted" << endl;
+	for (size_t i = 2; i < capacity; i++) {
+		if (!MultiExpCached(pairs[i], mod)) {
+			cout << "ERROR: table " << i << " was evicted" << endl;
+			break;
+		}
+	}
+
+	return timers;
+}
+
+double* testPowerCache() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+
+	cout << "generating group ..." << endl;
+	GroupPrime gp("bank", 1024, 160, 80);
+	gp.addNewGenerator();
+	ZZ g = gp.getGenerator(1);
+	ZZ mod = gp.getModulus();
+
+	size_t ROUNDS = 400;
+	vector<ZZ> exps(ROUNDS);
+	for (size_t r = 0; r < ROUNDS; r++) {
+		// mix in negative and over-long exponents, which have to be
+		// reduced mod the order
+		exps[r] = gp.randomExponent();
+		if (r % 3 == 1)
+			exps[r] = -exps[r];
+		else if (r % 3 == 2)
+			exps[r] = exps[r] * gp.getModulus();
+	}
+
+	PowerCache cache;
+	startTimer();
+	cache.store("g", g, mod, 2048, gp.getOrder());
+	timers[timer++] = printTimer(timer, "PowerCache precomputation");
+	cout << "PowerCache memory used: " << PowerCache::getMemoryUsed() 
+		 << " bytes" << endl;
+
+	vector<ZZ> resA(ROUNDS), resB(ROUNDS);
+	startTimer();
+	for (size_t r=0; r<ROUNDS; r++)
+		resA[r] = cache.modPow("g", exps[r], mod);
+	timers[timer++] = printTimer(timer, "PowerCache modPows");
+
+	startTimer();
+	for (size_t r=0; r<ROUNDS; r++)
+		resB[r] = PowerMod(g, exps[r], mod);
+	timers[timer++] = printTimer(timer, "regular PowerMod");
+
+	for (size_t i=0; i<ROUNDS; i++) {
+		if (resA[i] != resB[i]) {
+			cout << "ERROR: result " << i << " doesn't match" << endl;
+			break;
+		}
+	}
+
+	// a second cache for the same base shares the table
+	size_t used = PowerCache::getMemoryUsed();
+	PowerCache other;
+	other.store("h", g, mod, 2048, gp.getOrder());
+	if (PowerCache::getMemoryUsed() != used)
+		cout << "ERROR: table for the same base was built twice" << endl;
+
+	// nothing new gets cached once the budget is used up
+	size_t budget = PowerCache::getMemoryBudget();
+	PowerCache::setMemoryBudget(used);
+	if (cache.store("g2", MulMod(g, g, mod), mod, 2048))
+		cout << "ERROR: table stored beyond the memory budget" << endl;
+	PowerCache::setMemoryBudget(budget);
+
+	// tables saved to disk come back without any precomputation
+	string tableFile = "powercache.tbl";
+	TableFile::save(tableFile);
+	PowerCache::clearShared();
+	startTimer();
+	TableFile::load(tableFile);
+	PowerCache loaded;
+	loaded.store("g", g, mod, 2048, gp.getOrder());
+	timers[timer++] = printTimer(timer, "PowerCache load from file");
+	for (size_t r=0; r<ROUNDS; r++) {
+		if (loaded.modPow("g", exps[r], mod) != resB[r]) {
+			cout << "ERROR: loaded result " << r << " doesn't match" << endl;
+			break;
+		}
+	}
+
+	// a table whose stored order isn't the base's order is refused
+	{
+		ifstream in(tableFile.c_str(), ios::binary);
+		string data((istreambuf_iterator<char>(in)),
+					istreambuf_iterator<char>());
+		in.close();
+		const ZZ &order = gp.getOrder();
+		string limbs((const char*) mpz_limbs_read(MPZ(order)),
+					 mpz_size(MPZ(order)) * sizeof(mp_limb_t));
+		size_t pos = data.find(limbs);
+		if (pos == string::npos) {
+			cout << "ERROR: group order not found in table file" << endl;
+		} else {
+			data[pos] ^= 2;
+			ofstream out(tableFile.c_str(), ios::binary | ios::trunc);
+			out.write(data.data(), data.size());
+			out.close();
+			PowerCache::clearShared();
+			try {
+				TableFile::load(tableFile);
+				cout << "ERROR: loaded a table with the wrong order" << endl;
+			} catch (CashException &e) {
+			}
+			data[pos] ^= 2;
+		}
+
+		// so is one whose entries (at the end of the file) changed
+		data[data.size() - 1] ^= 1;
+		ofstream out(tableFile.c_str(), ios::binary | ios::trunc);
+		out.write(data.data(), data.size());
+		out.close();
+		PowerCache::clearShared();
+		try {
+			TableFile::load(tableFile);
+			cout << "ERROR: loaded a table with corrupted entries" << endl;
+		} catch (CashException &e) {
+		}
+	}
+	remove(tableFile.c_str());
+
+	return timers;
+}
+
+// counts GMP allocations (but not frees)
+static unsigned long gmpAllocs = 0;
+static void* countingAlloc(size_t n) { 
+	gmpAllocs++; 
+	return malloc(n); 
+}
+static void* countingRealloc(void* p, size_t, size_t n) { 
+	gmpAllocs++; 
+	return realloc(p, n); 
+}
+static void countingFree(void* p, size_t) { free(p); }
+
+double* testCoinAllocations() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+
+	// same setup as testCoin
+	const BankParameters* params = new BankParameters("bank.80.params");
+	Wallet wallet("wallet.80", params);
+	vector<ZZ> contractInfo;
+	contractInfo.push_back(12345);
+	ZZ rVal = Hash::hash(contractInfo, Hash::SHA1);
+	Coin coin = wallet.nextCoin(rVal);
+
+	// first verification compiles the program and fills the caches and
+	// scratch arena, so leave it out
+	coin.verifyCoin();
+
+	size_t ROUNDS = 10;
+	mp_set_memory_functions(countingAlloc, countingRealloc, countingFree);
+	gmpAllocs = 0;
+	startTimer();
+	for (size_t r = 0; r < ROUNDS; r++) {
+		if (!coin.verifyCoin())
+			cout << "ERROR: coin failed to verify" << endl;
+	}
+	timers[timer++] = printTimer(timer, "Verified coins");
+	unsigned long verifyAllocs = gmpAllocs;
+
+	gmpAllocs = 0;
+	for (size_t r = 0; r < ROUNDS; r++)
+		coin.getSPrime();
+	unsigned long sPrimeAllocs = gmpAllocs;
+	mp_set_memory_functions(NULL, NULL, NULL);
+
+	cout << "GMP allocations per coin verification: " 
+		 << verifyAllocs / ROUNDS << endl;
+	cout << "GMP allocations per getSPrime: " 
+		 << sPrimeAllocs / ROUNDS << endl;
+
+	// once warm, the cached in-place exponentiations allocate nothing
+	const GroupPrime* cashG = params->getCashGroup();
+	const ZZ &mod = cashG->getModulus();
+	PowerCache pc;
+	pc.store("g", cashG->getGenerator(1), mod, NumBits(cashG->getOrder()));
+	MultiExpCache mc;
+	vector<string> names;
+	names.push_back("g");
+	names.push_back("h");
+	vector<ZZ> bases;
+	bases.push_back(cashG->getGenerator(1));
+	bases.push_back(cashG->getGenerator(2));
+	mc.store(names, bases, mod);
+	vector<ZZ> exps;
+	exps.push_back(cashG->randomExponent());
+	exps.push_back(-cashG->randomExponent());
+	ZZ result;
+	pc.modPow(result, "g", exps[0], mod);
+	mc.modPow(result, names, bases, exps, mod);
+	mp_set_memory_functions(countingAlloc, countingRealloc, countingFree);
+	gmpAllocs = 0;
+	for (size_t r = 0; r < ROUNDS; r++) {
+		pc.modPow(result, "g", exps[0], mod);
+		mc.modPow(result, names, bases, exps, mod);
+	}
+	unsigned long cachedAllocs = gmpAllocs;
+	mp_set_memory_functions(NULL, NULL, NULL);
+
+	// getSPrime only allocates its result (twice with GMPs that give a
+	// new ZZ a limb).  Verification also copies the values of both
+	// proofs; its count is only reported above, as it depends on the
+	// programs and the GMP build
+	const unsigned long MAX_SPRIME_ALLOCS = 2;
+	if (cachedAllocs != 0)
+		cout << "ERROR: cached exponentiations made " << cachedAllocs 
+			 << " GMP allocations" << endl;
+	if (sPrimeAllocs > MAX_SPRIME_ALLOCS * ROUNDS)
+		cout << "ERROR: getSPrime makes more than " << MAX_SPRIME_ALLOCS
+			 << " GMP allocations" << endl;
+	return timers;
+}
+
+double* testBatchVerify() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	string dlr = CommonFunctions::getZKPDir()+"/dlr.txt";
+
+	// the cash group, whose modulus has a large cofactor: every element
+	// of the statements gets a membership check (an exponentiation by the
+	// 160-bit order), which still costs less than the relations' own
+	// exponentiations by responses twice as long
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+
+	// a batch of distinct DLR proofs from the same program
+	size_t PROOFS = 32;
+	InterpreterProver p;
+	vector<ProofMessage> msgs;
+	startTimer();
+	for (size_t i = 0; i < PROOFS; i++) {
+		variable_map pvars;
+		p.check(dlr, grps);
+		p.compute(pvars);
+		SigmaProof proof = p.computeProof(hashAlg);
+		msgs.push_back(ProofMessage(p.getPublicVariables(), proof));
+	}
+	timers[timer++] = printTimer(timer, "Prover computed DLR proofs");
+
+	// both paths start from the same checked program, so only
+	// verification is timed
+	InterpreterVerifier v;
+	v.check(dlr, grps);
+	startTimer();
+	for (size_t i = 0; i < PROOFS; i++) {
+		InterpreterVerifier single(v);
+		variable_map vvars;
+		single.compute(vvars, msgs[i].proof.getCommitments(), msgs[i].publics);
+		if (!single.verify(msgs[i].proof, stat))
+			cout << "ERROR: proof " << i << " failed to verify" << endl;
+	}
+	double oneByOne = printTimer(timer, "Verifier verified proofs one by one");
+	timers[timer++] = oneByOne;
+
+	startTimer();
+	vector<bool> results = v.verifyBatch(variable_map(), msgs, stat);
+	double batch = printTimer(timer, "Verifier verified proofs as a batch");
+	timers[timer++] = batch;
+	for (size_t i = 0; i < PROOFS; i++) {
+		if (!results[i])
+			cout << "ERROR: proof " << i << " failed batch verification" << endl;
+	}
+	if (batch >= oneByOne)
+		cout << "ERROR: batch verification took " << batch << " ms, "
+			 << "one by one took " << oneByOne << " ms" << endl;
+
+	// a single bad response must be caught, and pinned on its proof
+	size_t bad = PROOFS / 2;
+	msgs[bad].proof.responses.begin()->second += 1;
+	startTimer();
+	results = v.verifyBatch(variable_map(), msgs, stat);
+	timers[timer++] = printTimer(timer, "Verifier verified batch with a bad "
+										"proof");
+	for (size_t i = 0; i < PROOFS; i++) {
+		if (results[i] != (i != bad))
+			cout << "ERROR: wrong batch result for proof " << i << endl;
+	}
+	msgs[bad].proof.responses.begin()->second -= 1;
+
+	// -1 has order 2, so negating "other" in a proof with an odd challenge
+	// only flips the sign of its equation: without the membership check
+	// the batch lets that through whenever the random exponent is even
+	bad = PROOFS;
+	for (size_t i = 0; i < PROOFS && bad == PROOFS; i++) {
+		if (IsOdd(msgs[i].proof.computeChallenge()))
+			bad = i;
+	}
+	ZZ &other = msgs[bad].publics["other"];
+	other = cashG->getModulus() - other;
+	for (int trial = 0; trial < 16; trial++) {
+		results = v.verifyBatch(variable_map(), msgs, stat);
+		for (size_t i = 0; i < PROOFS; i++) {
+			if (results[i] != (i != bad))
+				cout << "ERROR: wrong batch result for proof " << i 
+					 << " with an element outside the group" << endl;
+		}
+	}
+	return timers;
+}
+
+static void squareInto(vector<ZZ> *out, size_t i) {
+	(*out)[i] = to_ZZ(i) * to_ZZ(i);
+}
+
+double* testParallelProofs() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+
+	// every iteration runs exactly once, whichever thread it lands on
+	ThreadPool pool(4);
+	vector<ZZ> squares(1000);
+	pool.parallelFor(squares.size(), boost::bind(squareInto, &squares, _1));
+	for (size_t i = 0; i < squares.size(); i++) {
+		if (squares[i] != to_ZZ(i) * to_ZZ(i))
+			cout << "ERROR: parallelFor missed iteration " << i << endl;
+	}
+
+	size_t PROOFS = 32;
+	for (int parallel = 0; parallel < 2; parallel++) {
+		ThreadPool::setSharedThreads(parallel ? 0 : 1);
+		InterpreterProver p;
+		InterpreterVerifier v;
+		startTimer();
+		for (size_t i = 0; i < PROOFS; i++) {
+			variable_map pvars;
+			p.check(CommonFunctions::getZKPDir()+"/dlr.txt", grps);
+			p.compute(pvars);
+			SigmaProof proof = p.computeProof(hashAlg);
+
+			variable_map vvars;
+			v.check(CommonFunctions::getZKPDir()+"/dlr.txt", grps);
+			v.compute(vvars, proof.getCommitments(), p.getPublicVariables());
+			if (!v.verify(proof, stat))
+				cout << "ERROR: proof " << i << " failed to verify" << endl;
+		}
+		timers[timer++] = printTimer(timer, parallel ? 
+			"Proved and verified DLR proofs on the shared pool" :
+			"Proved and verified DLR proofs serially");
+	}
+	ThreadPool::setSharedThreads(1);
+	return timers;
+}
+
+double* testProofPlan() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+	string fname = CommonFunctions::getZKPDir()+"/dlr.txt";
+
+	// the second check is a cache hit: it must share the compiled maps
+	// and the plan instead of copying them
+	InterpreterProver p;
+	p.check(fname, grps);
+	startTimer();
+	InterpreterVerifier v;
+	v.check(fname, grps);
+	timers[timer++] = printTimer(timer, "Checked cached program");
+	Environment pe = p.getEnvironment(), ve = v.getEnvironment();
+	if (&pe.descriptions.get() != &ve.descriptions.get() ||
+		&pe.varTypes.get() != &ve.varTypes.get())
+		cout << "ERROR: cached environments don't share their maps" << endl;
+	if (!pe.plan || pe.plan != ve.plan)
+		cout << "ERROR: cached environments don't share their plan" << endl;
+	if (pe.plan->getRelations().size() != pe.descriptions.size())
+		cout << "ERROR: plan has the wrong number of relations" << endl;
+
+	// writing to a shared map copies it first
+	ve.privates["foo"] = true;
+	if (&pe.privates.get() == &ve.privates.get() || pe.privates.count("foo"))
+		cout << "ERROR: write to a shared map leaked to another copy" << endl;
+
+	variable_map pvars, vvars;
+	p.compute(pvars);
+	startTimer();
+	SigmaProof proof = p.computeProof(hashAlg);
+	timers[timer++] = printTimer(timer, "Computed proof from plan");
+	v.compute(vvars, proof.getCommitments(), p.getPublicVariables());
+	startTimer();
+	if (!v.verify(proof, stat))
+		cout << "ERROR: proof from plan failed to verify" << endl;
+	timers[timer++] = printTimer(timer, "Verified proof from plan");
+	return timers;
+}
+
+double* testVariableSlots() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+	string fname = CommonFunctions::getZKPDir()+"/dlr.txt";
+
+	// slots keep their numbers when values are replaced or erased
+	VariableTable t;
+	unsigned a = t.slot("a"), b = t.slot("b");
+	t["a"] = 3;
+	variable_map m;
+	m["b"] = 5;
+	t = m;
+	if (t.slot("a") != a || t.slot("b") != b || t.count("a") || 
+		t.size() != 1 || t.at("b") != 5)
+		cout << "ERROR: assigning a map to a table moved its slots" << endl;
+	t.erase("b");
+	if (t.has(b) || !t.empty())
+		cout << "ERROR: erased variable is still set" << endl;
+
+	// every relation name has a slot once the program is compiled, and
+	// the copies loaded from the cache agree on them
+	InterpreterProver p;
+	p.check(fname, grps);
+	InterpreterVerifier v;
+	v.check(fname, grps);
+	const Environment &pe = p.getEnvironment(), &ve = v.getEnvironment();
+	const vector<ProofPlan::Relation> &rels = pe.plan->getRelations();
+	for (unsigned i = 0; i < rels.size(); i++) {
+		const string &left = pe.variables.name(rels[i].left);
+		if (ve.variables.findSlot(left) != (int) rels[i].left)
+			cout << "ERROR: slot of " << left << " differs" << endl;
+	}
+
+	variable_map pvars, vvars;
+	p.compute(pvars);
+	startTimer();
+	for (int i = 0; i < 20; i++) {
+		SigmaProof proof = p.computeProof(hashAlg);
+		v.compute(vvars, proof.getCommitments(), p.getPublicVariables());
+		if (!v.verify(proof, stat))
+			cout << "ERROR: proof over slots failed to verify" << endl;
+	}
+	timers[timer++] = printTimer(timer, "20 proofs over variable slots");
+	return timers;
+}
+
+static void checkProgram(const string *fname, group_map *grps, size_t i) {
+	InterpreterProver p;
+	p.check(*fname, *grps);
+}
+
+double* testInterpreterCache() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+	string fname = CommonFunctions::getZKPDir()+"/dlr.txt";
+
+	// one compile, then every other check (from any thread) is a hit
+	InterpreterCache::clear();
+	ThreadPool pool(4);
+	size_t CHECKS = 64;
+	startTimer();
+	checkProgram(&fname, &grps, 0);
+	pool.parallelFor(CHECKS, boost::bind(checkProgram, &fname, &grps, _1));
+	timers[timer++] = printTimer(timer, "Checked program from 4 threads");
+	InterpreterCache::Stats st = InterpreterCache::stats();
+	if (st.misses != 1 || st.hits != CHECKS || st.size != 1)
+		cout << "ERROR: expected 1 miss and " << CHECKS << " hits, got "
+			 << st.misses << " and " << st.hits << endl;
+
+	// editing the program changes its key
+	string copy = "/tmp/dlr-cache-test.txt";
+	{
+		ifstream in(fname.c_str());
+		ofstream out(copy.c_str());
+		out << in.rdbuf();
+	}
+	checkProgram(&copy, &grps, 0);
+	if (InterpreterCache::stats().misses != 1)
+		cout << "ERROR: same program at another path wasn't a hit" << endl;
+	{
+		ofstream out(copy.c_str(), ios::app);
+		out << endl;
+	}
+	checkProgram(&copy, &grps, 0);
+	if (InterpreterCache::stats().misses != 2)
+		cout << "ERROR: edited program was loaded from the cache" << endl;
+
+	// shrinking the cache evicts down to one entry per shard at most
+	InterpreterCache::setCapacity(1);
+	st = InterpreterCache::stats();
+	if (st.size > InterpreterCache::SHARDS || st.size + st.evictions != 2)
+		cout << "ERROR: cache holds " << st.size << " entries after "
+			 << st.evictions << " evictions" << endl;
+	InterpreterCache::setCapacity(InterpreterCache::DEFAULT_CAPACITY);
+	remove(copy.c_str());
+	return timers;
+}
+
+double* testProgramSource() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+	string fname = CommonFunctions::getZKPDir()+"/dlr.txt";
+	ifstream in(fname.c_str());
+	stringstream text;
+	text << in.rdbuf();
+
+	// the same program from a file and from a string is compiled once
+	InterpreterCache::clear();
+	InterpreterProver p;
+	p.check(fname, grps);
+	InterpreterVerifier v;
+	startTimer();
+	v.checkSource(text.str(), input_map(), grps);
+	timers[timer++] = printTimer(timer, "Checked program from source");
+	if (InterpreterCache::stats().hits != 1)
+		cout << "ERROR: program source wasn't found in the cache" << endl;
+
+	variable_map pvars, vvars;
+	p.compute(pvars);
+	SigmaProof proof = p.computeProof(hashAlg);
+	v.compute(vvars, proof.getCommitments(), p.getPublicVariables());
+	if (!v.verify(proof, stat))
+		cout << "ERROR: proof of program source failed to verify" << endl;
+	return timers;
+}
+
+double* testProgramFile() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	int stat = 80;
+	BankParameters bp("bank.80.params");
+	const GroupPrime* cashG = bp.getCashGroup();
+	group_map grps;
+	grps["G"] = cashG;
+	string fname = CommonFunctions::getZKPDir()+"/dlr.txt";
+	string compiled = "/tmp/dlr-compiled.zkp";
+	ProgramFile::save(compiled, fname);
+
+	// time a cold load each way, with an empty cache
+	InterpreterCache::clear();
+	InterpreterProver p;
+	startTimer();
+	p.check(fname, grps);
+	timers[timer++] = printTimer(timer, "Parsed and checked program");
+	InterpreterCache::clear();
+	InterpreterVerifier v;
+	startTimer();
+	v.check(compiled, grps);
+	timers[timer++] = printTimer(timer, "Loaded compiled program");
+
+	// the loaded program must prove and verify like the parsed one
+	variable_map pvars, vvars;
+	p.compute(pvars);
+	SigmaProof proof = p.computeProof(hashAlg);
+	v.compute(vvars, proof.getCommitments(), p.getPublicVariables());
+	if (!v.verify(proof, stat))
+		cout << "ERROR: proof failed to verify with compiled program" << endl;
+	if (v.getEnvironment().plan->getRelations().size() !=
+		p.getEnvironment().plan->getRelations().size())
+		cout << "ERROR: compiled program has different relations" << endl;
+	remove(compiled.c_str());
+	return timers;
+}
+
+// runs the whole withdrawal protocol (see testWithdraw) for one wallet
+static Wallet withdrawWallet(const BankTool &bankTool, 
+							 const UserTool &userTool, int walletSize,
+							 int coinDenom) {
+	boost::scoped_ptr<UserWithdrawTool> uwTool(
+		userTool.getWithdrawTool(walletSize, coinDenom));
+	boost::scoped_ptr<BankWithdrawTool> bwTool(
+		bankTool.getWithdrawTool(userTool.getPublicKey(), walletSize, 
+								 coinDenom));
+	bwTool->computeFullCommitment(uwTool->createPartialCommitment());
+	ProofMessage* idProof = 
+		uwTool->initiateSignature(bwTool->getBankContribution());
+	ProofMessage* clProof = uwTool->getCLProof();
+	ProofMessage* pm = bwTool->sign(idProof, clProof);
+	return uwTool->getWallet(uwTool->verify(*pm));
+}
+
+double* testVerifyCoins() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+
+	BankTool bankTool("tool.80.bank");
+	const BankParameters* params = new BankParameters("bank.80.params");
+	Wallet wallet("wallet.80", params);
+	vector<ZZ> contractInfo;
+	contractInfo.push_back(12345);
+	ZZ rVal = Hash::hash(contractInfo, Hash::SHA1);
+
+	// distinct coins, so no work is shared between them
+	size_t COINS = 64;
+	vector<Coin> coins;
+	for (size_t i = 0; i < COINS; i++)
+		coins.push_back(wallet.nextCoin(rVal));
+	const Coin &coin = coins[0];
+	// compile the programs and fill the caches first
+	bankTool.verifyCoin(wallet.nextCoin(rVal));
+
+	startTimer();
+	for (size_t i = 0; i < COINS; i++) {
+		if (!bankTool.verifyCoin(coins[i]))
+			cout << "ERROR: coin " << i << " failed to verify" << endl;
+	}
+	double one = printTimer(timer, "Verified coins one at a time");
+	timers[timer++] = one;
+	for (int parallel = 0; parallel < 2; parallel++) {
+		ThreadPool::setSharedThreads(parallel ? 0 : 1);
+		startTimer();
+		vector<bool> ok = bankTool.verifyCoins(coins);
+		double t = printTimer(timer, parallel ? 
+			"Verified coins on the shared pool" :
+			"Verified coins with shared verifiers");
+		timers[timer++] = t;
+		if (count(ok.begin(), ok.end(), true) != (int) COINS)
+			cout << "ERROR: verifyCoins rejected good coins" << endl;
+		if (t > 0 && one > 0)
+			cout << "coins per second: " << COINS / t * 1000 << " (vs. " 
+				 << COINS / one * 1000 << " one at a time)" << endl;
+		// even on one thread, the proofs about S and T are batched
+		if (!parallel && t >= one)
+			cout << "ERROR: verifyCoins took " << t << " ms, one at a time "
+				 << "took " << one << " ms" << endl;
+	}
+	ThreadPool::setSharedThreads(1);
+
+	// the bank's commitments are what a CL proof must be about: a verifier
+	// reused for many proofs must reject one given another coin's
+	// commitments, and only that one
+	size_t bad = COINS / 2;
+	int stat = 80;
+	CLSignatureVerifier clVerifier(params->getBankKey(coin.getDenom()),
+								   params->getCashGroup(), 2*stat, 
+								   vector<ZZ>(), 3, 1);
+	for (size_t i = 0; i < COINS; i++) {
+		const Coin &comsOf = coins[i == bad ? i + 1 : i];
+		vector<ZZ> coms;
+		coms.push_back(comsOf.getB());
+		coms.push_back(comsOf.getSCommitment());
+		coms.push_back(comsOf.getTCommitment());
+		if (clVerifier.verify(&coins[i].getCLProof(), coms, stat) != (i != bad))
+			cout << "ERROR: wrong result for CL proof " << i << " with "
+				 << (i == bad ? "swapped" : "its own") << " commitments" 
+				 << endl;
+	}
+
+	// coins of two denominations in one call are checked against their
+	// own bank keys
+	UserTool userTool("tool.80.user", params, "public.80.arbiter",
+					  "public.regular.80.arbiter");
+	int denom = wallet.getDenomination() == 1 ? 2 : 1;
+	Wallet wallet2 = withdrawWallet(bankTool, userTool, 10, denom);
+	Coin coin2 = wallet2.nextCoin(rVal);
+	vector<Coin> mixed;
+	for (size_t i = 0; i < 8; i++)
+		mixed.push_back(i % 2 ? coin2 : coin);
+	vector<bool> ok = bankTool.verifyCoins(mixed);
+	if (count(ok.begin(), ok.end(), true) != (int) mixed.size())
+		cout << "ERROR: verifyCoins rejected good coins of mixed denominations" 
+			 << endl;
+	return timers;
+}
+
+double* testSpentCoinDB() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	string fname = "/tmp/test.spent";
+	remove(fname.c_str());
+	remove((fname + ".bloom").c_str());
+
+	BankTool bankTool("tool.80.bank");
+	const BankParameters* params = new BankParameters("bank.80.params");
+	UserTool userTool("tool.80.user", params, "public.80.arbiter",
+					  "public.regular.80.arbiter");
+	Wallet wallet("wallet.80", params);
+	vector<ZZ> contractInfo;
+	contractInfo.push_back(12345);
+	Coin coin = wallet.nextCoin(Hash::hash(contractInfo, hashAlg));
+	// the same coin, spent again in another transaction
+	contractInfo[0] = 12346;
+	ZZ sameIndex = coin.getIndex();
+	wallet.replaceCoin(sameIndex);
+	Coin coin2 = wallet.nextCoin(Hash::hash(contractInfo, hashAlg));
+
+	ZZ cheater;
+	{
+		SpentCoinDB db(fname);
+		if (bankTool.depositCoin(coin, db, cheater) != BankTool::DEPOSIT_OK)
+			cout << "ERROR: new coin was not accepted" << endl;
+		if (bankTool.depositCoin(coin, db, cheater) != 
+			BankTool::DEPOSIT_REPEATED)
+			cout << "ERROR: repeated deposit was not recognized" << endl;
+	}
+
+	// spends must survive reopening the database
+	SpentCoinDB db(fname);
+	if (db.size() != 1)
+		cout << "ERROR: reopened database has " << db.size() << " spends"
+			 << endl;
+	if (bankTool.depositCoin(coin2, db, cheater) != 
+		BankTool::DEPOSIT_DOUBLE_SPENT)
+		cout << "ERROR: double spend was not recognized" << endl;
+	else if (cheater != userTool.getPublicKey())
+		cout << "ERROR: wrong double spender identified" << endl;
+
+	// a coin prepared before its R was known must give the spender away
+	// just the same
+	wallet.replaceCoin(sameIndex);
+	wallet.precompute(1);
+	contractInfo[0] = 12347;
+	Coin coin3 = wallet.nextCoin(Hash::hash(contractInfo, hashAlg));
+	if (!bankTool.verifyCoin(coin3))
+		cout << "ERROR: prepared coin failed to verify" << endl;
+	if (bankTool.depositCoin(coin3, db, cheater) != 
+		BankTool::DEPOSIT_DOUBLE_SPENT)
+		cout << "ERROR: double spend of a prepared coin was not recognized" 
+			 << endl;
+	else if (cheater != userTool.getPublicKey())
+		cout << "ERROR: wrong double spender identified for a prepared coin"
+			 << endl;
+
+	// lookup and insert speed, with made-up spends
+	size_t SPENDS = 100000;
+	SpentCoinDB::Spend spend(coin.getTPrime(), coin.getR()), previous;
+	startTimer();
+	for (size_t i = 0; i < SPENDS; i++)
+		db.insert(SpentCoinDB::serialKey(to_ZZ(i)), spend, previous);
+	double t = printTimer(timer, "Recorded spends");
+	timers[timer++] = t;
+	if (t > 0)
+		cout << "deposits per second: " << SPENDS / t * 1000 << endl;
+	startTimer();
+	db.sync();
+	timers[timer++] = printTimer(timer, "Synced spends to disk");
+	remove(fname.c_str());
+	remove((fname + ".bloom").c_str());
+	return timers;
+}
+
+// offsets of the records in a spent coin file (found by their magic)
+static vector<size_t> spentRecords(const string &fname) {
+	ifstream in(fname.c_str(), ios::in | ios::binary);
+	stringstream contents;
+	contents << in.rdbuf();
+	string file = contents.str();
+	uint32_t magic = 0x53504e44u;
+	string m((const char*) &magic, sizeof(magic));
+	vector<size_t> offsets;
+	for (size_t off = file.find(m); off != string::npos; 
+		 off = file.find(m, off + 1)) {
+		if (off % 8 == 0)
+			offsets.push_back(off);
+	}
+	return offsets;
+}
+
+static void flipByte(const string &fname, size_t off) {
+	fstream f(fname.c_str(), ios::in | ios::out | ios::binary);
+	f.seekg(off);
+	char c = f.get();
+	f.seekp(off);
+	f.put(c ^ 0x10);
+}
+
+// sets the synced end in a spent coin file's header, as if the last sync
+// had been at off
+static void setSyncedEnd(const string &fname, uint64_t off) {
+	fstream f(fname.c_str(), ios::in | ios::out | ios::binary);
+	f.seekp(16);
+	f.write((const char*) &off, sizeof(off));
+}
+
+double* testSpentCoinRecovery() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	string fname = "/tmp/test.recover";
+	size_t SPENDS = 10;
+	SpentCoinDB::Spend spend(to_ZZ(1234), to_ZZ(5678)), previous;
+
+	remove(fname.c_str());
+	remove((fname + ".bloom").c_str());
+	{
+		SpentCoinDB db(fname);
+		for (size_t i = 0; i < SPENDS; i++)
+			db.insert(SpentCoinDB::serialKey(to_ZZ(i)), spend, previous);
+	}
+	vector<size_t> records = spentRecords(fname);
+	if (records.size() != SPENDS)
+		cout << "ERROR: found " << records.size() << " records, expected "
+			 << SPENDS << endl;
+
+	// past the last sync, pages may reach the disk in any order: a torn
+	// record followed by good ones is dropped along with them
+	size_t kept = SPENDS / 2 + 1;
+	setSyncedEnd(fname, records[SPENDS / 2]);
+	flipByte(fname, records[kept] + 8);
+	startTimer();
+	{
+		SpentCoinDB db(fname);
+		timers[timer++] = printTimer(timer, "Opened database with a torn "
+											"unsynced record");
+		if (db.size() != kept)
+			cout << "ERROR: recovered " << db.size() << " spends, expected "
+				 << kept << endl;
+		for (size_t i = kept; i < SPENDS; i++) {
+			if (!db.insert(SpentCoinDB::serialKey(to_ZZ(i)), spend, 
+						   previous))
+				cout << "ERROR: unsynced spend " << i << " was still "
+					 << "recorded" << endl;
+		}
+	}
+	{
+		SpentCoinDB db(fname);
+		if (db.size() != SPENDS)
+			cout << "ERROR: spends after a torn record were lost" << endl;
+	}
+
+	// a bad record before the synced end means the file was damaged
+	records = spentRecords(fname);
+	flipByte(fname, records[SPENDS / 2] + 8);
+	try {
+		SpentCoinDB db(fname);
+		cout << "ERROR: opened a database with a corrupt record" << endl;
+	} catch (CashException &e) {
+		cout << "Refused damaged database: " << e.what() << endl;
+	}
+	flipByte(fname, records[SPENDS / 2] + 8);
+	{
+		SpentCoinDB db(fname);
+		if (db.size() != SPENDS)
+			cout << "ERROR: repaired database has " << db.size() 
+				 << " spends, expected " << SPENDS << endl;
+	}
+	remove(fname.c_str());
+	remove((fname + ".bloom").c_str());
+	return timers;
+}
+
+double* testBloomFilter() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	size_t KEYS = 1000000;
+	double fpRate = 0.01;
+
+	BloomFilter filter(KEYS, fpRate);
+	cout << "filter bytes per key: " << (double) filter.sizeInBytes() / KEYS
+		 << ", hashes: " << filter.numHashes() << endl;
+	startTimer();
+	for (size_t i = 0; i < KEYS; i++)
+		filter.add(SpentCoinDB::serialKey(to_ZZ(i)));
+	timers[timer++] = printTimer(timer, "Added keys");
+
+	startTimer();
+	size_t missing = 0, falsePositives = 0;
+	for (size_t i = 0; i < KEYS; i++) {
+		if (!filter.mightContain(SpentCoinDB::serialKey(to_ZZ(i))))
+			missing++;
+		if (filter.mightContain(SpentCoinDB::serialKey(to_ZZ(KEYS + i))))
+			falsePositives++;
+	}
+	timers[timer++] = printTimer(timer, "Queried keys");
+	if (missing)
+		cout << "ERROR: " << missing << " added keys not found" << endl;
+	double rate = (double) falsePositives / KEYS;
+	cout << "false positive rate: " << rate << " (sized for " << fpRate 
+		 << ")" << endl;
+	if (rate > 2 * fpRate)
+		cout << "ERROR: too many false positives" << endl;
+
+	string fname = "/tmp/test.bloom";
+	filter.save(fname);
+	BloomFilter loaded(fname);
+	if (loaded.size() != filter.size() ||
+		!loaded.mightContain(SpentCoinDB::serialKey(to_ZZ(0))))
+		cout << "ERROR: loaded filter differs from the saved one" << endl;
+
+	// a file whose header doesn't match its contents is refused: k of 0
+	// or 17, no blocks, one block too many or too few, and a short file
+	ifstream in(fname.c_str(), ios::in | ios::binary);
+	stringstream contents;
+	contents << in.rdbuf();
+	in.close();
+	string saved = contents.str();
+	string bad[6];
+	uint32_t ks[] = { 0, 17 };
+	uint64_t blocks = filter.sizeInBytes() / 64;
+	uint64_t blockCounts[] = { 0, blocks + 1, blocks - 1 };
+	for (int i = 0; i < 2; i++) {
+		bad[i] = saved;
+		memcpy(&bad[i][12], &ks[i], sizeof(ks[i]));
+	}
+	for (int i = 0; i < 3; i++) {
+		bad[2 + i] = saved;
+		memcpy(&bad[2 + i][16], &blockCounts[i], sizeof(blockCounts[i]));
+	}
+	bad[5] = saved.substr(0, saved.size() - 1);
+	for (int i = 0; i < 6; i++) {
+		ofstream out(fname.c_str(), ios::out | ios::binary | ios::trunc);
+		out << bad[i];
+		out.close();
+		try {
+			BloomFilter b(fname);
+			cout << "ERROR: loaded bad filter file " << i << endl;
+		} catch (CashException &e) {
+		}
+	}
+	remove(fname.c_str());
+
+	// in front of the spent coin database, fresh serials never reach the
+	// index
+	fname = "/tmp/test.spent";
+	string filterName = fname + ".bloom";
+	remove(fname.c_str());
+	remove(filterName.c_str());
+	SpentCoinDB::Spend spend(to_ZZ(1), to_ZZ(2)), previous;
+	{
+		SpentCoinDB db(fname, false, fpRate);
+		startTimer();
+		for (size_t i = 0; i < KEYS; i++)
+			db.insert(SpentCoinDB::serialKey(to_ZZ(i)), spend, previous);
+		timers[timer++] = printTimer(timer, "Recorded fresh spends");
+		SpentCoinDB::FilterStats st = db.filterStats();
+		cout << "lookups: " << st.lookups << ", answered by filter: " 
+			 << st.negatives << ", false positives: " << st.falsePositives 
+			 << ", filter bytes: " << st.bytes << endl;
+		if (st.lookups != st.negatives + st.falsePositives)
+			cout << "ERROR: fresh serial found in the database" << endl;
+	}
+
+	// closing saved the filter, so opening again doesn't go through every
+	// key
+	size_t LOOKUPS = 100000;
+	vector<string> fresh;
+	for (size_t i = 0; i < LOOKUPS; i++)
+		fresh.push_back(SpentCoinDB::serialKey(to_ZZ(KEYS + i)));
+	startTimer();
+	{
+		SpentCoinDB db(fname, false, fpRate);
+		timers[timer++] = printTimer(timer, "Opened database with its "
+											"saved filter");
+		if (!db.filterStats().loaded)
+			cout << "ERROR: saved filter was not loaded" << endl;
+		if (!db.find(SpentCoinDB::serialKey(to_ZZ(0)), previous))
+			cout << "ERROR: spend missing after reopening" << endl;
+		startTimer();
+		for (size_t i = 0; i < LOOKUPS; i++)
+			db.find(fresh[i], previous);
+		double t = printTimer(timer, "Looked up fresh serials");
+		timers[timer++] = t;
+		cout << "ns per fresh lookup: " << t * 1e6 / LOOKUPS << endl;
+	}
+
+	// a saved filter that doesn't hold the recorded keys is rebuilt
+	BloomFilter other(KEYS, fpRate);
+	other.save(filterName);
+	startTimer();
+	{
+		SpentCoinDB db(fname, false, fpRate);
+		timers[timer++] = printTimer(timer, "Opened database, rebuilding "
+											"its filter");
+		if (db.filterStats().loaded)
+			cout << "ERROR: loaded a filter for other records" << endl;
+		if (!db.find(SpentCoinDB::serialKey(to_ZZ(KEYS - 1)), previous))
+			cout << "ERROR: rebuilt filter is missing a spend" << endl;
+	}
+	remove(fname.c_str());
+	remove(filterName.c_str());
+	return timers;
+}
+
+double* testPreparedCoins() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+
+	BankTool bankTool("tool.80.bank");
+	const BankParameters* params = new BankParameters("bank.80.params");
+	Wallet wallet("wallet.80", params);
+	vector<ZZ> contractInfo;
+	contractInfo.push_back(12345);
+	ZZ rVal = Hash::hash(contractInfo, hashAlg);
+	// compile the programs first, so neither spend pays for it
+	bankTool.verifyCoin(wallet.nextCoin(rVal));
+
+	startTimer();
+	Coin coin = wallet.nextCoin(rVal);
+	double full = printTimer(timer, "Spent a coin");
+	timers[timer++] = full;
+	if (!bankTool.verifyCoin(coin))
+		cout << "ERROR: coin failed to verify" << endl;
+
+	// prepare on all cores: every worker draws its own randomness
+	int COINS = 8;
+	ThreadPool::setSharedThreads(0);
+	startTimer();
+	wallet.precompute(COINS);
+	timers[timer++] = printTimer(timer, "Prepared coins");
+	ThreadPool::setSharedThreads(1);
+	if (wallet.getNumPrepared() != COINS)
+		cout << "ERROR: prepared " << wallet.getNumPrepared() << " coins, "
+			 << "expected " << COINS << endl;
+
+	vector<PreparedCoin> ready = wallet.getPrepared();
+	startTimer();
+	coin = wallet.nextCoin(rVal);
+	double fast = printTimer(timer, "Spent a prepared coin");
+	timers[timer++] = fast;
+	if (!bankTool.verifyCoin(coin))
+		cout << "ERROR: prepared coin failed to verify" << endl;
+	if (wallet.getNumPrepared() != COINS - 1)
+		cout << "ERROR: prepared coin was not used up" << endl;
+	// only T and the first message of its relation are computed at spend
+	for (unsigned i = 0; i < ready.size(); i++) {
+		if (ready[i].coinIndex != coin.getIndex())
+			continue;
+		const PreparedCoin &p = ready[i];
+		if (coin.getB() != p.values.at("B") || 
+			coin.getS() != p.values.at("S") ||
+			coin.getEndorsementCom() != p.values.at("y"))
+			cout << "ERROR: prepared values were computed again" << endl;
+		const var_map &rProofs = 
+			coin.getCoinProof().proof.getRandomizedProofs();
+		int recomputed = 0;
+		for (var_map::const_iterator it = rProofs.begin(); 
+			 it != rProofs.end(); ++it) {
+			if (p.proof.randomizedProofs.count(it->first) == 0 ||
+				p.proof.randomizedProofs.at(it->first) != it->second)
+				recomputed++;
+		}
+		if (recomputed != 1)
+			cout << "ERROR: " << recomputed << " relations were computed "
+				 << "at spend, expected only the one for T" << endl;
+	}
+	// the CL proof, which is most of a spend, and all of the proof of S and
+	// T but a few exponentiations for T, were made ahead of time
+	if (fast > 0)
+		cout << "spend speedup: " << full / fast << endl;
+	if (fast * 4 > full)
+		cout << "ERROR: a prepared spend took " << fast << " ms, not much "
+			 << "less than " << full << " ms" << endl;
+
+	// coins prepared in parallel must not share any randomness
+	set<ZZ> commitments;
+	commitments.insert(coin.getB());
+	commitments.insert(coin.getSCommitment());
+	commitments.insert(coin.getTCommitment());
+	for (int i = 1; i < COINS; i++) {
+		Coin c = wallet.nextCoin(rVal);
+		if (!bankTool.verifyCoin(c))
+			cout << "ERROR: prepared coin " << i << " failed to verify" 
+				 << endl;
+		commitments.insert(c.getB());
+		commitments.insert(c.getSCommitment());
+		commitments.insert(c.getTCommitment());
+	}
+	if (commitments.size() != 3 * (size_t) COINS)
+		cout << "ERROR: prepared coins share commitments" << endl;
+	return timers;
+}
+
+double* testCoinPool() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	hashalg_t hashAlg = Hash::SHA1;
+	string fname = "/tmp/test.pool";
+	string key = Ciphertext::generateKey(Ciphertext::AES_128_CBC);
+
+	BankTool bankTool("tool.80.bank");
+	const BankParameters* params = new BankParameters("bank.80.params");
+	Wallet wallet("wallet.80", params);
+	vector<ZZ> contractInfo;
+	contractInfo.push_back(12345);
+	ZZ rVal = Hash::hash(contractInfo, hashAlg);
+
+	int SIZE = 4, LOW = 2;
+	{
+		CoinPool pool(wallet, SIZE, LOW);
+		startTimer();
+		pool.waitUntilFull();
+		timers[timer++] = printTimer(timer, "Filled coin pool");
+		if (pool.available() != SIZE)
+			cout << "ERROR: pool has " << pool.available() << " coins, "
+				 << "expected " << SIZE << endl;
+
+		// spending below the low-water mark refills the pool
+		for (int i = 0; i < SIZE - LOW + 1; i++) {
+			startTimer();
+			Coin coin = wallet.nextCoin(rVal);
+			timers[timer++] = printTimer(timer, "Spent a coin from the pool");
+			if (!bankTool.verifyCoin(coin))
+				cout << "ERROR: coin from the pool failed to verify" << endl;
+		}
+		pool.waitUntilFull();
+		if (pool.available() != SIZE)
+			cout << "ERROR: pool was not refilled" << endl;
+		pool.save(fname, key);
+	}
+
+	// a restarted client gets its coins back, minus any spent meanwhile
+	Wallet restarted("wallet.80", params);
+	for (int i = 0; i < SIZE - LOW + 1; i++)
+		restarted.nextCoinIndex();
+	CoinPool pool(restarted, 0, 0);
+	restarted.nextCoinIndex();
+	int loaded = pool.load(fname, key);
+	if (loaded != SIZE - 1)
+		cout << "ERROR: loaded " << loaded << " coins, expected " 
+			 << SIZE - 1 << endl;
+	Coin coin = restarted.nextCoin(rVal);
+	if (!bankTool.verifyCoin(coin))
+		cout << "ERROR: coin from the loaded pool failed to verify" << endl;
+	try {
+		pool.load(fname, Ciphertext::generateKey(Ciphertext::AES_128_CBC));
+		cout << "ERROR: pool loaded with the wrong key" << endl;
+	} catch (CashException &e) {
+	}
+
+	// the right key is not enough to load the pool into another wallet
+	UserTool userTool("tool.80.user", params, "public.80.arbiter",
+					  "public.regular.80.arbiter");
+	Wallet another = withdrawWallet(bankTool, userTool, 
+									wallet.getWalletSize(), 
+									wallet.getDenomination());
+	CoinPool anotherPool(another, 0, 0);
+	try {
+		anotherPool.load(fname, key);
+		cout << "ERROR: pool loaded into another wallet" << endl;
+	} catch (CashException &e) {
+	}
+	if (another.getNumPrepared() != 0)
+		cout << "ERROR: another wallet got prepared coins" << endl;
+	remove(fname.c_str());
+	return timers;
+}
+
+double* testMerkleBuilder() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	MerkleContract contract(Ciphertext::generateKey(Ciphertext::AES_128_CBC),
+							Hash::SHA1);
+
+	// not a whole number of chunks, nor a power of two of them
+	string data(37 * CHUNK_SIZE + 123, '\0');
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (char) (i * 131 + i / 7);
+
+	startTimer();
+	MerkleTree tree(data, contract);
+	timers[timer++] = printTimer(timer, "Built whole Merkle tree");
+
+	// feed the builder pieces that don't line up with chunks
+	string leafFile = "/tmp/test.leaves";
+	startTimer();
+	MerkleBuilder builder(contract, leafFile);
+	for (size_t pos = 0, len = 1; pos < data.size(); pos += len, len += 97)
+		builder.add(data.data() + pos, min(len, data.size() - pos));
+	hash_t root = builder.finish();
+	timers[timer++] = printTimer(timer, "Built streaming Merkle root");
+	if (root != tree.getRoot() || builder.getHeight() != tree.getHeight())
+		cout << "ERROR: streaming root differs from the tree's" << endl;
+
+	ifstream leaves(leafFile.c_str(), ios::in | ios::binary);
+	leaves.seekg(0, ios::end);
+	if ((size_t) leaves.tellg() != 
+		tree.getNumLeaves() * tree.getRoot().str().size())
+		cout << "ERROR: wrong number of leaves written" << endl;
+	remove(leafFile.c_str());
+
+	string fname = "/tmp/test.merkle";
+	ofstream out(fname.c_str(), ios::out | ios::binary);
+	out << data;
+	out.close();
+	startTimer();
+	if (MerkleBuilder::hashFile(fname, contract) != tree.getRoot())
+		cout << "ERROR: root of the file differs from the tree's" << endl;
+	timers[timer++] = printTimer(timer, "Hashed file");
+	remove(fname.c_str());
+
+	// trees over hashed blocks
+	vector<hash_t> blocks;
+	MerkleBuilder blockBuilder(contract);
+	for (int i = 0; i < 5; i++) {
+		blocks.push_back(contract.hash(data.substr(i * 100, 100)));
+		blockBuilder.addLeaf(blocks.back());
+	}
+	if (blockBuilder.finish() != MerkleTree(blocks, contract).getRoot())
+		cout << "ERROR: streaming root over blocks differs" << endl;
+	return timers;
+}
+
+double* testParallelMerkle() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	string key = Ciphertext::generateKey(Ciphertext::AES_128_CBC);
+
+	// a context gives the same hashes as Hash::hash, keyed or not
+	for (int keyed = 0; keyed < 2; keyed++) {
+		HashContext ctx(Hash::SHA256, keyed ? key : "");
+		string msg = "the quick brown fox jumps over the lazy dog";
+		if (ctx.hash(msg.data(), msg.size()) != 
+			Hash::hash(msg, Hash::SHA256, keyed ? key : "", Hash::TYPE_PLAIN))
+			cout << "ERROR: HashContext differs from Hash::hash" << endl;
+	}
+
+	MerkleContract contract(key, Hash::SHA1);
+	string data(32 * 1024 * CHUNK_SIZE + 5, '\0');
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (char) (i * 131 + i / 7);
+
+	hash_t roots[2];
+	for (int parallel = 0; parallel < 2; parallel++) {
+		ThreadPool::setSharedThreads(parallel ? 0 : 1);
+		startTimer();
+		MerkleTree tree(data, contract);
+		roots[parallel] = tree.getRoot();
+		timers[timer++] = printTimer(timer, parallel ? 
+			"Built Merkle tree on the shared pool" :
+			"Built Merkle tree serially");
+	}
+	ThreadPool::setSharedThreads(1);
+	MerkleBuilder builder(contract);
+	builder.add(data);
+	if (roots[0] != roots[1] || roots[0] != builder.finish())
+		cout << "ERROR: parallel Merkle root differs" << endl;
+	return timers;
+}
+
+double* testMerkleProofs() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	MerkleContract contract(Ciphertext::generateKey(Ciphertext::AES_128_CBC),
+							Hash::SHA1);
+
+	// a node is a plain digest, with the key kept once by the contract
+	hash_t h = contract.hash(string("a Merkle node"));
+	if (Digest::fromHash(h).toHash(contract.getKey()) != h)
+		cout << "ERROR: digest doesn't convert back to the same hash" << endl;
+	cout << "Bytes per node: " << sizeof(Digest) << " (a hash_t is " 
+		 << sizeof(hash_t) << " plus " << h.str().size() + h.key.size()
+		 << " on the heap)" << endl;
+
+	string data(64 * 1024 * CHUNK_SIZE, '\0');
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (char) (i * 131 + i / 7);
+	startTimer();
+	MerkleProver prover(data, contract);
+	timers[timer++] = printTimer(timer, "Built Merkle tree");
+
+	MerkleVerifier verifier(prover.getRoot(), prover.getNumBlocks(), 
+							contract);
+	startTimer();
+	hash_matrix proofs = prover.generateProofs(verifier.getChallenges());
+	timers[timer++] = printTimer(timer, "Proved challenged blocks");
+	startTimer();
+	if (!verifier.verifyProofs(proofs))
+		cout << "ERROR: Merkle proofs did not verify" << endl;
+	timers[timer++] = printTimer(timer, "Verified challenged blocks");
+
+	// the tree is kept, so proofs are only lookups
+	vector<unsigned> many;
+	for (unsigned i = 0; i < 4096; i++)
+		many.push_back((i * 2654435761u) % prover.getNumBlocks());
+	startTimer();
+	hash_matrix manyProofs = prover.generateProofs(many);
+	timers[timer++] = printTimer(timer, "Proved 4096 challenged blocks");
+
+	string fname = "/tmp/test.mtree";
+	prover.save(fname);
+	startTimer();
+	boost::scoped_ptr<MerkleProver> loaded(MerkleProver::load(fname, 
+															  contract));
+	hash_matrix loadedProofs = loaded->generateProofs(many);
+	timers[timer++] = printTimer(timer, "Loaded tree and proved blocks");
+	if (loaded->getRoot() != prover.getRoot() || 
+		loadedProofs.size() != manyProofs.size())
+		cout << "ERROR: loaded tree differs" << endl;
+	for (size_t i = 0; i < manyProofs.size(); i++) {
+		for (size_t j = 0; j < manyProofs[i].size(); j++) {
+			if (loadedProofs[i][j].node != manyProofs[i][j].node)
+				cout << "ERROR: loaded tree gave another proof" << endl;
+		}
+	}
+	try {
+		MerkleContract other(Ciphertext::generateKey(Ciphertext::AES_128_CBC),
+							 Hash::SHA1);
+		delete MerkleProver::load(fname, other);
+		cout << "ERROR: loaded a tree with the wrong contract" << endl;
+	} catch (CashException &e) {
+	}
+	remove(fname.c_str());
+
+	proofs[0][1].node.bytes[0] ^= 1;
+	if (verifier.verifyProofs(proofs))
+		cout << "ERROR: altered Merkle proof verified" << endl;
+	return timers;
+}
+
+double* testMerkleMultiProofs() {
+	double* timers = new double[MAX_TIMERS];
+	int timer = 0;
+	MerkleContract contract(Ciphertext::generateKey(Ciphertext::AES_128_CBC),
+							Hash::SHA1);
+	string data(64 * 1024 * CHUNK_SIZE, '\0');
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (char) (i * 131 + i / 7);
+	MerkleProver prover(data, contract);
+	size_t digestBytes = prover.getRoot().size();
+
+	// the same challenges as one path each, and as one multi-proof
+	unsigned counts[] = { 16, 64, 256 };
+	const int RUNS = 100;
+	multiProof multi;
+	for (int c = 0; c < 3; c++) {
+		MerkleVerifier verifier(prover.getRoot(), prover.getNumBlocks(),
+								contract, counts[c]);
+		hash_matrix paths = prover.generateProofs(verifier.getChallenges());
+		multi = prover.generateMultiProof(verifier.getChallenges());
+
+		// a path node is a digest and its path bits; a multi-proof has
+		// digests, plus the index of each challenged block
+		size_t pathNodes = 0;
+		for (unsigned i = 0; i < paths.size(); i++)
+			pathNodes += paths[i].size();
+		size_t multiNodes = multi.leaves.size() + multi.siblings.size();
+		cout << counts[c] << " challenges: " << pathNodes << " nodes ("
+			 << pathNodes * (digestBytes + sizeof(uint32_t)) 
+			 << " bytes) as paths, " << multiNodes << " nodes ("
+			 << multiNodes * digestBytes + 
+				multi.challenges.size() * sizeof(uint32_t)
+			 << " bytes) as a multi-proof" << endl;
+
+		startTimer();
+		for (int r = 0; r < RUNS; r++) {
+			if (!verifier.verifyProofs(paths))
+				cout << "ERROR: Merkle paths did not verify" << endl;
+		}
+		timers[timer++] = printTimer(timer, "Verified paths (x100)");
+		startTimer();
+		for (int r = 0; r < RUNS; r++) {
+			if (!verifier.verifyMultiProof(multi))
+				cout << "ERROR: Merkle multi-proof did not verify" << endl;
+		}
+		timers[timer++] = printTimer(timer, "Verified multi-proof (x100)");
+
+		multiProof bad = multi;
+		bad.siblings[bad.siblings.size() / 2].bytes[0] ^= 1;
+		if (verifier.verifyMultiProof(bad))
+			cout << "ERROR: altered multi-proof verified" << endl;
+		bad = multi;
+		bad.siblings.pop_back();
+		if (verifier.verifyMultiProof(bad))
+			cout << "ERROR: truncated multi-proof verified" << endl;
+	}
+
+	// like the Arbiter's, a verifier may only know the number of blocks,
+	// which needn't be a power of two (the tree is padded)
+	vector<hash_t> blocks;
+	for (unsigned i = 0; i < 37; i++)
+		blocks.push_back(contract.hash(data.substr(i * CHUNK_SIZE, 
+												   CHUNK_SIZE)));
+	MerkleProver padded(blocks, contract);
+	MerkleVerifier verifier(padded.getRoot(), blocks.size(), contract, 8);
+	if (!verifier.verifyProofs(padded.generateProofs(
+			verifier.getChallenges())))
+		cout << "ERROR: paths of a padded tree did not verify" << endl;
+	if (!verifier.verifyMultiProof(padded.generateMultiProof(
+			verifier.getChallenges())))
+		cout << "ERROR: multi-proof of a padded tree did not verify" << endl;
+
+	// multi-proofs survive serialization
+	multiProof copy;
+	loadString(copy, saveString(multi));
+	if (copy.challenges != multi.challenges || copy.leaves != multi.leaves ||
+		copy.siblings != multi.siblings)
+		cout << "ERROR: multi-proof changed when serialized" << endl;
 	return timers;
 }
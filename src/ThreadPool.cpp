@@ -0,0 +1,135 @@
+#include "ThreadPool.h"
+#include <boost/bind.hpp>
+
+ThreadPool::ThreadPool(unsigned threads)
+	: job(0), generation(0), stopping(false)
+{
+	for (unsigned i = 1; i < threads; i++)
+		workers.push_back(boost::shared_ptr<boost::thread>(
+			new boost::thread(boost::bind(&ThreadPool::workerLoop, this, i))));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		boost::mutex::scoped_lock l(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (unsigned i = 0; i < workers.size(); i++)
+		workers[i]->join();
+}
+
+void ThreadPool::parallelFor(size_t n, const task_t &f) {
+	boost::mutex::scoped_try_lock running(runLock);
+	if (!running || workers.empty() || n < 2) {
+		// busy (or nothing to share): do it all here
+		for (size_t i = 0; i < n; i++)
+			f(i);
+		return;
+	}
+
+	Job j(size(), f);
+	for (size_t i = 0; i < n; i++)
+		j.queues[i % j.queues.size()].push_back(i);
+	{
+		boost::mutex::scoped_lock l(lock);
+		j.active = workers.size();
+		job = &j;
+		generation++;
+	}
+	wake.notify_all();
+
+	runSlot(j, 0);
+
+	{
+		boost::mutex::scoped_lock l(lock);
+		while (j.active)
+			done.wait(l);
+		job = 0;
+	}
+	if (j.error)
+		boost::rethrow_exception(j.error);
+}
+
+void ThreadPool::workerLoop(unsigned slot) {
+	unsigned seen = 0;
+	while (true) {
+		Job *j;
+		{
+			boost::mutex::scoped_lock l(lock);
+			while (!stopping && generation == seen)
+				wake.wait(l);
+			if (stopping)
+				return;
+			seen = generation;
+			j = job;
+		}
+		runSlot(*j, slot);
+		{
+			boost::mutex::scoped_lock l(lock);
+			if (--j->active == 0)
+				done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::runSlot(Job &job, unsigned slot) {
+	size_t task;
+	while (nextTask(job, slot, task)) {
+		try {
+			job.f(task);
+		} catch (...) {
+			boost::mutex::scoped_lock l(job.errorLock);
+			if (!job.error)
+				job.error = boost::current_exception();
+		}
+	}
+}
+
+bool ThreadPool::nextTask(Job &job, unsigned slot, size_t &task) {
+	unsigned slots = job.queues.size();
+	// own queue from the back, then steal from the front of the others;
+	// nothing is ever added to a queue once the job starts, so if they
+	// are all empty we're done
+	{
+		boost::mutex::scoped_lock l(job.locks[slot]);
+		if (!job.queues[slot].empty()) {
+			task = job.queues[slot].back();
+			job.queues[slot].pop_back();
+			return true;
+		}
+	}
+	for (unsigned k = 1; k < slots; k++) {
+		unsigned victim = (slot + k) % slots;
+		boost::mutex::scoped_lock l(job.locks[victim]);
+		if (!job.queues[victim].empty()) {
+			task = job.queues[victim].front();
+			job.queues[victim].pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+// the pool and its lock are never freed, so workers aren't joined by
+// static destructors at exit
+static boost::mutex* sharedLock = new boost::mutex();
+static boost::shared_ptr<ThreadPool>* sharedPool =
+	new boost::shared_ptr<ThreadPool>();
+
+boost::shared_ptr<ThreadPool> ThreadPool::shared() {
+	boost::mutex::scoped_lock l(*sharedLock);
+	return *sharedPool;
+}
+
+void ThreadPool::setSharedThreads(unsigned threads) {
+	if (threads == 0)
+		threads = boost::thread::hardware_concurrency();
+	boost::shared_ptr<ThreadPool> p;
+	if (threads > 1)
+		p.reset(new ThreadPool(threads));
+	boost::mutex::scoped_lock l(*sharedLock);
+	// the old pool is destroyed (and its workers joined) by whoever drops
+	// the last reference to it
+	sharedPool->swap(p);
+}
@@ -0,0 +1,84 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <vector>
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+
+/*! \brief A fixed set of worker threads for running independent loop
+ * iterations (e.g., one exponentiation per relation of a proof) on all
+ * cores.
+ *
+ * parallelFor deals the iterations out to one queue per thread (the
+ * calling thread takes a share too).  Each thread works from the back of
+ * its own queue and, when that runs dry, steals from the front of the
+ * others, so a few slow iterations don't leave the other cores idle.
+ *
+ * The pool runs one loop at a time: a parallelFor called while another
+ * one is running (from another thread, or from inside one of its
+ * iterations) just runs its iterations in the calling thread.
+ */
+class ThreadPool : private boost::noncopyable {
+	public:
+		typedef boost::function<void (size_t)> task_t;
+
+		/*! starts threads-1 workers; the thread calling parallelFor is
+		 * the last one */
+		explicit ThreadPool(unsigned threads);
+		~ThreadPool();
+
+		/*! number of threads a loop runs on, including the caller */
+		unsigned size() const { return workers.size() + 1; }
+
+		/*! calls f(i) for every i in [0, n), in no particular order and
+		 * possibly concurrently; returns once all calls have returned.
+		 * If any call throws, the first exception is rethrown here
+		 * (after the remaining calls have run) */
+		void parallelFor(size_t n, const task_t &f);
+
+		/*! the process-wide pool used by the provers and verifiers, or an
+		 * empty pointer if they should run serially (the default) */
+		static boost::shared_ptr<ThreadPool> shared();
+
+		/*! sets the number of threads of the process-wide pool; 0 means
+		 * one per core, and 1 turns the pool off.  Loops already running
+		 * on the old pool finish on it */
+		static void setSharedThreads(unsigned threads);
+
+	private:
+		struct Job {
+			Job(unsigned slots, const task_t &f)
+				: f(f), queues(slots), locks(new boost::mutex[slots]),
+				  active(0) {}
+
+			const task_t &f;
+			vector<deque<size_t> > queues;
+			boost::scoped_array<boost::mutex> locks;
+			boost::mutex errorLock;
+			boost::exception_ptr error;
+			unsigned active; // workers still running this job
+		};
+
+		void workerLoop(unsigned slot);
+		static void runSlot(Job &job, unsigned slot);
+		static bool nextTask(Job &job, unsigned slot, size_t &task);
+
+		vector<boost::shared_ptr<boost::thread> > workers;
+		boost::mutex lock; // guards job, generation and stopping
+		boost::condition_variable wake, done;
+		Job *job;
+		unsigned generation;
+		bool stopping;
+		boost::mutex runLock; // held while a parallelFor is running
+};
+
+#endif /*_THREADPOOL_H_*/
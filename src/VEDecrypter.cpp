@@ -45,14 +45,16 @@ void VEDecrypter::setup(const int m, const int modLength,
 	ZZ f = env.variables.at("f");
 	vector<ZZ> as(m);
 	vector<ZZ> xs(m+2);
-	for (variable_map::iterator it = env.variables.begin();
-								it != env.variables.end(); ++it) {
-		if (it->first.find("x_") != string::npos) {
-			int index = lexical_cast<int>(it->first.substr(2));
-			xs[index-1] = it->second;
-		} else if (it->first.find("a_") != string::npos) {
-			int index = lexical_cast<int>(it->first.substr(2));
-			as[index-1] = it->second;
+	for (unsigned s = 0; s < env.variables.slotCount(); s++) {
+		if (!env.variables.has(s))
+			continue;
+		const string &name = env.variables.name(s);
+		if (name.find("x_") != string::npos) {
+			int index = lexical_cast<int>(name.substr(2));
+			xs[index-1] = env.variables.value(s);
+		} else if (name.find("a_") != string::npos) {
+			int index = lexical_cast<int>(name.substr(2));
+			as[index-1] = env.variables.value(s);
 		}
 	}
 	xs[m] = env.variables.at("y");
@@ -38,7 +38,8 @@ vector<ZZ> VEProver::encrypt(const vector<ZZ> &messages, const string &label,
 	InterpreterProver calculator;
 	calculator.check(CommonFunctions::getZKPDir()+"/encrypt.txt", inputs, e.groups);
 	startTimer();
-	calculator.compute(e.variables);
+	variable_map inputVars = e.variables;
+	calculator.compute(inputVars);
 	printTimer("Computed stuff for normal encryption");
 
 	// get new environment
@@ -51,14 +52,16 @@ vector<ZZ> VEProver::encrypt(const vector<ZZ> &messages, const string &label,
 	// need hash vector to be u_1, ..., u_m, v
 	// set initial size for ciphertext so we can order it
 	vector<ZZ> ciphertext(m+1);
-	for (variable_map::iterator it = e.variables.begin();
-								it != e.variables.end(); ++it) {
-		if (it->first.find("u_") != string::npos) {
+	for (unsigned s = 0; s < e.variables.slotCount(); s++) {
+		if (!e.variables.has(s))
+			continue;
+		const string &name = e.variables.name(s);
+		if (name.find("u_") != string::npos) {
 			// XXX: this is string parsing -- very undesirable!
-			int index = lexical_cast<int>(it->first.substr(2));
-			ciphertext[index-1] = it->second;
-		} else if (it->first.find("v") != string::npos) {
-			ciphertext[m] = it->second;
+			int index = lexical_cast<int>(name.substr(2));
+			ciphertext[index-1] = e.variables.value(s);
+		} else if (name.find("v") != string::npos) {
+			ciphertext[m] = e.variables.value(s);
 		}
 	}
 	string hashKey = pk->getHashKey();
@@ -101,7 +104,8 @@ VECiphertext VEProver::verifiableEncrypt(const ZZ &commitment,
 	InterpreterProver prover;
 	prover.check(CommonFunctions::getZKPDir()+"/ve.txt", inputs, env.groups);
 	startTimer();
-	prover.compute(env.variables);
+	variable_map inputVars = env.variables;
+	prover.compute(inputVars);
 	printTimer("Computed values for verifiable encryption");
 	startTimer();
 	SigmaProof proof = prover.computeProof(hashAlg);
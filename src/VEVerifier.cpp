@@ -38,6 +38,7 @@ bool VEVerifier::verify(const VECiphertext& text, const ZZ& x,
 	variable_map publics = text.getPublics();
 	InterpreterVerifier verifier;
 	verifier.check(CommonFunctions::getZKPDir()+"/ve.txt", inputs, env.groups);
-	verifier.compute(env.variables, proof.getCommitments(), publics);
+	variable_map inputVars = env.variables;
+	verifier.compute(inputVars, proof.getCommitments(), publics);
 	return verifier.verify(proof, stat);
 }
@@ -1,5 +1,8 @@
 
 #include "Wallet.h"
+#include "ThreadPool.h"
+#include <set>
+#include <boost/bind.hpp>
 
 Wallet::Wallet(const ZZ &sk, const ZZ &sIn, const ZZ &tIn, int size,
 			   int d, const BankParameters* bp, int st, int l, 
@@ -40,6 +43,7 @@ Wallet::Wallet(const Wallet &o)
 }
 
 int Wallet::nextCoinIndex() {
+	boost::mutex::scoped_lock l(lock);
 	if(numCoinsUsed >= walletSize) {
 		throw CashException(CashException::CE_UNKNOWN_ERROR,
 				"Tried to get the next coin from a wallet from which every "
@@ -50,10 +54,84 @@ int Wallet::nextCoinIndex() {
 
 Coin Wallet::nextCoin(const ZZ &rValue) {
 	int i = nextCoinIndex();
-	Coin* c = newCoin(rValue, i);
-	Coin ret(*c);
-	delete c;
-	return ret;
+	PreparedCoin p;
+	bool isPrepared = false;
+	boost::function<void ()> listener;
+	{
+		boost::mutex::scoped_lock l(lock);
+		map<int, PreparedCoin>::iterator it = prepared.find(i);
+		if (it != prepared.end()) {
+			p = it->second;
+			// never use the same randomness for two spends
+			prepared.erase(it);
+			isPrepared = true;
+		}
+		listener = spendListener;
+	}
+	// outside the lock, as the listener may well look at the wallet
+	if (listener)
+		listener();
+	return Coin(params, walletSize, i, sk_u, s, t, signature, stat, lx,
+				rValue, coinDenom, hashAlg, isPrepared ? &p : 0);
+}
+
+void Wallet::precompute(int count) {
+	vector<int> indices;
+	{
+		boost::mutex::scoped_lock l(lock);
+		int last = min(walletSize, numCoinsUsed + count);
+		for (int i = numCoinsUsed; i < last; i++) {
+			if (prepared.count(spendOrder[i]) == 0)
+				indices.push_back(spendOrder[i]);
+		}
+	}
+	vector<PreparedCoin> coins(indices.size());
+	ThreadPool::task_t task = boost::bind(&Wallet::prepareCoin, this, 
+										  &indices, &coins, _1);
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	if (pool) {
+		pool->parallelFor(indices.size(), task);
+	} else {
+		for (size_t i = 0; i < indices.size(); i++)
+			task(i);
+	}
+
+	// coins spent meanwhile were made without their prepared parts
+	addPrepared(coins);
+}
+
+void Wallet::addPrepared(const vector<PreparedCoin> &coins) {
+	boost::mutex::scoped_lock l(lock);
+	set<int> unspent(spendOrder.begin() + numCoinsUsed, spendOrder.end());
+	for (size_t i = 0; i < coins.size(); i++) {
+		if (unspent.count(coins[i].coinIndex))
+			prepared[coins[i].coinIndex] = coins[i];
+	}
+}
+
+vector<PreparedCoin> Wallet::getPrepared() const {
+	boost::mutex::scoped_lock l(lock);
+	vector<PreparedCoin> coins;
+	for (map<int, PreparedCoin>::const_iterator it = prepared.begin();
+		 it != prepared.end(); ++it)
+		coins.push_back(it->second);
+	return coins;
+}
+
+void Wallet::setSpendListener(const boost::function<void ()> &f) {
+	boost::mutex::scoped_lock l(lock);
+	spendListener = f;
+}
+
+void Wallet::prepareCoin(const vector<int> *indices, 
+						 vector<PreparedCoin> *coins, size_t i) const {
+	(*coins)[i] = Coin::prepare(params, walletSize, (*indices)[i], sk_u, s, 
+								t, signature, lx, coinDenom, hashAlg);
+}
+
+int Wallet::getNumPrepared() const {
+	boost::mutex::scoped_lock l(lock);
+	return prepared.size();
 }
 
 Coin* Wallet::newCoin(const ZZ &rValue, int coinIndex) {
@@ -69,6 +147,7 @@ void Wallet::newCoin(Coin& coin, const ZZ &rValue, int coinIndex) {
 }
 
 bool Wallet::replaceCoin(ZZ &index) {
+	boost::mutex::scoped_lock l(lock);
 	// check that 0 <= indexArg < walletSize
 	if(index < 0 || index >= walletSize) {
 		return false;
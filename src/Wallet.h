@@ -3,6 +3,9 @@
 #define _WALLET_H_
 
 #include "Coin.h"
+#include <map>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 
 class Wallet {
 
@@ -22,9 +25,31 @@ class Wallet {
 		 *  this increments the numCoinsUsed counter by one */
 		int nextCoinIndex();
 
-		/*! returns the next coin to use */
+		/*! returns the next coin to use; if it was prepared (see
+		 * precompute), only the part depending on R is computed now */
 		Coin nextCoin(const ZZ &R);
 
+		/*! prepares (see Coin::prepare) the next count coins to be spent
+		 * that aren't prepared yet, on the shared ThreadPool if there is
+		 * one.  Meant for idle time, e.g. on a background thread: it may
+		 * run while coins are being spent.  The coins' randomness comes
+		 * from NTL's RandomBnd, which is safe to call from many threads */
+		void precompute(int count);
+
+		/*! number of coins prepared and not yet spent */
+		int getNumPrepared() const;
+
+		/*! the coins prepared and not yet spent */
+		vector<PreparedCoin> getPrepared() const;
+
+		/*! adds prepared coins (e.g., ones saved earlier), ignoring any
+		 * for coins already spent */
+		void addPrepared(const vector<PreparedCoin> &coins);
+
+		/*! f is called whenever nextCoin takes a coin (from the thread
+		 * calling nextCoin) */
+		void setSpendListener(const boost::function<void ()> &f);
+
 		/*! returns a coin for a given index */
 		Coin* newCoin(const ZZ &R, int coinIndex);
 		void newCoin(Coin& coin, const ZZ &R, int coinIndex);
@@ -39,6 +64,9 @@ class Wallet {
 		int getRemainingValue() const { return getNumCoinsLeft() * coinDenom; }
 		bool empty() const { return (walletSize == numCoinsUsed); }
 
+		/*! identifies the wallet: a hash of the bank's signature on it */
+		ZZ getId() const { return Hash::hash(signature, Hash::SHA1); }
+
 	private:
 		ZZ sk_u, s, t;
 		int walletSize;
@@ -52,6 +80,16 @@ class Wallet {
 		vector<ZZ> signature;
 		vector<int> spendOrder;
 
+		/*! prepares the i-th of indices into the i-th of coins */
+		void prepareCoin(const vector<int> *indices, 
+						 vector<PreparedCoin> *coins, size_t i) const;
+
+		// coin index -> prepared coin; NOT serialized (holds secrets)
+		map<int, PreparedCoin> prepared;
+		boost::function<void ()> spendListener; // NOT serialized
+		// guards prepared, spendListener, numCoinsUsed and spendOrder
+		mutable boost::mutex lock;
+
 		friend class boost::serialization::access;
 		template <class Archive>
 		void serialize(Archive& ar, const unsigned int ver) {
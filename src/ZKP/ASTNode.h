@@ -184,6 +184,7 @@ class ASTDeclIdentifierLit : public ASTDeclGeneral,
 		int line;
 		int column;
 
+		ASTDeclIdentifierLit() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTDeclGeneral);
@@ -228,6 +229,7 @@ class ASTDeclIdentifierSub : public ASTDeclGeneral,
 		ASTIdentifierLitPtr base;
 		string sub;
 
+		ASTDeclIdentifierSub() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTDeclGeneral);
@@ -356,6 +358,7 @@ class ASTUnaryOp : public ASTExpr {
 		void visitChildren(ASTVisitor& v) { expr->visit(v); }
 
 	protected:
+		ASTUnaryOp() {}
 		ASTExprPtr expr;
 
 		friend class boost::serialization::access;
@@ -387,6 +390,8 @@ class ASTNegative : public ASTUnaryOp,
 
 		VarInfo getExprType(Environment &env);
 		
+	private:
+		ASTNegative() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTUnaryOp);
@@ -458,6 +463,7 @@ class ASTAdd : public ASTBinaryOp,
 		ZZ eval(Environment &env);
 		
 	private:
+		ASTAdd() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTBinaryOp);
@@ -491,6 +497,7 @@ class ASTSub : public ASTBinaryOp,
 		ZZ eval(Environment &env);	
 
 	private:
+		ASTSub() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTBinaryOp);
@@ -524,6 +531,7 @@ class ASTMul : public ASTBinaryOp,
 		ZZ eval(Environment &env);
 
 	private:
+		ASTMul() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTBinaryOp);
@@ -559,6 +567,7 @@ class ASTDiv : public ASTBinaryOp,
 		ZZ eval(Environment &env);
 
 	private:
+		ASTDiv() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTBinaryOp);
@@ -794,6 +803,7 @@ class ASTDeclIDRange : public ASTDeclGeneral,
 		ASTExprPtr lbound;
 		ASTExprPtr ubound;	
 
+		ASTDeclIDRange() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTDeclGeneral);
@@ -859,6 +869,7 @@ class ASTForRel : public ASTRelation,
 		ASTExprPtr lbound;
 		ASTRelationPtr rel;
 		
+		ASTForRel() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTRelation);
@@ -899,6 +910,7 @@ class ASTEqual : public ASTRelation,
 		ASTIdentifierSubPtr id;
 		ASTExprPtr expr;
 		
+		ASTEqual() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTRelation);
@@ -942,6 +954,7 @@ class ASTCommitment : public ASTRelation,
 		ASTIdentifierSubPtr id;
 		ASTExprPtr expr;
 		
+		ASTCommitment() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar  & base_object_nvp(ASTRelation);
@@ -963,6 +976,7 @@ class ASTGiven : public ASTNode {
 		ASTListDeclPtr getItems() { return items; }
 	
 	protected:
+		ASTGiven() {}
 		ASTListDeclPtr items;
 
 		friend class boost::serialization::access;
@@ -999,6 +1013,7 @@ class ASTRandomPrime : public ASTGiven,
 	private:
 		ASTExprPtr length;
 
+		ASTRandomPrime() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1036,6 +1051,7 @@ class ASTRandomBnd : public ASTGiven,
 		ASTExprPtr lbound;
 		ASTExprPtr ubound;
 		
+		ASTRandomBnd() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1076,6 +1092,7 @@ class ASTDeclGroup : public ASTGiven,
 		ASTDeclIdentifierLitPtr group;
 		ASTDeclIdentifierSubPtr modulus;
 
+		ASTDeclGroup() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1101,6 +1118,8 @@ class ASTDeclIntegers : public ASTGiven,
 
 		void visitChildren(ASTVisitor& v) { items->visit(v); }		
 		
+	private:
+		ASTDeclIntegers() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1195,6 +1214,7 @@ class ASTDeclElements : public ASTGiven,
 		ASTIdentifierLitPtr group;
 		ASTListRelationPtr relations;
 
+		ASTDeclElements() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1228,6 +1248,7 @@ class ASTDeclExponents : public ASTGiven,
 	private: 
 		ASTIdentifierLitPtr group;
 
+		ASTDeclExponents() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1261,6 +1282,7 @@ class ASTDeclRandExponents : public ASTGiven,
 	private: 
 		ASTIdentifierLitPtr group;
 
+		ASTDeclRandExponents() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTGiven);
@@ -1299,6 +1321,7 @@ class ASTDeclEqual : public ASTRelation,
 		ASTDeclIdentifierSubPtr id;
 		ASTExprPtr expr;
 
+		ASTDeclEqual() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTRelation);
@@ -1354,6 +1377,7 @@ class ASTRange : public ASTRelation,
 		bool lowerStrict;
 		bool upperStrict;
 
+		ASTRange() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTRelation);
@@ -1423,6 +1447,7 @@ class ASTForExpr : public ASTExpr,
 		ASTExprPtr expr;
 		string op;
 		
+		ASTForExpr() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTExpr);
@@ -1464,6 +1489,7 @@ class ASTComputation : public ASTNode,
 		ASTListRandomsPtr randExp;
 		ASTListRelationPtr relations;
 
+		ASTComputation() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTNode);
@@ -1502,6 +1528,7 @@ class ASTProof : public ASTNode,
 		ASTListGivenPtr knowledge;
 		ASTListRelationPtr suchThat;
 		
+		ASTProof() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTNode);
@@ -1538,6 +1565,7 @@ class ASTSpec : public ASTNode,
 		ASTComputationPtr comp;
 		ASTProofPtr proof;
 
+		ASTSpec() {}
 		friend class boost::serialization::access;
 		template <class A> void serialize(A& ar, const unsigned int ver) {
 			ar	& base_object_nvp(ASTNode);
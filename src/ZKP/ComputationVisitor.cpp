@@ -13,10 +13,12 @@ void ComputationVisitor::applyASTDeclRandExponents(ASTDeclRandExponentsPtr n) {
 		ASTNodePtr ith = exps->get(i);
 		if ((exp = dynamic_pointer_cast<ASTDeclIdentifierSub>(ith)) != 0) {
 			// compute random exponent and add into bag of variables
-			env.variables[exp->getName()] = grp->randomExponent();
+			if (!setFixed(exp->getName()))
+				env.variables[exp->getName()] = grp->randomExponent();
 		} else if ((expRange=dynamic_pointer_cast<ASTDeclIDRange>(ith))!=0){
 			for(int j = expRange->getLBound(); j <= expRange->getUBound(); j++){
-				env.variables[expRange->getName(j)] = grp->randomExponent();
+				if (!setFixed(expRange->getName(j)))
+					env.variables[expRange->getName(j)] = grp->randomExponent();
 			}
 		} else {
 			throw CashException(CashException::CE_PARSE_ERROR,
@@ -36,11 +38,14 @@ void ComputationVisitor::applyASTRandomBnd(ASTRandomBndPtr n){
 		ASTNodePtr ith = l->get(i);
 		if ((rand = dynamic_pointer_cast<ASTDeclIdentifierSub>(ith)) != 0) {
 			// compute random integer and add into bag of variables
-			env.variables[rand->getName()] = RandomBnd(ubound-lbound) + lbound;
+			if (!setFixed(rand->getName()))
+				env.variables[rand->getName()] = RandomBnd(ubound-lbound) + 
+												 lbound;
 		} else if ((randRange=dynamic_pointer_cast<ASTDeclIDRange>(ith)) != 0){
 			for(int j = randRange->getLBound(); j <= randRange->getUBound(); j++){
-				env.variables[randRange->getName(j)] = RandomBnd(ubound-lbound) 
-														+ lbound;
+				if (!setFixed(randRange->getName(j)))
+					env.variables[randRange->getName(j)] = 
+						RandomBnd(ubound-lbound) + lbound;
 			}
 		} else {
 			throw CashException(CashException::CE_PARSE_ERROR,
@@ -59,10 +64,14 @@ void ComputationVisitor::applyASTRandomPrime(ASTRandomPrimePtr n){
 		ASTNodePtr ith = l->get(i);
 		if ((rand = dynamic_pointer_cast<ASTDeclIdentifierSub>(ith)) != 0) {
 			// compute random integer and add into bag of variables
-			env.variables[rand->getName()] = RandomPrime_ZZ(to_long(length));
+			if (!setFixed(rand->getName()))
+				env.variables[rand->getName()] = 
+					RandomPrime_ZZ(to_long(length));
 		} else if ((randRange=dynamic_pointer_cast<ASTDeclIDRange>(ith)) != 0){
 			for(int j = randRange->getLBound(); j <= randRange->getUBound(); j++){
-				env.variables[randRange->getName(j)] = RandomPrime_ZZ(to_long(length));
+				if (!setFixed(randRange->getName(j)))
+					env.variables[randRange->getName(j)] = 
+						RandomPrime_ZZ(to_long(length));
 			}
 		} else {
 			throw CashException(CashException::CE_PARSE_ERROR,
@@ -75,6 +84,8 @@ void ComputationVisitor::applyASTDeclEqual(ASTDeclEqualPtr n){
 
 	ASTDeclIdentifierSubPtr lhs = n->getId();
 	ASTExprPtr rhs = n->getExpr();
+	if (setFixed(lhs->getName()))
+		return;
 	// if the RHS is a multiplication, need to make this an ASTEqual so 
 	// we can call splitExpr and then use multi-exp
 	if (dynamic_pointer_cast<ASTMul>(rhs) != 0) {
@@ -91,6 +102,13 @@ void ComputationVisitor::applyASTDeclEqual(ASTDeclEqualPtr n){
 	}
 }
 
+bool ComputationVisitor::setFixed(const string &name) {
+	if (!fixed || fixed->count(name) == 0)
+		return false;
+	env.variables[name] = fixed->at(name);
+	return true;
+}
+
 void ComputationVisitor::apply(ASTNodePtr n) {
 	n->visit(*this);
 }
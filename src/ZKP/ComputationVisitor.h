@@ -4,6 +4,7 @@
 
 #include "ASTTVisitor.h"
 #include "ASTNode.h"
+#include "Environment.h"
 
 /*! 
  * \brief This visitor carries out the instructions for the computation
@@ -14,7 +15,12 @@ class ComputationVisitor : public ASTTVisitor {
 
 	public:
 		/*! this visitor is used after the user gives us real values */
-		ComputationVisitor(Environment &e) : env(e) {}
+		ComputationVisitor(Environment &e) : env(e), fixed(0) {}
+
+		/*! values named in known are taken from there instead of being
+		 * chosen at random or computed */
+		ComputationVisitor(Environment &e, const variable_map &known)
+			: env(e), fixed(&known) {}
 
 		/*! compute all random values needed */
 		void applyASTDeclRandExponents(ASTDeclRandExponentsPtr n);
@@ -30,7 +36,11 @@ class ComputationVisitor : public ASTTVisitor {
 		void apply(ASTNodePtr n);
 
 	private:
+		/*! if name is in fixed, sets it to that value and returns true */
+		bool setFixed(const string &name);
+
 		Environment &env;
+		const variable_map *fixed;
 };
 
 #endif /*_COMPUTATIONVISITOR_H_*/
@@ -1,6 +1,7 @@
 
 #include "DLRepresentation.h"
 #include "MultiExp.h"
+#include <NTL/Scratch.h>
 #include <assert.h>
 #include "Environment.h"
 #include "Printer.h"
@@ -38,17 +39,19 @@ int DLRepresentation::randIndex(Environment &env) const {
 
 ZZ DLRepresentation::computeValue(Environment &env) const {
 	assert(bases.size() == exps.size());
-	ZZ mod = env.groups.at(group)->getModulus();
-	vector<ZZ> bs, es;
+	const ZZ &mod = env.groups.at(group)->getModulus();
+	ScratchFrame frame;
+	vector<ZZ> &bs = frame.vec(bases.size()), &es = frame.vec(exps.size());
 	vector<string> baseNames;
 	for (unsigned i = 0; i < bases.size(); i++) {
-		ZZ b = bases[i]->eval(env), e = exps[i]->eval(env);
-		bs.push_back(b); 
-		es.push_back(e);
+		bs[i] = bases[i]->eval(env);
+		es[i] = exps[i]->eval(env);
 		baseNames.push_back(bases[i]->toString());
 	}
+	ZZ result;
 	if (bases.size() == 1)
-		return env.modPow(baseNames[0], bs[0], es[0], mod);
+		env.modPow(result, baseNames[0], bs[0], es[0], mod);
 	else
-		return env.multiExp(baseNames, bs, es, mod);
+		env.multiExp(result, baseNames, bs, es, mod);
+	return result;
 }
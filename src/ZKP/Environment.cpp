@@ -1,5 +1,6 @@
 
 #include "Environment.h"
+#include "ProofPlan.h"
 #include "../CommonFunctions.h"
 #include <boost/foreach.hpp>
 
@@ -7,8 +8,7 @@
 //#define EXP_DEBUG 1
 
 std::size_t hash_value(const ZZ& n) {
-	std::ostringstream o; o << n;
-	return boost::hash<std::string>()(o.str());
+	return HashLimbs(n);
 }
 
 void Environment::clear() {
@@ -29,6 +29,7 @@ void Environment::clear() {
 	rangeComs.clear();
 	cache.reset();
 	multiCache.reset();
+	plan.reset();
 }
 
 void Environment::clearPrivates() {
@@ -37,6 +38,12 @@ void Environment::clearPrivates() {
 			variables.erase(p.first);
 }
 
+boost::shared_ptr<const ProofPlan> Environment::getPlan() {
+	if (!plan)
+		plan.reset(new ProofPlan(*this));
+	return plan;
+}
+
 const Group* Environment::getGroup(const string &varName) const { 
 	try {
 		return groups.at(varTypes.at(varName).group); 
@@ -93,37 +100,26 @@ void Environment::addExpression(const string &name, ASTExprPtr expr,
 	privates[name] = isPrivate;
 }
 
-ZZ Environment::modPow(const string &baseName, const ZZ &base, const ZZ &exp, 
-					   const ZZ &mod) const {
+void Environment::modPow(ZZ &r, const string &baseName, const ZZ &base, 
+						 const ZZ &exp, const ZZ &mod) const {
 #ifdef EXP_DEBUG
 	cout << "Environment::modPow called on " << baseName << endl;
 #endif
-	if (cache && cache->contains(baseName)) {		
-		if (exp >= 0)
-			return cache->modPow(baseName, exp, mod);
-		else
-			return PowerMod(base, exp, mod);
-	} else {
-		return PowerMod(base, exp, mod);
-	}
+	// cached tables handle negative exponents with a single inversion
+	if (cache && cache->contains(baseName))
+		cache->modPow(r, baseName, exp, mod);
+	else
+		PowerMod(r, base, exp, mod);
 }
 
-ZZ Environment::multiExp(const vector<string> &baseNames, const vector<ZZ> &bs, 
-						 const vector<ZZ> &es, const ZZ &mod) const {
+void Environment::multiExp(ZZ &r, const vector<string> &baseNames, 
+						   const vector<ZZ> &bs, const vector<ZZ> &es, 
+						   const ZZ &mod) const {
 #ifdef EXP_DEBUG
 	cout << "Environment::multiExp called on " << baseNames.size() << " bases" << endl;
 #endif
-	if (multiCache && multiCache->contains(baseNames)) {
-		bool negative = false;
-		for (unsigned i = 0; i < es.size(); i++) {
-			if (es[i] < 0)
-				negative = true;
-		}
-		if (!negative)
-			return multiCache->modPow(baseNames, bs, es, mod);
-		else
-			return MultiExp(bs, es, mod);
-	} else {
-		return MultiExp(bs, es, mod);
-	}
+	if (multiCache && multiCache->contains(baseNames))
+		multiCache->modPow(r, baseNames, bs, es, mod);
+	else
+		r = MultiExp(bs, es, mod);
 }
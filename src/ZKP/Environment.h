@@ -15,11 +15,16 @@
  #define MAP_TYPE boost::unordered_map
 #endif
 
+// needs MAP_TYPE
+#include "VariableTable.h"
 #include "DLRepresentation.h"
 #include "SigmaProof.h"
 #include "ASTNode.h"
 #include "PowerCache.h"
 #include "MultiExpCache.h"
+#include "SharedMap.h"
+
+class ProofPlan;
 
 /*! \brief This class is just a container */
 
@@ -89,47 +94,53 @@ class Environment {
 
 		static const string NO_GROUP;
 		
-		/*! maps variable names to their actual values */
-		variable_map variables;
+		/*! maps variable names (or slots) to their actual values */
+		VariableTable variables;
 		// XXX: not sure what the best data structure is here...
-		variable_map generators;
+		SharedMap<variable_map> generators;
 		/*! maps group names to the group objects */
 		group_map groups;
 		/*! maps variable names to their associated group and type */
-		variable_type_map varTypes;
+		SharedMap<variable_type_map> varTypes;
 		/*! keeps track of types even for intermediate expressions; needed
 		 * for caching types to use once we call eval at runtime */
-		variable_type_map exprTypes;
+		SharedMap<variable_type_map> exprTypes;
 		/*! maps variable names to their privacy setting */
-		privacy_map privates;
+		SharedMap<privacy_map> privates;
 		/*! maps a variable name to its corresponding commitment */
-		commitment_map commitments;
+		SharedMap<commitment_map> commitments;
 		/*! maps variable to its DLR representation */
-		dlr_map discreteLogs;
+		SharedMap<dlr_map> discreteLogs;
 		/*! maps description name to description object */
-		dlr_map descriptions;
+		SharedMap<dlr_map> descriptions;
 		/*! maps values to the names of their four squares decomposition */
-		decomp_map decompositions;
+		SharedMap<decomp_map> decompositions;
 		decomp_val_map decompCache;
 		/*! list of variables that will need to be created (randomly)
 		 * at runtime */
 		vector<string> randoms;
 		/*! used for remembering form of intermediate expressions */
-		expr_map expressions;
+		SharedMap<expr_map> expressions;
 		/*! used for remembering intermediate commitments */
-		dlr_map comsToCompute;
+		SharedMap<dlr_map> comsToCompute;
 		/*! used for keeping track of range commitments that need to be
 		 * computed by verifier at runtime */
-		dlr_map rangeComs;
+		SharedMap<dlr_map> rangeComs;
 		/*! information for caching powers of known bases */	
 		boost::shared_ptr<PowerCache> cache;
 		boost::shared_ptr<MultiExpCache> multiCache;
+		/*! the compiled relations, see ProofPlan */
+		boost::shared_ptr<const ProofPlan> plan;
 
 		/*! clears out all the maps */
 		void clear();
 
 		void clearPrivates();
 
+		/*! returns plan, building it first if there is none yet (e.g.,
+		 * for an environment that was deserialized rather than compiled) */
+		boost::shared_ptr<const ProofPlan> getPlan();
+
 		/*! gets group object for a given variable */
 		const Group* getGroup(const string &varName) const;
 
@@ -154,18 +165,26 @@ class Environment {
 		void addExpression(const string &name, ASTExprPtr e, VarInfo i, bool p);
 
 		/*! does exponentiation, possibly using cache values */
+		void modPow(ZZ &r, const string &bName, const ZZ &b, const ZZ &e, 
+					const ZZ &mod) const;
 		ZZ modPow(const string &bName, const ZZ &b, const ZZ &e, 
-				  const ZZ &mod) const;
+				  const ZZ &mod) const {
+			ZZ r; modPow(r, bName, b, e, mod); return r;
+		}
 
 		/*! does multiexponentiation */
+		void multiExp(ZZ &r, const vector<string> &bNames, 
+					  const vector<ZZ> &bs, const vector<ZZ> &es, 
+					  const ZZ &mod) const;
 		ZZ multiExp(const vector<string> &bNames, const vector<ZZ> &bs, 
-					const vector<ZZ> &es, const ZZ &mod) const;
+					const vector<ZZ> &es, const ZZ &mod) const {
+			ZZ r; multiExp(r, bNames, bs, es, mod); return r;
+		}
 
 		friend class boost::serialization::access;
 		template <class Archive>
 		void serialize(Archive& ar, const unsigned int ver) {
-			ar	& auto_nvp(NO_GROUP)
-				& auto_nvp(variables)
+			ar	& auto_nvp(variables)
 				& auto_nvp(generators)
 				& auto_nvp(groups)
 				& auto_nvp(varTypes)
@@ -2,41 +2,124 @@
 #include "EqualityProver.h"
 #include <assert.h>
 #include "MultiExp.h"
+#include <NTL/Scratch.h>
+#include "../ThreadPool.h"
+#include <boost/bind.hpp>
 
 variable_map EqualityProver::computeCommitments(bool indicator) {
+	const vector<ProofPlan::Relation> &relations = plan->getRelations();
+
+	// bases come straight from the environment's slots, and so do the
+	// exponents from the commitment opening; the randomized ones are
+	// loaded into a slot vector from this thread's scratch arena, so after
+	// the first proof it already has room for its values
+	plan->requireBases(env.variables);
+	ScratchFrame frame;
+	const vector<ZZ> *exps = &env.variables.values();
+	if(indicator) {
+		// use exponents from commitment opening
+		plan->requireExponents(env.variables);
+	}
+	else {	
+		// use exponents from randomized proof opening
+		vector<ZZ> &rexps = frame.vec(plan->slotCount());
+		plan->loadExponents(rexps, randExps);
+		exps = &rexps;
+	}
+
+	// a prepared relation is only as good as the values it was computed
+	// from, so any relation whose bases or exponents changed since (e.g.,
+	// because they depend on a value that wasn't known then) is computed
+	// again
+	vector<ZZ> results(relations.size());
+	vector<size_t> todo;
+	const var_map *known = 0;
+	if (prepared) {
+		plan->requireExponents(env.variables);
+		known = indicator ? &prepared->commitments : 
+							&prepared->randomizedProofs;
+	}
+	for (unsigned i = 0; i < relations.size(); i++) {
+		const string &name = relations[i].name;
+		var_map::const_iterator it, d;
+		if (known && (it = known->find(name)) != known->end() &&
+			(d = prepared->digests.find(name)) != prepared->digests.end() &&
+			d->second == inputDigest(relations[i]))
+			results[i] = it->second;
+		else
+			todo.push_back(i);
+	}
+
+	// the relations are independent, so with a shared thread pool their
+	// multi-exponentiations are spread over all cores
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	if (pool)
+		pool->parallelFor(todo.size(),
+			boost::bind(&EqualityProver::computeCommitment, this,
+						boost::cref(relations), boost::cref(*exps), 
+						boost::ref(results), boost::cref(todo), _1));
+	else
+		for (unsigned k = 0; k < todo.size(); k++)
+			computeCommitment(relations, *exps, results, todo, k);
 
 	variable_map commitmentValues;
+	for (unsigned i = 0; i < relations.size(); i++)
+		commitmentValues[relations[i].name] = results[i];
+	return commitmentValues;
+}
+
+void EqualityProver::computeCommitment(
+							const vector<ProofPlan::Relation> &relations,
+							const vector<ZZ> &exps, vector<ZZ> &results, 
+							const vector<size_t> &which, size_t k) const {
 	// XXX: do we want to do this for all discrete logs, or just for 
 	// ones that are actually commitments?
-	for (dlr_map::const_iterator it = env.descriptions.begin();
-								 it != env.descriptions.end(); ++it) {
-		DLRepresentation cd = it->second;
-		ZZ mod = env.groups.at(cd.group)->getModulus();
-
-		vector<ZZ> bases;
-		vector<string> baseNames;
-		vector<ZZ> exps;
-		for(unsigned j = 0; j < cd.bases.size(); j++) {
-			// want to add bases and exponents to vectors, then use multi-exp
-			string baseName = cd.bases[j]->toString();
-			string expName = cd.exps[j]->toString();
-
-			baseNames.push_back(baseName);
-			bases.push_back(env.variables.at(baseName));
-			if(indicator) {
-				// use exponents from commitment opening
-				exps.push_back(env.variables.at(expName));
-			}
-			else {	
-				// use exponents from randomized proof opening
-				exps.push_back(randExps.at(expName));
-			}
-		}
-		//ZZ result = MultiExp(basesVector, exponentsVector, mod);
-		ZZ result = env.multiExp(baseNames, bases, exps, mod);
-		commitmentValues[cd.toString()] = result;
+	size_t i = which[k];
+	const ProofPlan::Relation &rel = relations[i];
+	const ZZ &mod = env.groups.at(rel.group)->getModulus();
+	const vector<ZZ> &values = env.variables.values();
+
+	ScratchFrame frame;
+	vector<ZZ> &bs = frame.vec(rel.bases.size());
+	vector<ZZ> &es = frame.vec(rel.bases.size());
+	for(unsigned j = 0; j < rel.bases.size(); j++) {
+		// want to add bases and exponents to vectors, then use multi-exp
+		bs[j] = values[rel.bases[j]];
+		es[j] = exps[rel.exps[j]];
 	}
-	return commitmentValues;
+	ProofPlan::multiExp(results[i], rel, bs, es, mod);
+}
+
+// a value's bytes, prefixed with their number and the value's sign
+static void appendValue(string &s, const ZZ &v) {
+	string bytes = ZZToBytes(v);
+	uint32_t len = bytes.size();
+	s.append((const char*) &len, sizeof(len));
+	s += (sign(v) < 0) ? '-' : '+';
+	s += bytes;
+}
+
+ZZ EqualityProver::inputDigest(const ProofPlan::Relation &rel) const {
+	const vector<ZZ> &values = env.variables.values();
+	string inputs;
+	appendValue(inputs, env.groups.at(rel.group)->getModulus());
+	for (unsigned j = 0; j < rel.bases.size(); j++) {
+		appendValue(inputs, values[rel.bases[j]]);
+		appendValue(inputs, values[rel.exps[j]]);
+	}
+	return ZZFromBytes(Hash::hash(inputs, Hash::SHA256, string(),
+								  Hash::TYPE_PLAIN).str());
+}
+
+PreparedProof EqualityProver::prepare() {
+	PreparedProof p;
+	p.randExps = randExps;
+	p.randomizedProofs = randomizedProofs();
+	p.commitments = getCommitments();
+	const vector<ProofPlan::Relation> &relations = plan->getRelations();
+	for (unsigned i = 0; i < relations.size(); i++)
+		p.digests[relations[i].name] = inputDigest(relations[i]);
+	return p;
 }
 
 variable_map EqualityProver::respond(const ZZ &challenge) {
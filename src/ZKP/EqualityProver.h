@@ -2,7 +2,7 @@
 #ifndef _EQUALITYPROVER_H_
 #define _EQUALITYPROVER_H_
 
-#include "Environment.h"
+#include "ProofPlan.h"
 #include "../SigmaProver.h"
 
 class EqualityProver : public SigmaProver {
@@ -11,10 +11,18 @@ class EqualityProver : public SigmaProver {
 		/*! the constructor takes in an environment for proving, as well
 		 * as the map r containing randomized exponents */
 		EqualityProver(Environment &e, variable_map &r)
-			: env(e), randExps(r) {}
+			: env(e), plan(e.getPlan()), randExps(r), prepared(0) {}
+
+		/*! like the above, but the randomized proofs and commitments of
+		 * relations whose bases and exponents still have the values they
+		 * had for prepare() are taken from p */
+		EqualityProver(Environment &e, variable_map &r, 
+					   const PreparedProof &p)
+			: env(e), plan(e.getPlan()), randExps(r), prepared(&p) {}
 
 		EqualityProver(const EqualityProver &o) 
-			: env(o.env), randExps(o.randExps) {}
+			: env(o.env), plan(o.plan), randExps(o.randExps), 
+			  prepared(o.prepared) {}
 
 		~EqualityProver() {}
 
@@ -24,13 +32,29 @@ class EqualityProver : public SigmaProver {
 
 		variable_map respond(const ZZ &challenge);
 
+		/*! the randomized proofs and commitments of all relations, for
+		 * a later prover with the same random exponents */
+		PreparedProof prepare();
+
 		void sanityCheck();
 
 	private:
 		variable_map computeCommitments(bool indicator);
 
+		/*! computes the commitment (or randomized proof) for relation
+		 * which[k] into results[which[k]], with exponents from the slot
+		 * vector exps; safe to call from several threads at once */
+		void computeCommitment(const vector<ProofPlan::Relation> &relations,
+							   const vector<ZZ> &exps, vector<ZZ> &results,
+							   const vector<size_t> &which, size_t k) const;
+
+		/*! a digest of the values of rel's bases and exponents */
+		ZZ inputDigest(const ProofPlan::Relation &rel) const;
+
 		const Environment &env;
+		boost::shared_ptr<const ProofPlan> plan;
 		variable_map randExps;
+		const PreparedProof *prepared;
 };
 
 #endif /*_EQUALITYPROVER_H_*/
@@ -3,6 +3,9 @@
 #include "ASTNode.h"
 #include <assert.h>
 #include "MultiExp.h"
+#include <NTL/Scratch.h>
+#include "../ThreadPool.h"
+#include <boost/bind.hpp>
 
 #define DEBUG 0
 
@@ -13,41 +16,47 @@ bool EqualityVerifier::canGenerateNewChallenge() const {
 }
 
 bool EqualityVerifier::verify(variable_map &response) {
+	const vector<ProofPlan::Relation> &relations = plan->getRelations();
 
-	for (dlr_map::const_iterator it = env.descriptions.begin(); 
-								 it != env.descriptions.end(); ++it) {
-		DLRepresentation cd = it->second;
-		// Check if  rProof_i * C_i ^ c = SUM(i = 0:n) base_i ^ response_i % mod
-		ZZ mod = env.groups.at(cd.group)->getModulus();
-		ZZ rProofBase = getRandomizedProofs().at(cd.toString());
-
-		ZZ commitmentBase = env.variables.at(cd.left->toString());
-		ZZ rCom = PowerMod(commitmentBase, challenge, mod);
-		ZZ leftSide = MulMod(rProofBase, rCom, mod);
-
-		vector<string> baseNames;
-		vector<ZZ> bases;
-		vector<ZZ> exps;
-		for(unsigned j = 0; j < cd.bases.size(); j++) {		
-			string baseName = cd.bases[j]->toString();
-			baseNames.push_back(baseName);
-			bases.push_back(env.variables.at(baseName));
-			exps.push_back(response.at(cd.exps[j]->toString()));
-		}
-		ZZ rightSide = env.multiExp(baseNames, bases, exps, mod);
-		//ZZ rightSide = MultiExp(bases, exps, mod);
-		if(leftSide != rightSide) {
+	// commitments and bases come straight from the environment's slots;
+	// the responses are loaded into a slot vector (from this thread's
+	// scratch arena, see EqualityProver)
+	plan->requireLefts(env.variables);
+	plan->requireBases(env.variables);
+	ScratchFrame frame;
+	vector<ZZ> &exps = frame.vec(plan->slotCount());
+	plan->loadExponents(exps, response);
+
+	// Check if  rProof_i * C_i ^ c = SUM(i = 0:n) base_i ^ response_i % mod
+	// for every relation; the relations are independent, so with a shared
+	// thread pool both sides are computed on all cores and compared here
+	vector<ZZ> leftSides(relations.size()), rightSides(relations.size());
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	if (pool)
+		pool->parallelFor(relations.size(),
+			boost::bind(&EqualityVerifier::computeSides, this,
+						boost::cref(relations), boost::cref(exps),
+						boost::ref(leftSides), boost::ref(rightSides), _1));
+	else
+		for (unsigned i = 0; i < relations.size(); i++)
+			computeSides(relations, exps, leftSides, rightSides, i);
+
+	for (unsigned i = 0; i < relations.size(); i++) {
+		const ProofPlan::Relation &rel = relations[i];
+		if(leftSides[i] != rightSides[i]) {
 			cout << "******************************************" << endl;
-			cout << "failed to verify: " << endl << cd.toString() << endl;
-			cout << leftSide << endl << " != " << endl << rightSide << endl;
-			cout << "randomized proof is " << rProofBase << endl;
-			cout << "commitment is " << commitmentBase << endl;
+			cout << "failed to verify: " << endl << rel.name << endl;
+			cout << leftSides[i] << endl << " != " << endl 
+				 << rightSides[i] << endl;
+			cout << "randomized proof is " 
+				 << getRandomizedProofs().at(rel.name) << endl;
+			cout << "commitment is " << env.variables.value(rel.left) << endl;
 			cout << "******************************************" << endl;
 			return false;
 		}
 		else {
 #if DEBUG
-			cout << "VERIFIED commitment " << cd.toString() << endl;
+			cout << "VERIFIED commitment " << rel.name << endl;
 #endif
 		}
 
@@ -55,3 +64,27 @@ bool EqualityVerifier::verify(variable_map &response) {
 	// if we got here, all equations were verified!
 	return true;
 }
+
+void EqualityVerifier::computeSides(
+							const vector<ProofPlan::Relation> &relations,
+							const vector<ZZ> &exps,
+							vector<ZZ> &leftSides, vector<ZZ> &rightSides,
+							size_t i) const {
+	const ProofPlan::Relation &rel = relations[i];
+	const ZZ &mod = env.groups.at(rel.group)->getModulus();
+	const ZZ &rProofBase = getRandomizedProofs().at(rel.name);
+	const vector<ZZ> &values = env.variables.values();
+
+	ZZ &leftSide = leftSides[i];
+	PowerMod(leftSide, values[rel.left], challenge, mod);
+	MulMod(leftSide, rProofBase, leftSide, mod);
+
+	ScratchFrame frame;
+	vector<ZZ> &bs = frame.vec(rel.bases.size());
+	vector<ZZ> &es = frame.vec(rel.bases.size());
+	for(unsigned j = 0; j < rel.bases.size(); j++) {		
+		bs[j] = values[rel.bases[j]];
+		es[j] = exps[rel.exps[j]];
+	}
+	ProofPlan::multiExp(rightSides[i], rel, bs, es, mod);
+}
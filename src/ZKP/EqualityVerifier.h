@@ -2,17 +2,17 @@
 #define _EQUALITYVERIFIER_H_
 
 #include "../SigmaVerifier.h"
-#include "Environment.h"
+#include "ProofPlan.h"
 
 class EqualityVerifier : public SigmaVerifier {
 	public:
 		EqualityVerifier(const variable_map &rProofsArg, Environment &e, 
 						 int stat)
-			: SigmaVerifier(rProofsArg, stat), env(e) {}
+			: SigmaVerifier(rProofsArg, stat), env(e), plan(e.getPlan()) {}
 
 		/*! copy constructor */
 		EqualityVerifier(const EqualityVerifier &o) 
-			: SigmaVerifier(o), env(o.env) {}
+			: SigmaVerifier(o), env(o.env), plan(o.plan) {}
 
 		/*! destructor */
 		virtual ~EqualityVerifier() {}
@@ -28,7 +28,16 @@ class EqualityVerifier : public SigmaVerifier {
 		virtual void setChallenge(const ZZ &c) { challenge = c; }
 
 	private:
+		/*! computes both sides of the check for relation i into
+		 * leftSides[i] and rightSides[i], with responses from the slot
+		 * vector exps; safe to call from several threads at once */
+		void computeSides(const vector<ProofPlan::Relation> &relations,
+						  const vector<ZZ> &exps,
+						  vector<ZZ> &leftSides, vector<ZZ> &rightSides,
+						  size_t i) const;
+
 		const Environment &env;
+		boost::shared_ptr<const ProofPlan> plan;
 };
 
 #endif
@@ -1,6 +1,7 @@
 
 #include "Interpreter.h"
 #include <fstream>
+#include <sstream>
 #include "ZKPLexer.hpp"
 #include "ZKPParser.hpp"
 #include "UndefinedVariables.h"
@@ -19,6 +20,8 @@
 #include "InterpreterCache.h"
 #include "Timer.h"
 #include "BindGroupValues.h"
+#include "ProofPlan.h"
+#include "ProgramFile.h"
 
 #define UNUSED 0
 
@@ -26,41 +29,49 @@ using boost::shared_ptr;
 
 void Interpreter::check(const string &programName, input_map inputs,
 						group_map groups) {
+	// read the program, so that the cache notices if it has been edited
+	ifstream file(programName.c_str());
+	if (!file) {
+		throw CashException(CashException::CE_PARSE_ERROR,
+							"Cannot open the specified file");
+	}
+	stringstream text;
+	text << file.rdbuf();
+	compile(text.str(), programName, inputs, groups);
+}
+
+void Interpreter::checkSource(const string &program, input_map inputs,
+							  group_map groups) {
+	compile(program, "program source", inputs, groups);
+}
+
+void Interpreter::compile(const string &program, const string &programName,
+						  input_map &inputs, group_map &groups) {
 	// first check if program has already been compiled, with the same groups
 	// and inputs used
-	cache_key_pair key = hashForCache(programName,inputs,groups);
-	if (InterpreterCache::contains(key)) {
-		CacheValue& val = InterpreterCache::get(key);
+	cache_key_t key = hashForCache(program,inputs,groups);
+	InterpreterCache::entry_ptr val = InterpreterCache::get(key);
+	if (val) {
 		// if it has, just store the values and we're done
-		env = val.env;
-		tree = val.tree;
+		env = val->env;
+		tree = val->tree;
 		env.clearPrivates();
 	} else {
 		// need to start out with a fresh environment for each program
 		env.clear();
 		tree.reset();
 	
-		ifstream stream;
-		stream.open(programName.c_str());
-		if (!stream) {
-			throw CashException(CashException::CE_PARSE_ERROR,
-								"Cannot open the specified file");
-		}
-	
+		// compiled programs come with their tree (and, if they were checked
+		// with these inputs, their environment) already built
 		ASTSpecPtr n;
-		try {
-			shared_ptr<ZKPLexer> lexer(new ZKPLexer(stream));
-			shared_ptr<ZKPParser> parser(new ZKPParser(*lexer));
-			n = parser->spec();
-			tree = n;
-		} catch(antlr::ANTLRException& e) {
-			cout << "Compile error: " << type_to_str(typeid(e)) << ": " 
-				 << e.toString() << endl;
-			throw CashException(CashException::CE_PARSE_ERROR,
-								"Cannot compile %s", programName.c_str());
-		}
+		bool checked = false;
+		if (ProgramFile::isCompiled(program))
+			checked = ProgramFile::load(program, inputs, n, env);
+		else
+			n = parse(program, programName);
+		tree = n;
 	
-		if (n) {
+		if (n && !checked) {
 			ConstantSub sub(inputs);
 			ConstantProp prop(inputs);
 			while(prop.subAgain()||sub.anotherPass()){
@@ -107,7 +118,9 @@ void Interpreter::check(const string &programName, input_map inputs,
 			// finally, need to describe all relations!
 			DescribeRelations describer(env);
 			describer.apply(n);
+		}
 
+		if (n) {
 			// if groups are there, first bind generator values and then cache 
 			// powers for bases that are used multiple times
 			if (!groups.empty()) {
@@ -117,6 +130,9 @@ void Interpreter::check(const string &programName, input_map inputs,
 				binder.apply(n);
 				cachePowers();
 			}
+			// flatten the relations (with any tables just cached) once, so
+			// proving and verifying don't have to
+			env.plan.reset(new ProofPlan(env));
 			// now want to store output in cache so we can load it up
 			// again later if necessary
 			InterpreterCache::store(key, tree, env);
@@ -124,19 +140,36 @@ void Interpreter::check(const string &programName, input_map inputs,
 	}
 }
 
-// XXX let's automatically pick a sane value somehow (just using group
-// order length for 160-bit prime order groups wasn't long enough)
+ASTSpecPtr Interpreter::parse(const string &program, 
+							  const string &programName) {
+	istringstream stream(program);
+	try {
+		shared_ptr<ZKPLexer> lexer(new ZKPLexer(stream));
+		shared_ptr<ZKPParser> parser(new ZKPParser(*lexer));
+		return parser->spec();
+	} catch(antlr::ANTLRException& e) {
+		cout << "Compile error: " << type_to_str(typeid(e)) << ": " 
+			 << e.toString() << endl;
+		throw CashException(CashException::CE_PARSE_ERROR,
+							"Cannot compile %s", programName.c_str());
+	}
+}
+
+// exponent length to precompute for when the group order isn't known
+// (just using group order length for 160-bit prime order groups wasn't
+// long enough, since exponents aren't always reduced); when it is known,
+// PowerCache reduces exponents mod the order instead
 #define POWERCACHE_MAX_EXPLEN 2048
 
 void Interpreter::cachePowers() {
 	env.cache = new_ptr<PowerCache>();
 	env.multiCache = new_ptr<MultiExpCache>();
 
-	for (dlr_map::iterator it = env.descriptions.begin();
+	for (dlr_map::const_iterator it = env.descriptions.begin();
 						   it != env.descriptions.end(); ++it) {
 		vector<string> baseNames;
 		vector<ZZ> baseVals;
-		DLRepresentation rep = it->second;
+		const DLRepresentation &rep = it->second;
 		const Group* g = env.groups.at(rep.group);
 		for (unsigned i = 0; i < rep.bases.size(); i++) {
 			string name = rep.bases[i]->toString();
@@ -147,7 +180,7 @@ void Interpreter::cachePowers() {
 		if (baseNames.size() == baseVals.size()) {
 			if (baseNames.size() == 1)
 				env.cache->store(baseNames[0], baseVals[0], g->getModulus(),
-								 POWERCACHE_MAX_EXPLEN, 5);
+								 POWERCACHE_MAX_EXPLEN, g->getOrder());
 			else {
 				unsigned width=0;
 				switch (baseNames.size()) {
@@ -163,9 +196,10 @@ void Interpreter::cachePowers() {
 	}
 }
 
-cache_key_pair Interpreter::hashForCache(const string &fname, input_map i, 
-										 group_map g) {
-	
+cache_key_t Interpreter::hashForCache(const string &program, 
+									  const input_map &i, const group_map &g) {
+	// the program is length-prefixed and names end in a NUL, so different
+	// programs/groups/inputs can't run together into the same input
 	vector<string> gNames;
 	for (group_map::const_iterator it = g.begin(); it != g.end(); ++it) {
 		gNames.push_back(it->first);
@@ -176,18 +210,17 @@ cache_key_pair Interpreter::hashForCache(const string &fname, input_map i,
 	}
 	sort(gNames.begin(),gNames.end());
 	sort(iNames.begin(),iNames.end());
-	vector<ZZ> hashInput;
+	ostringstream hashInput;
+	hashInput << program.size() << '\n' << program;
 	for (unsigned j = 0; j < gNames.size(); j++) {
-		if (gNames[j] == Environment::NO_GROUP) {
-			hashInput.push_back(to_ZZ(0));
-		} else {
-			hashInput.push_back(g[gNames[j]]->getModulus());
-		}
+		const Group* grp = g.at(gNames[j]);
+		hashInput << "G" << gNames[j] << '\0'
+				  << (grp ? grp->getModulus() : to_ZZ(0)) << '\n';
 	}
 	for (unsigned j = 0; j < iNames.size(); j++) {
-		hashInput.push_back(to_ZZ(i[iNames[j]]));
+		hashInput << "I" << iNames[j] << '\0' << i.at(iNames[j]) << '\n';
 	}
 
-	ZZ h = Hash::hash(hashInput,Hash::SHA1);
-	return make_pair(fname,h);
+	return Hash::hash(hashInput.str(), Hash::SHA256, "", 
+					  Hash::TYPE_PLAIN).str();
 }
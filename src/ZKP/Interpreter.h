@@ -10,7 +10,8 @@
  * \brief This class will interpret instructions given by a program
  */
 
-typedef pair<string,ZZ> cache_key_pair;
+/*! key of a compiled program in the InterpreterCache (a binary digest) */
+typedef string cache_key_t;
 
 class Interpreter {
 
@@ -35,12 +36,33 @@ class Interpreter {
 		void check(const string &programName, group_map &groups)
 					{ check(programName, input_map(), groups); }
 
+		/*! same as check, but compiles the program given as text (e.g.,
+		 * one built by ProgramMaker) instead of reading it from a file */
+		void checkSource(const string &program, input_map inputs,
+						 group_map grps);
+		void checkSource(const string &program, input_map &inputs)
+					{ checkSource(program, inputs, group_map()); }
+
 		Environment getEnvironment() { return env; }
+		ASTNodePtr getTree() { return tree; }
+
+		/*! runs the ANTLR parser on program; programName is only used in
+		 * error messages */
+		static ASTSpecPtr parse(const string &program,
+								const string &programName);
 
 	protected:
 		void cachePowers();
 
-		cache_key_pair hashForCache(const string &fname, input_map i, group_map g);
+		/*! compiles program (or loads it from the InterpreterCache);
+		 * programName is only used in error messages */
+		void compile(const string &program, const string &programName,
+					 input_map &inputs, group_map &groups);
+
+		/*! digest of the program text and of the groups and inputs it is
+		 * compiled with */
+		cache_key_t hashForCache(const string &program, const input_map &i,
+								 const group_map &g);
 
 		/*! used by the prover/verifier to compute any runtime values
 		 * that are needed for the proof but haven't been handed in 
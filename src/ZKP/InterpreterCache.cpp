@@ -0,0 +1,94 @@
+
+#include "InterpreterCache.h"
+
+InterpreterCache::Shard& InterpreterCache::shardFor(const cache_key_t &key) {
+	// keys are digests, so any byte of them is as good as a hash
+	unsigned char b = key.empty() ? 0 : (unsigned char) key[0];
+	return shards[b % SHARDS];
+}
+
+size_t InterpreterCache::shardCapacity() const {
+	size_t c = (capacity.load() + SHARDS - 1) / SHARDS;
+	return c ? c : 1;
+}
+
+void InterpreterCache::evictTo(Shard &s, size_t max) {
+	while (s.entries.size() > max) {
+		// shards are small, so a scan for the oldest entry is cheap next
+		// to the compile that got us here
+		entry_map::iterator oldest = s.entries.begin();
+		for (entry_map::iterator it = s.entries.begin();
+			 it != s.entries.end(); ++it) {
+			if (it->second->used.load() < oldest->second->used.load())
+				oldest = it;
+		}
+		s.entries.erase(oldest);
+		evictions++;
+	}
+}
+
+void InterpreterCache::store(const cache_key_t &key, ASTNodePtr n,
+							 const Environment &env) {
+	InterpreterCache &c = instance();
+	entry_ptr v(new CacheValue(n, env));
+	Shard &s = c.shardFor(key);
+	boost::unique_lock<boost::shared_mutex> l(s.lock);
+	s.entries.erase(key);
+	c.evictTo(s, c.shardCapacity() - 1);
+	s.entries[key] = boost::shared_ptr<Entry>(new Entry(v, ++c.tick));
+}
+
+InterpreterCache::entry_ptr InterpreterCache::get(const cache_key_t &key) {
+	InterpreterCache &c = instance();
+	Shard &s = c.shardFor(key);
+	boost::shared_lock<boost::shared_mutex> l(s.lock);
+	entry_map::const_iterator it = s.entries.find(key);
+	if (it == s.entries.end()) {
+		c.misses++;
+		return entry_ptr();
+	}
+	c.hits++;
+	it->second->used.store(++c.tick);
+	return it->second->value;
+}
+
+bool InterpreterCache::contains(const cache_key_t &key) {
+	Shard &s = instance().shardFor(key);
+	boost::shared_lock<boost::shared_mutex> l(s.lock);
+	return s.entries.count(key) != 0;
+}
+
+void InterpreterCache::setCapacity(size_t entries) {
+	InterpreterCache &c = instance();
+	c.capacity.store(entries);
+	for (unsigned i = 0; i < SHARDS; i++) {
+		Shard &s = c.shards[i];
+		boost::unique_lock<boost::shared_mutex> l(s.lock);
+		c.evictTo(s, c.shardCapacity());
+	}
+}
+
+InterpreterCache::Stats InterpreterCache::stats() {
+	InterpreterCache &c = instance();
+	Stats st;
+	st.hits = c.hits.load();
+	st.misses = c.misses.load();
+	st.evictions = c.evictions.load();
+	st.size = 0;
+	for (unsigned i = 0; i < SHARDS; i++) {
+		boost::shared_lock<boost::shared_mutex> l(c.shards[i].lock);
+		st.size += c.shards[i].entries.size();
+	}
+	return st;
+}
+
+void InterpreterCache::clear() {
+	InterpreterCache &c = instance();
+	for (unsigned i = 0; i < SHARDS; i++) {
+		boost::unique_lock<boost::shared_mutex> l(c.shards[i].lock);
+		c.shards[i].entries.clear();
+	}
+	c.hits = 0;
+	c.misses = 0;
+	c.evictions = 0;
+}
@@ -5,9 +5,12 @@
 #include "ASTNode.h"
 #include "Environment.h"
 #include "Interpreter.h"
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
-/*! 
- * \brief A storage container that keeps previously "compiled" code 
+/*!
+ * \brief A storage container that keeps previously "compiled" code
  * (AST & Environment) for the interpreter to load up again as it wants
  */
 
@@ -22,39 +25,80 @@ struct CacheValue {
 	Environment env;
 };
 
-class InterpreterCache {
+/*! Entries are keyed by Interpreter::hashForCache (a digest of the program
+ * text, groups and inputs), so editing a program on disk gives it a new
+ * key.  Entries never change once stored: get hands out a shared pointer
+ * to one, which stays valid even if it is evicted meanwhile, and copying
+ * its Environment only copies the values (the compiled maps are shared,
+ * see SharedMap).
+ *
+ * The cache is split into shards by key, each with a reader/writer lock,
+ * so lookups from many threads only contend on a shared lock.  When a
+ * shard is full, storing evicts its least recently used entry. */
+class InterpreterCache : private boost::noncopyable {
 
 	public:
+		typedef boost::shared_ptr<const CacheValue> entry_ptr;
+
+		struct Stats {
+			unsigned long hits, misses, evictions;
+			size_t size;
+		};
+
+		static const unsigned SHARDS = 16;
+		static const size_t DEFAULT_CAPACITY = 256;
+
 		static InterpreterCache& instance() {
 			// local static object initialization
-			static InterpreterCache _icache;  
+			static InterpreterCache _icache;
 			return _icache;
 		}
-		
-		typedef boost::unordered_map<cache_key_pair, CacheValue> cache_t;
 
-		// store values in the cache
-		static void store(cache_key_pair key, ASTNodePtr n,
-						  Environment &env) {
-			instance().cache[key] = CacheValue(n, env);
-		}
+		/*! stores a compiled program (replacing any entry for key) */
+		static void store(const cache_key_t &key, ASTNodePtr n,
+						  const Environment &env);
 
-		static bool contains(cache_key_pair key) {
-			return instance().cache.count(key) != 0;
-		}
+		/*! the entry for key, or an empty pointer (counts a hit or miss) */
+		static entry_ptr get(const cache_key_t &key);
+
+		static bool contains(const cache_key_t &key);
+
+		/*! sets the maximum number of entries, evicting if needed */
+		static void setCapacity(size_t entries);
+
+		static Stats stats();
+
+		/*! drops all entries and resets the counters */
+		static void clear();
 
-		static CacheValue& get(cache_key_pair key) {
-			return instance().cache.at(key);
-		}
-		
 	private:
-		cache_t cache;
-	
-		InterpreterCache() {} // constructor (ctor) is hidden
-		InterpreterCache( InterpreterCache const & );  // copy ctor is hidden
-		// assignment operator is hidden
-		InterpreterCache& operator=( InterpreterCache const & );  
-		~InterpreterCache() {}  // destructor (dtor) is hidden
+		struct Entry {
+			Entry(const entry_ptr &v, unsigned long t) : value(v), used(t) {}
+			entry_ptr value;
+			boost::atomic<unsigned long> used; // tick of the last lookup
+		};
+		typedef boost::unordered_map<cache_key_t, boost::shared_ptr<Entry> >
+			entry_map;
+
+		struct Shard {
+			boost::shared_mutex lock;
+			entry_map entries;
+		};
+
+		InterpreterCache() : capacity(DEFAULT_CAPACITY), tick(0),
+							 hits(0), misses(0), evictions(0) {}
+		~InterpreterCache() {}
+
+		Shard& shardFor(const cache_key_t &key);
+		size_t shardCapacity() const;
+		/*! evicts least recently used entries from s (which must be
+		 * locked) until it has at most max */
+		void evictTo(Shard &s, size_t max);
+
+		Shard shards[SHARDS];
+		boost::atomic<size_t> capacity;
+		boost::atomic<unsigned long> tick;
+		boost::atomic<unsigned long> hits, misses, evictions;
 };
 
 #endif /*_INTERPRETERCACHE_H_*/
@@ -1,6 +1,7 @@
 
 #include "InterpreterProver.h"
 #include "EqualityProver.h"
+#include "ProofPlan.h"
 #include "BindGroupValues.h"
 #include "ComputationVisitor.h"
 #include "../CommonFunctions.h"
@@ -10,19 +11,23 @@
 
 variable_map InterpreterProver::getPublicVariables() {
 	variable_map publics;
-	for (variable_map::const_iterator it = env.variables.begin(); 
-								it != env.variables.end(); ++it) {
+	const VariableTable &vars = env.variables;
+	for (unsigned s = 0; s < vars.slotCount(); s++) {
+		if (!vars.has(s))
+			continue;
 		// put anything that is public in the map, except generators
-		if (env.privates.count(it->first) &&
-			env.privates.at(it->first) == false && 
-			env.generators.count(it->first) == 0) {
-			publics[it->first] = it->second;
+		const string &name = vars.name(s);
+		if (env.privates.count(name) &&
+			env.privates.at(name) == false && 
+			env.generators.count(name) == 0) {
+			publics[name] = vars.value(s);
 		}
 	}
 	return publics;
 }
 
-void InterpreterProver::compute(variable_map &vars, group_map grps) {
+void InterpreterProver::compute(variable_map &vars, 
+								const variable_map &known, group_map grps) {
 	if (!grps.empty()) {
 		// add group information if this wasn't done at compile time
 		env.groups = grps;
@@ -36,15 +41,16 @@ void InterpreterProver::compute(variable_map &vars, group_map grps) {
 		env.variables[it->first] = it->second;
 	}
 	// compute all values in compute block
-	ComputationVisitor computer(env);
+	ComputationVisitor computer(env, known);
 	// replace environment with the one from this visitor
 	computer.apply(tree);
 	// compute intermediate expressions and commitments
-	computeIntermediateValues();
+	computeIntermediateValues(known);
 #if DUMP_VARS
-	for (variable_map::iterator it = env.variables.begin();
-								it != env.variables.end(); ++it) {
-		cout << it->first << " = " << it->second << endl;
+	for (unsigned s = 0; s < env.variables.slotCount(); s++) {
+		if (env.variables.has(s))
+			cout << env.variables.name(s) << " = " 
+				 << env.variables.value(s) << endl;
 	}
 	for (group_map::iterator it = env.groups.begin();
 							 it != env.groups.end(); ++it) {
@@ -59,7 +65,7 @@ void InterpreterProver::compute(variable_map &vars, group_map grps) {
 }
 
 void InterpreterProver::decompose() {
-	for (decomp_map::iterator it = env.decompositions.begin();
+	for (decomp_map::const_iterator it = env.decompositions.begin();
 							  it != env.decompositions.end(); ++it) {
 		// get value of exponent, but it's possible that value isn't there 
 		// yet (intermediate expressions haven't been evaluated)
@@ -83,31 +89,38 @@ void InterpreterProver::decompose() {
 	}
 }
 
-void InterpreterProver::formRandomExponents() {
+void InterpreterProver::formRandomExponents(const variable_map &known) {
 	for (unsigned i = 0; i < env.randoms.size(); i++) {
+		if (known.count(env.randoms[i])) {
+			env.variables[env.randoms[i]] = known.at(env.randoms[i]);
+			continue;
+		}
 		const Group* grp = env.getGroup(env.randoms[i]);
 		ZZ val = grp->randomExponent();
 		env.variables[env.randoms[i]] = val;
 	}
 }
 
-void InterpreterProver::computeIntermediateValues() {
+void InterpreterProver::computeIntermediateValues(const variable_map &known) {
 	// first just do random variables (independent of others)
-	formRandomExponents();
+	formRandomExponents(known);
 	// now decompose anything that needs it
 	decompose();
 	// next, compute intermediate expressions (that haven't been computed
 	// in decompose)
-	for (expr_map::iterator it = env.expressions.begin();
+	for (expr_map::const_iterator it = env.expressions.begin();
 							it != env.expressions.end(); ++it) {
 		if (env.variables.count(it->first) == 0)
 			env.variables[it->first] = it->second->eval(env);
 	}
 	// important that intermediate expressions are done before commitments,
 	// as some will probably be used in the commitments
-	for (dlr_map::iterator it = env.comsToCompute.begin();
+	for (dlr_map::const_iterator it = env.comsToCompute.begin();
 						   it != env.comsToCompute.end(); ++it) {
-		env.variables[it->first] = it->second.computeValue(env);
+		if (known.count(it->first))
+			env.variables[it->first] = known.at(it->first);
+		else
+			env.variables[it->first] = it->second.computeValue(env);
 	}
 	// clear all the maps 
 	env.randoms.clear();
@@ -143,11 +156,13 @@ variable_map InterpreterProver::makeRandomizedExponents() {
 
 	// now go through every exponent that will be used and make a
 	// corresponding random exponent
-	for (dlr_map::iterator it = env.descriptions.begin();
-						   it != env.descriptions.end(); ++it) {
-		DLRepresentation dlr = it->second;
-		for (unsigned i = 0; i < dlr.exps.size(); i++) {
-			ret[dlr.exps[i]->toString()] = groupForRandomness->randomExponent();
+	boost::shared_ptr<const ProofPlan> plan = env.getPlan();
+	const vector<ProofPlan::Relation> &relations = plan->getRelations();
+	for (unsigned i = 0; i < relations.size(); i++) {
+		const vector<unsigned> &exps = relations[i].exps;
+		for (unsigned j = 0; j < exps.size(); j++) {
+			ret[env.variables.name(exps[j])] = 
+				groupForRandomness->randomExponent();
 		}		
 	}
 	return ret;
@@ -158,3 +173,16 @@ SigmaProof InterpreterProver::computeProof(const hashalg_t &hashAlg) {
 	EqualityProver eq(env, randExps);
 	return eq.getSigmaProof(hashAlg);
 }
+
+PreparedProof InterpreterProver::prepareProof() {
+	variable_map randExps = makeRandomizedExponents();
+	EqualityProver eq(env, randExps);
+	return eq.prepare();
+}
+
+SigmaProof InterpreterProver::computeProof(const hashalg_t &hashAlg,
+										   const PreparedProof &prepared) {
+	variable_map randExps = prepared.randExps;
+	EqualityProver eq(env, randExps, prepared);
+	return eq.getSigmaProof(hashAlg);
+}
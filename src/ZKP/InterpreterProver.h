@@ -20,7 +20,15 @@ class InterpreterProver : public Interpreter {
 	
 		/*! this will run all the visitors that need to be run
 		 * AFTER we have actual values */
-		void compute(variable_map &v, group_map g = group_map());
+		void compute(variable_map &v, group_map g = group_map())
+						{ compute(v, variable_map(), g); }
+
+		/*! like compute, but the values of the computation block (random
+		 * or computed) and the commitments that are named in known take
+		 * the values given there, so a prover can compute some values
+		 * ahead of time and get the same ones again */
+		void compute(variable_map &v, const variable_map &known,
+					 group_map g = group_map());
 
 		/*! returns all public variables (includes bases as well as
 		 * commitments) */
@@ -30,17 +38,34 @@ class InterpreterProver : public Interpreter {
 		 * proof of the validity of the program given to check */
 		SigmaProof computeProof(const hashalg_t &hashAlg);
 
+		/*! to be called after running check and compute: chooses the
+		 * random exponents of a proof and computes the prover's first
+		 * messages, so that a later computeProof only has to compute them
+		 * for relations whose values have changed since (e.g., ones that
+		 * depend on an input that wasn't known yet) */
+		PreparedProof prepareProof();
+
+		/*! like computeProof, but starting from prepared */
+		SigmaProof computeProof(const hashalg_t &hashAlg, 
+								const PreparedProof &prepared);
+
 	private:
 		/*! this decomposes key values in decomposition maps into their
 		 * four squares representation, then assigns values appropriately */
 		void decompose();
 
-		/*! this forms random exponents for the variables in randoms */
-		void formRandomExponents();
+		/*! this forms random exponents for the variables in randoms,
+		 * except those in known */
+		void formRandomExponents(const variable_map &known);
 
 		/*! this computes all values in the expressions and comsToCompute
 		 * maps in the environment */
-		void computeIntermediateValues();
+		void computeIntermediateValues() 
+						{ computeIntermediateValues(variable_map()); }
+
+		/*! like computeIntermediateValues, but takes the values in known
+		 * from there */
+		void computeIntermediateValues(const variable_map &known);
 
 		/*! for each exponent, creates a random exponent to be used by
 		 * equality prover */
@@ -1,7 +1,13 @@
 
 #include "InterpreterVerifier.h"
 #include "EqualityVerifier.h"
+#include "ProofPlan.h"
 #include "BindGroupValues.h"
+#include "MultiExp.h"
+#include "../GroupPrime.h"
+#include "../ThreadPool.h"
+#include <boost/bind.hpp>
+#include <stdexcept>
 
 void InterpreterVerifier::compute(variable_map &v, const variable_map &p, 
 								  const variable_map &p2, group_map g) {
@@ -48,16 +54,237 @@ bool InterpreterVerifier::verify(const SigmaProof &proof, int stat) {
 	}
 }
 
+// one base and exponent in a batch verification product; exponents are
+// kept reduced mod the group's order
+struct batch_term {
+	batch_term(unsigned g, const ZZ &b, const ZZ &e, bool s) 
+		: group(g), base(b), exp(e), statement(s) {}
+	unsigned group;
+	ZZ base, exp;
+	// part of what is proved (a base or a left-hand side), rather than
+	// the prover's commitment: has to be checked to be in the group
+	bool statement;
+};
+
+vector<bool> InterpreterVerifier::verifyBatch(const variable_map &v, 
+											  const vector<ProofMessage> &msgs,
+											  int stat, group_map g) {
+	return verifyBatch(v, vector<variable_map>(msgs.size()), msgs, stat, g);
+}
+
+// the verifier's inputs for one proof of a batch
+static variable_map batchInputs(const variable_map &v, 
+								const vector<variable_map> &perProof,
+								unsigned i) {
+	variable_map inputs = v;
+	for (variable_map::const_iterator it = perProof[i].begin();
+									  it != perProof[i].end(); ++it) {
+		inputs[it->first] = it->second;
+	}
+	return inputs;
+}
+
+// one distinct statement element of a batch, and whether it is in its group
+struct batch_member {
+	batch_member(const GroupPrime *g, const ZZ &v) : group(g), value(v) {}
+	const GroupPrime *group;
+	ZZ value;
+	char in;
+};
+
+static void checkMember(vector<batch_member> *members, size_t i) {
+	batch_member &m = (*members)[i];
+	m.in = m.group->isElement(m.value);
+}
+
+vector<bool> InterpreterVerifier::verifyBatch(const variable_map &v, 
+										const vector<variable_map> &perProof,
+										const vector<ProofMessage> &msgs,
+										int stat, group_map g) {
+	assert(perProof.size() == msgs.size());
+	vector<bool> results(msgs.size(), true);
+	// (the plan gives names slots, so get it before saving the environment)
+	boost::shared_ptr<const ProofPlan> plan = env.getPlan();
+	const vector<ProofPlan::Relation> &relations = plan->getRelations();
+	Environment checked = env;
+
+	// the random exponents only work in a group of known prime order, so
+	// every relation has to be in a GroupPrime; otherwise (e.g. in an RSA
+	// group) each proof is just verified on its own
+	const group_map &groups = g.empty() ? checked.groups : g;
+	vector<const GroupPrime*> moduli;
+	vector<unsigned> relGroup(relations.size());
+	bool canBatch = true;
+	for (unsigned r = 0; r < relations.size() && canBatch; r++) {
+		group_map::const_iterator it = groups.find(relations[r].group);
+		const GroupPrime *prime = it == groups.end() ? NULL :
+			dynamic_cast<const GroupPrime*>(it->second);
+		canBatch = (prime != NULL && prime->getOrder() > 1);
+		unsigned k = 0;
+		while (canBatch && k < moduli.size() && 
+			   moduli[k]->getModulus() != prime->getModulus())
+			k++;
+		if (canBatch && k == moduli.size())
+			moduli.push_back(prime);
+		relGroup[r] = k;
+	}
+	if (!canBatch) {
+		for (unsigned i = 0; i < msgs.size(); i++) {
+			env = checked;
+			variable_map inputs = batchInputs(v, perProof, i);
+			compute(inputs, msgs[i].proof.getCommitments(), msgs[i].publics, g);
+			results[i] = verify(msgs[i].proof, stat);
+		}
+		env = checked;
+		return results;
+	}
+
+	// collect every proof's terms: rProof * C^c = prod base_j^response_j
+	// becomes prod base_j^(d*response_j) * rProof^-d * C^(-d*c) = 1
+	vector<ZZ> responses;
+	vector<vector<batch_term> > terms(msgs.size());
+	for (unsigned i = 0; i < msgs.size(); i++) {
+		env = checked;
+		variable_map inputs = batchInputs(v, perProof, i);
+		const SigmaProof &proof = msgs[i].proof;
+		try {
+			compute(inputs, proof.getCommitments(), msgs[i].publics, g);
+			if (badComs) {
+				results[i] = false;
+				continue;
+			}
+			ZZ c = proof.computeChallenge();
+			const variable_map &rProofs = proof.getRandomizedProofs();
+			const vector<ZZ> &values = env.variables.values();
+			try {
+				plan->requireLefts(env.variables);
+				plan->requireBases(env.variables);
+				plan->loadExponents(responses, proof.getResponses());
+			} catch (CashException &e) {
+				// missing values: verify() would throw, so this one is bad
+				results[i] = false;
+				continue;
+			}
+			for (unsigned r = 0; r < relations.size(); r++) {
+				const ProofPlan::Relation &rel = relations[r];
+				unsigned k = relGroup[r];
+				const ZZ &q = moduli[k]->getOrder();
+				ZZ d = RandomBits_ZZ(stat) + 1, e;
+				for (unsigned j = 0; j < rel.bases.size(); j++) {
+					mpz_mul(MPZ(e), MPZ(d), MPZ(responses[rel.exps[j]]));
+					mpz_mod(MPZ(e), MPZ(e), MPZ(q));
+					terms[i].push_back(batch_term(k, values[rel.bases[j]], e, 
+												  true));
+				}
+				terms[i].push_back(batch_term(k, rProofs.at(rel.name), q - d,
+											  false));
+				mpz_mul(MPZ(e), MPZ(d), MPZ(c));
+				mpz_neg(MPZ(e), MPZ(e));
+				mpz_mod(MPZ(e), MPZ(e), MPZ(q));
+				terms[i].push_back(batch_term(k, values[rel.left], e, true));
+			}
+		} catch (std::out_of_range &e) {
+			// missing values: verify() would throw, so this one is bad
+			results[i] = false;
+			terms[i].clear();
+		}
+	}
+
+	// the exponents are only random mod the order, so a statement element
+	// with a part outside the group (e.g. -1, of order 2) could cancel out
+	// against another one's.  Each distinct one is checked (x^q == 1) once,
+	// on the shared ThreadPool if there is one, and a proof with one that
+	// isn't in its group is bad.  The prover's commitments aren't checked:
+	// if everything else is in the group, the product being 1 means every
+	// equation holds in the group's part of each commitment, and that is
+	// all a sigma proof needs (any other part only rides along in the
+	// hash for the challenge).  So the batch may accept a proof that
+	// verify() rejects only for a commitment outside the group, and no
+	// proof of a false statement gets through, but with probability about
+	// 2^-stat.  The checks cost an exponentiation by the order, about
+	// half of the length of a response, per element rather than per base
+	// and relation.
+	vector<boost::unordered_map<ZZ, unsigned> > memberIndex(moduli.size());
+	vector<batch_member> members;
+	for (unsigned i = 0; i < msgs.size(); i++) {
+		for (unsigned t = 0; t < terms[i].size(); t++) {
+			const batch_term &term = terms[i][t];
+			if (term.statement &&
+				memberIndex[term.group].insert(make_pair(term.base, 
+						members.size())).second)
+				members.push_back(batch_member(moduli[term.group], term.base));
+		}
+	}
+	boost::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+	if (pool)
+		pool->parallelFor(members.size(), 
+						  boost::bind(checkMember, &members, _1));
+	else
+		for (unsigned m = 0; m < members.size(); m++)
+			checkMember(&members, m);
+
+	// terms of the product that should be 1, per group; equal bases 
+	// (generators, mostly) share a single term
+	vector<vector<ZZ> > bases(moduli.size()), exps(moduli.size());
+	vector<boost::unordered_map<ZZ, unsigned> > termIndex(moduli.size());
+	for (unsigned i = 0; i < msgs.size(); i++) {
+		for (unsigned t = 0; t < terms[i].size() && results[i]; t++) {
+			const batch_term &term = terms[i][t];
+			if (term.statement)
+				results[i] = members[memberIndex[term.group][term.base]].in;
+		}
+		for (unsigned t = 0; t < terms[i].size() && results[i]; t++) {
+			const batch_term &term = terms[i][t];
+			unsigned k = term.group;
+			boost::unordered_map<ZZ, unsigned>::iterator f = 
+				termIndex[k].find(term.base);
+			if (f == termIndex[k].end()) {
+				termIndex[k][term.base] = bases[k].size();
+				bases[k].push_back(term.base);
+				exps[k].push_back(term.exp);
+			} else {
+				exps[k][f->second] += term.exp;
+			}
+		}
+	}
+
+	// most bases are one-off values, so don't cache them; with many bases
+	// this ends up in Pippenger's method
+	bool batchOK = true;
+	ZZ product;
+	for (unsigned k = 0; k < moduli.size() && batchOK; k++) {
+		const ZZ &q = moduli[k]->getOrder();
+		for (unsigned j = 0; j < exps[k].size(); j++)
+			mpz_mod(MPZ(exps[k][j]), MPZ(exps[k][j]), MPZ(q));
+		MultiExpAuto(product, bases[k], exps[k], moduli[k]->getModulus());
+		batchOK = (product == 1);
+	}
+
+	// if the product isn't 1, find the bad proofs one by one
+	if (!batchOK) {
+		for (unsigned i = 0; i < msgs.size(); i++) {
+			if (!results[i])
+				continue;
+			env = checked;
+			variable_map inputs = batchInputs(v, perProof, i);
+			compute(inputs, msgs[i].proof.getCommitments(), msgs[i].publics, g);
+			results[i] = verify(msgs[i].proof, stat);
+		}
+	}
+	env = checked;
+	return results;
+}
+
 void InterpreterVerifier::computeIntermediateValues() {
 	// form range commitments
-	for (dlr_map::iterator it = env.rangeComs.begin();
+	for (dlr_map::const_iterator it = env.rangeComs.begin();
 						   it != env.rangeComs.end(); ++it) {
 		env.variables[it->first] = it->second.computeValue(env);
 	}
 	// for any decompositions, want to check that c_x = product over c_xi2, so
 	// that x = x_1^2 + x_2^2 + x_3^2 + x_4^2
 	badComs = false;
-	for (decomp_map::iterator it = env.decompositions.begin();
+	for (decomp_map::const_iterator it = env.decompositions.begin();
 							  it != env.decompositions.end(); ++it) {
 		ZZ squareProd = to_ZZ(1);
 		vector<DecompNames> fourNames = it->second;
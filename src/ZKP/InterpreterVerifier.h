@@ -32,6 +32,39 @@ class InterpreterVerifier : public Interpreter {
 		 * the proof is valid or not */
 		bool verify(const SigmaProof &proof, int stat);
 
+		/*! verifies many proofs of the already-checked program at once:
+		 * v (and g, if given) are the verifier's inputs for every proof,
+		 * and each message gives a prover's publics and proof, just as
+		 * for compute() followed by verify().
+		 * All relations of all proofs are folded into one
+		 * multi-exponentiation per group, each raised to a random
+		 * stat-bit exponent, so a bad proof slips through with
+		 * probability about 2^-stat.  That needs every relation to be in
+		 * a GroupPrime (a group of known prime order, such as the cash
+		 * group), and every base and left-hand side to be in its group,
+		 * so each distinct one is checked once (an exponentiation by the
+		 * order, see GroupPrime::isElement) and a proof with one that
+		 * isn't is bad.  The prover's commitments aren't checked, so a
+		 * proof whose commitment has a factor outside the group (which
+		 * verify() rejects, but which still proves its statement) may
+		 * pass.  If some relation is in another group, e.g. an RSA
+		 * group, every proof is verified on its own.
+		 * If the product isn't 1, the proofs are verified one by one to
+		 * find the bad ones.
+		 * Returns one result per message; afterwards the environment is
+		 * as it was after check(). */
+		vector<bool> verifyBatch(const variable_map &v, 
+								 const vector<ProofMessage> &msgs, int stat,
+								 group_map g = group_map());
+
+		/*! as above, but perProof[i] holds verifier inputs that only
+		 * apply to msgs[i] (on top of v); like v, they take precedence
+		 * over anything the prover sends */
+		vector<bool> verifyBatch(const variable_map &v,
+								 const vector<variable_map> &perProof,
+								 const vector<ProofMessage> &msgs, int stat,
+								 group_map g = group_map());
+
 	private:
 		/*! this computes all the commitment values in the rangeComs map */
 		void computeIntermediateValues();
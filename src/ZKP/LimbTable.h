@@ -0,0 +1,86 @@
+#ifndef _LIMBTABLE_H_
+#define _LIMBTABLE_H_
+
+#include <NTL/ZZ.h>
+#include <vector>
+#include <string.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+NTL_CLIENT
+
+/*! \brief A rows x cols table of non-negative numbers below a fixed
+ * modulus, stored as one flat array of limbs (each entry zero-padded to
+ * the size of the modulus).  The exponentiation tables keep their
+ * entries in Montgomery form, see MontgomeryContext.
+ *
+ * The limbs either live in the table itself or in memory owned by
+ * someone else (an mmap'ed table file, see TableFile), in which case the
+ * table just keeps the owner alive.  Either way, entries are read in
+ * place through read-only mpz views, without copying.
+ */
+class LimbTable : private boost::noncopyable {
+	public:
+		LimbTable() : rows(0), cols(0), limbs(0), data(0) {}
+
+		/*! allocates zeroed storage for entries modulo mod */
+		void allocate(unsigned r, unsigned c, const ZZ &mod) {
+			rows = r;
+			cols = c;
+			limbs = mpz_size(MPZ(mod));
+			storage.assign(size_t(rows) * cols * limbs, 0);
+			data = storage.empty() ? 0 : &storage[0];
+			owner.reset();
+		}
+
+		/*! uses limbs owned by o (which must stay unchanged) */
+		void attach(unsigned r, unsigned c, unsigned l, const mp_limb_t *d,
+					const boost::shared_ptr<const void> &o) {
+			rows = r;
+			cols = c;
+			limbs = l;
+			storage.clear();
+			data = d;
+			owner = o;
+		}
+
+		void set(unsigned row, unsigned col, const ZZ &v) {
+			assert(!owner && sign(v) >= 0);
+			size_t n = mpz_size(MPZ(v));
+			assert(n <= limbs);
+			mp_limb_t *e = &storage[offset(row, col)];
+			if (n)
+				memcpy(e, mpz_limbs_read(MPZ(v)), n * sizeof(mp_limb_t));
+			memset(e + n, 0, (limbs - n) * sizeof(mp_limb_t));
+		}
+
+		/*! makes view a read-only alias of an entry; it must not be
+		 * modified or cleared, and is valid as long as the table is */
+		mpz_srcptr get(mpz_t view, unsigned row, unsigned col) const {
+			return mpz_roinit_n(view, data + offset(row, col), limbs);
+		}
+
+		/*! the entry's limbs (exactly getLimbs() of them) */
+		const mp_limb_t* entry(unsigned row, unsigned col) const {
+			return data + offset(row, col);
+		}
+
+		unsigned getRows() const { return rows; }
+		unsigned getCols() const { return cols; }
+		unsigned getLimbs() const { return limbs; }
+		const mp_limb_t* getData() const { return data; }
+		size_t sizeInLimbs() const { return size_t(rows) * cols * limbs; }
+
+	private:
+		size_t offset(unsigned row, unsigned col) const {
+			assert(row < rows && col < cols);
+			return (size_t(row) * cols + col) * limbs;
+		}
+
+		unsigned rows, cols, limbs;
+		const mp_limb_t *data;
+		vector<mp_limb_t> storage;
+		boost::shared_ptr<const void> owner;
+};
+
+#endif /*_LIMBTABLE_H_*/
@@ -5,33 +5,38 @@
 //#define MEXP_DEBUG 1
 
 #include <NTL/ZZ.h>
+#include <NTL/Montgomery.h>
+#include <NTL/Scratch.h>
 #include <vector>
 #include <boost/unordered_map.hpp>
 #include "../MultiExp.h"
+#include "TableRegistry.h"
+#include "LimbTable.h"
 #ifdef MEXP_DEBUG
 #include <boost/algorithm/string/join.hpp>
 #endif
 
-typedef vector<vector<ZZ> > table_t;
-
 struct multiexp_table {
 	multiexp_table() : blen(0), width(0), mod(0) {}
 	unsigned blen;  // number of bases
 	unsigned width;     // each iteration scan this many exponent bits
 	ZZ mod; // for safety let's keep this around
 
+	MontgomeryContext mont; // table entries are in Montgomery form
+
 	// table is a 2-D array of rows, tables
 	// 1st dimension (rows):   size maxexplen/width+1
 	//   1 row for each W-bit-wide window of exponent bits (0..3, 4..7, etc)
 	// 2nd dimension (tables): size 2^(bases*width)
 	//   each table entry stores f^x * g^y * h^z for x,y,z from scanned bits
-	table_t table;
+	LimbTable table;
 
 	void precomp(const vector<ZZ>& bases, const ZZ& mod, 
 				 unsigned width, unsigned maxlen) {
 		this->mod = mod;
 		this->width = width;
 		this->blen = bases.size();
+		mont.init(mod);
 		// precompute G_i for scanning N cols at a time
 		// (e.g., 3 bases, width=2: tabsz is 64; width=4, tabsz is 4096)
 		unsigned tabsz = 1 << (width * blen);
@@ -43,7 +48,7 @@ struct multiexp_table {
 			 << " * #bits(mod) " << NumBits(mod) << " = " 
 			 << tabsz*rows*((NumBits(mod)+7)/8) << " bytes" << endl;
 #endif
-		table = table_t(rows);
+		table.allocate(rows, tabsz, mod);
 
 		// build bitmask (i.e. 000011 for width=2)
 		unsigned bitmask = 0;
@@ -52,41 +57,58 @@ struct multiexp_table {
 			bitmask |= 1 << i;
 
 		// build first table
-		table[0] = vector<ZZ>(tabsz);
+		vector<ZZ> cur(tabsz);
 		// compute f^x g^y h^z for each xyz where |x|=|y|=|z|=width
 		for (unsigned i=0; i < tabsz; i++) {
-			table[0][i] = 1;
+			cur[i] = 1;
 			for (unsigned j=0; j < blen; j++) {
 				// bpow is the current considered W-bit digit for this base
 				unsigned bpow = (i & (bitmask << (width*j))) >> (width*j);
-				MulMod(table[0][i], table[0][i], 
-					   PowerMod(bases[j], bpow, mod), mod);
+				MulMod(cur[i], cur[i], PowerMod(bases[j], bpow, mod), mod);
 			}
+			table.set(0, i, mont.toMont(cur[i]));
 		}
 
 		// build remaining tables for higher bits
 		// (same as first table, each cell raised to 2^width)
 		unsigned sqrstep = 1 << width;
 		for (unsigned row = 1; row < rows; row++) {
-			table[row] = vector<ZZ>(tabsz);
 #ifdef MEXP_DEBUG
 			cout << "." << flush;
 #endif
-			for (unsigned i=0; i < tabsz; i++)
-				PowerMod(table[row][i], table[row-1][i], sqrstep, mod);
+			for (unsigned i=0; i < tabsz; i++) {
+				PowerMod(cur[i], cur[i], sqrstep, mod);
+				table.set(row, i, mont.toMont(cur[i]));
+			}
 		}
 #ifdef MEXP_DEBUG
 		cout << endl;
 #endif
 	}
 
+	// Montgomery-form product for the multiexp_N loops
+	struct accumulator {
+		accumulator(const MontgomeryContext &M)
+			: M(M), buf(frame.limbs(M.size() + M.scratchSize())) {
+			memcpy(buf, M.one(), M.size() * sizeof(mp_limb_t));
+		}
+		void mul(const mp_limb_t *x) {
+			M.mul(buf, buf, x, buf + M.size());
+		}
+		void result(ZZ &A) { M.fromMont(A, buf, buf + M.size()); }
+
+		const MontgomeryContext &M;
+		ScratchFrame frame;
+		mp_limb_t *buf;
+	};
+
 	void multiexp_2(ZZ &A, const ZZ& e0, const ZZ& e1, const ZZ& m) const {
 		assert(blen == 2);
 		assert(m == mod); // XXX don't need mod
 		unsigned t = max(NumBits(e0), NumBits(e1));
-		assert( ((t+width-1)/width) <= table.size()); // enough rows
+		assert( ((t+width-1)/width) <= table.getRows()); // enough rows
 		
-		A = 1;
+		accumulator acc(mont);
 		for (unsigned i=0, row=0; i < t; i+=width, row++) {
 			unsigned short expcol = 0;
 			// e.g. for width=2, OR bits (f[0]->0, g[0]->2) 
@@ -97,8 +119,9 @@ struct multiexp_table {
 					(bit(e0, i+j) << (j));
 			
 			if (expcol)	// A <- A * G_Ii
-				MulMod(A, A, table[row][expcol], m);
+				acc.mul(table.entry(row, expcol));
 		}
+		acc.result(A);
 	}
 
 	void multiexp_3(ZZ &A, const ZZ& e0, const ZZ& e1, const ZZ& e2, 
@@ -106,9 +129,9 @@ struct multiexp_table {
 		assert(blen == 3);
 		assert(m == mod); // XXX don't need mod
 		unsigned t = max( max(NumBits(e0), NumBits(e1)), NumBits(e2));
-		assert( ((t+width-1)/width) <= table.size()); // enough rows
+		assert( ((t+width-1)/width) <= table.getRows()); // enough rows
 
-		A = 1;
+		accumulator acc(mont);
 		for (unsigned i=0, row=0; i < t; i+=width, row++) {
 			unsigned short expcol = 0;
 			// e.g. for width=2, OR bits (f[0]->0, g[0]->2, h[0]->4)
@@ -120,8 +143,9 @@ struct multiexp_table {
 					(bit(e0, i+j) << (width*0+j));
 	  
 			if (expcol) // A <- A * G_Ii
-				MulMod(A, A, table[row][expcol], m);
+				acc.mul(table.entry(row, expcol));
 		}
+		acc.result(A);
 	}
 
 	void multiexp_4(ZZ &A, const ZZ& e0, const ZZ& e1, const ZZ& e2, const ZZ& e3, 
@@ -130,9 +154,9 @@ struct multiexp_table {
 		assert(m == mod); // XXX don't need mod
 		unsigned t = max( max(NumBits(e0), NumBits(e1)), 
 						  max(NumBits(e2), NumBits(e3)) );
-		assert( ((t+width-1)/width) <= table.size()); // enough rows
+		assert( ((t+width-1)/width) <= table.getRows()); // enough rows
 
-		A = 1;
+		accumulator acc(mont);
 		for (unsigned i=0, row=0; i < t; i+=width, row++) {
 			unsigned short expcol = 0;
 			for (unsigned j=0; j < width; j++)
@@ -143,14 +167,16 @@ struct multiexp_table {
 					(bit(e0, i+j) << (width*0+j));
 	  
 			if (expcol) // A <- A * G_Ii
-				MulMod(A, A, table[row][expcol], m);
+				acc.mul(table.entry(row, expcol));
 		}
+		acc.result(A);
 	}
 };
 
 class MultiExpCache {
 	public:
-		typedef boost::unordered_map<vector<string>, multiexp_table> cache_t;
+		typedef boost::shared_ptr<const multiexp_table> table_ptr;
+		typedef boost::unordered_map<vector<string>, table_ptr> cache_t;
 
 		MultiExpCache() {}
 		MultiExpCache(const MultiExpCache &o) : cache(o.cache) {}
@@ -165,46 +191,133 @@ class MultiExpCache {
 				   unsigned max_explen=MAX_EXPLEN) {
 			if (cache.count(baseNames))
 				return; // don't bother if already precomputed
-			multiexp_table& t = cache[baseNames]; // avoids a copy
+			if (!MontgomeryContext::usable(mod))
+				return; // tables are in Montgomery form
+			cache[baseNames] = shared(bases, mod, width, max_explen);
+		}
+
+		/*! returns the process-wide table for these bases, building and
+		 * registering it first if needed */
+		static table_ptr shared(const vector<ZZ>& bases, const ZZ& mod,
+								unsigned width, unsigned max_explen) {
+			TableRegistry<multiexp_table>::key_t key;
+			key.push_back(mod);
+			key.push_back(width);
+			key.push_back(max_explen);
+			for (unsigned i = 0; i < bases.size(); i++)
+				key.push_back(bases[i]);
+			table_ptr t = registry().find(key);
+			if (t)
+				return t;
 #ifdef MEXP_DEBUG
-			cout << "Precomputing MultiExpCache for bases.size()=" << bases.size()
-				 << " " << boost::algorithm::join(baseNames, std::string(",")) 
-				 << endl;
+			cout << "Precomputing MultiExpCache for bases.size()=" 
+				 << bases.size() << endl;
 #endif
-			t.precomp(bases, mod, width, max_explen);
+			boost::shared_ptr<multiexp_table> nt(new multiexp_table());
+			nt->precomp(bases, mod, width, max_explen);
+			registry().insert(key, nt);
+			return nt;
 		}
 
+		static void clearShared() { registry().clear(); }
+
 		bool contains(const vector<string> &bNames) const
 						{return cache.count(bNames) != 0;}
 
-		ZZ modPow(const vector<string>& baseNames, const vector<ZZ> &bases, 
-				  const vector<ZZ>& exps, const ZZ &mod) const {
+		void modPow(ZZ &r, const vector<string>& baseNames, 
+					const vector<ZZ> &bases, const vector<ZZ>& exps, 
+					const ZZ &mod) const {
 			assert (baseNames.size() == exps.size());
 			// XXX: right now only do 2-, 3-, 4- base exponentiation
-			ZZ r;
-			const multiexp_table& tab = cache.at(baseNames);
+			if (baseNames.size() < 2 || baseNames.size() > 4) {
+				r = MultiExp(bases, exps, mod);
+				return;
+			}
+
 #ifdef MEXP_DEBUG
 			cout << "Called MultiExpCache::modPow on exps.size()=" << exps.size()
 				 << " " << boost::algorithm::join(baseNames, std::string(",")) 
 				 << endl;
 #endif
-			if (baseNames.size() == 2) {
-				tab.multiexp_2(r, exps[0], exps[1], mod);
-				return r;
-			} else if (baseNames.size() == 3) {
-				tab.multiexp_3(r, exps[0], exps[1], exps[2], mod);
-				return r;
-			} else if (baseNames.size() == 4) {
-				tab.multiexp_4(r, exps[0], exps[1], exps[2], exps[3], mod);
-				return r;
-			} else {
-				return MultiExp(bases, exps, mod);
+			modPow(r, *cache.at(baseNames), bases, exps, mod);
+		}
+
+		ZZ modPow(const vector<string>& baseNames, const vector<ZZ> &bases, 
+				  const vector<ZZ>& exps, const ZZ &mod) const {
+			ZZ r; modPow(r, baseNames, bases, exps, mod); return r;
+		}
+
+		/*! exponentiation with a table already looked up (see find) */
+		static void modPow(ZZ &r, const multiexp_table &tab,
+						   const vector<ZZ> &bases, const vector<ZZ>& exps,
+						   const ZZ &mod) {
+			if (exps.size() < 2 || exps.size() > 4) {
+				r = MultiExp(bases, exps, mod);
+				return;
+			}
+			// the table only works on non-negative exponents, so split the 
+			// exponents into positive and negative parts: the result is
+			// prod b_i^pos_i * (prod b_i^|neg_i|)^(-1), i.e. two table
+			// lookups and one inversion
+			bool negative = false;
+			for (unsigned i = 0; i < exps.size(); i++)
+				if (sign(exps[i]) < 0)
+					negative = true;
+			if (!negative) {
+				tableExp(r, tab, exps, mod);
+				return;
 			}
+
+			ScratchFrame frame;
+			vector<ZZ> &pos = frame.vec(exps.size()), 
+					   &neg = frame.vec(exps.size());
+			for (unsigned i = 0; i < exps.size(); i++) {
+				if (sign(exps[i]) < 0) {
+					pos[i] = 0;
+					mpz_neg(MPZ(neg[i]), MPZ(exps[i]));
+				} else {
+					pos[i] = exps[i];
+					neg[i] = 0;
+				}
+			}
+			ZZ &d = frame.zz();
+			tableExp(d, tab, neg, mod);
+			tableExp(r, tab, pos, mod);
+			if (!mpz_invert(MPZ(d), MPZ(d), MPZ(mod)))
+				throw CashException(CashException::CE_NTL_ERROR,
+					"[MultiExpCache::modPow] bases are not invertible");
+			MulMod(r, r, d, mod);
+		}
+
+		/*! the table for these bases, or an empty pointer */
+		table_ptr find(const vector<string> &bNames) const {
+			cache_t::const_iterator it = cache.find(bNames);
+			return it == cache.end() ? table_ptr() : it->second;
 		}
 
 		void clear() { cache.clear(); }
 
 	private:
+		friend class TableFile;
+
+		// never freed, so tables outlive any static caches still using them
+		static TableRegistry<multiexp_table>& registry() {
+			static TableRegistry<multiexp_table>* r = 
+				new TableRegistry<multiexp_table>();
+			return *r;
+		}
+
+		// exps must all be non-negative
+		static void tableExp(ZZ &r, const multiexp_table& tab, 
+							 const vector<ZZ>& exps, const ZZ &mod) {
+			if (exps.size() == 2)
+				tab.multiexp_2(r, exps[0], exps[1], mod);
+			else if (exps.size() == 3)
+				tab.multiexp_3(r, exps[0], exps[1], exps[2], mod);
+			else
+				tab.multiexp_4(r, exps[0], exps[1], exps[2], exps[3], mod);
+		}
+
 		cache_t cache;
 };
 
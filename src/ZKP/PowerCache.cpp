@@ -0,0 +1,298 @@
+#include "PowerCache.h"
+#include <NTL/Scratch.h>
+#include <boost/thread/mutex.hpp>
+
+// rough cost of one modular inversion, in modular multiplications
+#define POWERCACHE_INV_COST 20
+
+// budget bookkeeping; the mutex is never freed, since tables may still be
+// released by static destructors at exit
+static boost::mutex* budgetLock = new boost::mutex();
+static size_t memoryBudget = PowerCache::DEFAULT_MEMORY_BUDGET;
+static size_t memoryUsed = 0;
+
+void PowerCache::setMemoryBudget(size_t bytes) {
+	boost::mutex::scoped_lock l(*budgetLock);
+	memoryBudget = bytes;
+}
+
+size_t PowerCache::getMemoryBudget() {
+	boost::mutex::scoped_lock l(*budgetLock);
+	return memoryBudget;
+}
+
+size_t PowerCache::getMemoryUsed() {
+	boost::mutex::scoped_lock l(*budgetLock);
+	return memoryUsed;
+}
+
+bool PowerCache::reserveMemory(size_t bytes) {
+	boost::mutex::scoped_lock l(*budgetLock);
+	if (memoryUsed + bytes > memoryBudget)
+		return false;
+	memoryUsed += bytes;
+	return true;
+}
+
+void PowerCache::releaseMemory(size_t bytes) {
+	boost::mutex::scoped_lock l(*budgetLock);
+	assert(bytes <= memoryUsed);
+	memoryUsed -= bytes;
+}
+
+size_t PowerCache::entryBytes(const ZZ &mod) {
+	// entries are stored as flat limbs, see LimbTable
+	return mpz_size(MPZ(mod)) * sizeof(mp_limb_t);
+}
+
+bool PowerCache::store(const string &baseName, const ZZ &base, 
+					   const ZZ &mod, int bits, const ZZ &order) {
+	table_ptr t = shared(base, mod, bits, order);
+	if (!t)
+		return false;
+	cache[baseName] = t;
+	return true;
+}
+
+TableRegistry<PowerCache::Table>& PowerCache::registry() {
+	// never freed, like budgetLock
+	static TableRegistry<Table>* r = new TableRegistry<Table>();
+	return *r;
+}
+
+PowerCache::table_ptr PowerCache::shared(const ZZ &base, const ZZ &mod, 
+										 int bits, const ZZ &order) {
+	TableRegistry<Table>::key_t key;
+	key.push_back(mod);
+	key.push_back(base % mod);
+	table_ptr t = registry().find(key);
+	// a table reducing mod the order covers every exponent
+	if (t && (t->order != 0 || t->bits >= bits))
+		return t;
+	// two threads may race to build the same table; the loser's copy is
+	// just dropped
+	table_ptr built = build(base, mod, bits, order);
+	if (!built)
+		return t; // a short table still beats none
+	registry().insert(key, built);
+	return built;
+}
+
+void PowerCache::clearShared() {
+	registry().clear();
+}
+
+// k bits of e starting at bit position pos
+static inline unsigned digitAt(const ZZ &e, long pos, int k) {
+	unsigned d = 0;
+	for (int j = 0; j < k; j++)
+		d |= bit(e, pos + j) << j;
+	return d;
+}
+
+static inline long ceilDiv(long a, long b) { return (a + b - 1) / b; }
+
+PowerCache::table_ptr PowerCache::build(const ZZ &base, const ZZ &mod, 
+										int bits, const ZZ &order) {
+	// tables are kept in Montgomery form, which needs an odd modulus
+	if (!MontgomeryContext::usable(mod))
+		return table_ptr();
+	boost::shared_ptr<Table> t(new Table());
+	t->base = base % mod;
+	t->mod = mod;
+	t->mont.init(mod);
+	// exponents can be reduced mod the order only if base really has it
+	if (order > 1 && PowerMod(t->base, order, mod) == 1) {
+		t->order = order;
+		bits = NumBits(order);
+	}
+	t->bits = bits;
+
+	// pick the cheapest table that fits, counting squarings and
+	// multiplications alike
+	size_t entry = entryBytes(mod);
+	size_t limit = TABLE_MEMORY_LIMIT / entry;
+	{
+		boost::mutex::scoped_lock l(*budgetLock);
+		if (memoryUsed >= memoryBudget)
+			return table_ptr();
+		limit = min(limit, (memoryBudget - memoryUsed) / entry);
+	}
+	double best = -1;
+	for (int h = 1; h <= 16; h++) {
+		long a = ceilDiv(bits, h);
+		for (int v = 1; v <= 8 && v <= a; v++) {
+			long b = ceilDiv(a, v);
+			size_t entries = v * ((1L << h) - 1);
+			double cost = (b - 1) + a * (1 - 1.0 / (1L << h));
+			if (entries <= limit && (best < 0 || cost < best)) {
+				best = cost;
+				t->method = COMB;
+				t->k = h;
+				t->v = v;
+			}
+		}
+	}
+	for (int k = 1; k <= 16; k++) {
+		long rows = ceilDiv(bits, k) + 1;
+		size_t entries = rows * (1L << (k-1));
+		double cost = rows * (1 - 1.0 / (1L << k)) + POWERCACHE_INV_COST;
+		if (entries <= limit && (best < 0 || cost < best)) {
+			best = cost;
+			t->method = SIGNED_WINDOW;
+			t->k = k;
+			t->v = 0;
+		}
+	}
+	// not worth it if we can't beat PowerMod's own sliding window
+	if (best < 0 || best > bits)
+		return table_ptr();
+
+	size_t entries;
+	if (t->method == COMB) {
+		int h = t->k, v = t->v;
+		long a = ceilDiv(bits, h), b = ceilDiv(a, v);
+		entries = v * ((1L << h) - 1);
+		if (!reserveMemory(entries * entry))
+			return table_ptr();
+		t->bytes = entries * entry;
+
+		// powers[s][j] = base^(2^(j*a + s*b))
+		vector<vector<ZZ> > powers(v, vector<ZZ>(h));
+		ZZ cur = t->base;
+		long curPos = 0;
+		for (int j = 0; j < h; j++) {
+			for (int s = 0; s < v; s++) {
+				long pos = j*a + s*b;
+				for (; curPos < pos; curPos++)
+					SqrMod(cur, cur, mod);
+				powers[s][j] = cur;
+			}
+		}
+		t->table.allocate(v, 1 << h, mod);
+		vector<ZZ> row(1 << h);
+		for (int s = 0; s < v; s++) {
+			row[0] = 1;
+			t->table.set(s, 0, t->mont.toMont(row[0]));
+			for (unsigned i = 1; i < row.size(); i++) {
+				int top = NumBits(ZZ(i)) - 1;
+				unsigned rest = i ^ (1 << top);
+				if (rest)
+					MulMod(row[i], row[rest], powers[s][top], mod);
+				else
+					row[i] = powers[s][top];
+				t->table.set(s, i, t->mont.toMont(row[i]));
+			}
+		}
+	} else {
+		int k = t->k;
+		long rows = ceilDiv(bits, k) + 1;
+		unsigned width = 1 << (k-1);
+		entries = rows * width;
+		if (!reserveMemory(entries * entry))
+			return table_ptr();
+		t->bytes = entries * entry;
+
+		t->table.allocate(rows, width, mod);
+		ZZ cur = t->base, power;
+		for (long i = 0; i < rows; i++) {
+			if (i > 0)
+				for (int j = 0; j < k; j++)
+					SqrMod(cur, cur, mod);
+			power = cur;
+			t->table.set(i, 0, t->mont.toMont(power));
+			for (unsigned d = 1; d < width; d++) {
+				MulMod(power, power, cur, mod);
+				t->table.set(i, d, t->mont.toMont(power));
+			}
+		}
+	}
+	return t;
+}
+
+void PowerCache::modPow(ZZ &result, const Table &table, const ZZ& n) {
+	// early abort if raising to power 0
+	if (n == 0)	{
+		result = 1;
+		return;
+	}
+
+	ScratchFrame frame;
+	ZZ &e = frame.zz();
+	if (table.order != 0)
+		mpz_mod(MPZ(e), MPZ(n), MPZ(table.order)); // now 0 <= e < order
+	else
+		mpz_abs(MPZ(e), MPZ(n));
+	bool negative = (table.order == 0 && sign(n) < 0);
+
+	if (NumBits(e) > table.bits) {
+		PowerMod(result, table.base, n, table.mod);
+		return;
+	}
+
+	const ZZ &mod = table.mod;
+	const MontgomeryContext &M = table.mont;
+	// result = num * den^(-1), accumulated in Montgomery form
+	size_t limbs = M.size();
+	mp_limb_t *num = frame.limbs(2*limbs + M.scratchSize());
+	mp_limb_t *den = num + limbs, *scratch = den + limbs;
+	memcpy(num, M.one(), limbs * sizeof(mp_limb_t));
+	memcpy(den, M.one(), limbs * sizeof(mp_limb_t));
+	bool useDen = false;
+	if (table.method == COMB) {
+		int h = table.k, v = table.v;
+		long a = ceilDiv(table.bits, h), b = ceilDiv(a, v);
+		bool one = true;
+		for (long c = b - 1; c >= 0; c--) {
+			if (!one)
+				M.sqr(num, num, scratch);
+			for (int s = v - 1; s >= 0; s--) {
+				long col = s*b + c;
+				if (col >= a)
+					continue;
+				unsigned idx = 0;
+				for (int j = 0; j < h; j++)
+					idx |= bit(e, j*a + col) << j;
+				if (idx) {
+					M.mul(num, num, table.table.entry(s, idx), scratch);
+					one = false;
+				}
+			}
+		}
+	} else {
+		int k = table.k;
+		long half = 1L << (k-1);
+		long carry = 0;
+		for (unsigned i = 0; i < table.table.getRows(); i++) {
+			long d = digitAt(e, i*k, k) + carry;
+			if (d > half) {
+				d -= 2*half;
+				carry = 1;
+			} else {
+				carry = 0;
+			}
+			if (d > 0)
+				M.mul(num, num, table.table.entry(i, d-1), scratch);
+			else if (d < 0) {
+				M.mul(den, den, table.table.entry(i, -d-1), scratch);
+				useDen = true;
+			}
+		}
+		assert(carry == 0);
+	}
+
+	ZZ &d = frame.zz();
+	if (negative) {
+		// the result is den/num instead
+		swap(num, den);
+		useDen = true;
+	}
+	M.fromMont(result, num, scratch);
+	if (useDen) {
+		M.fromMont(d, den, scratch);
+		if (!mpz_invert(MPZ(d), MPZ(d), MPZ(mod)))
+			throw CashException(CashException::CE_NTL_ERROR,
+				"[PowerCache::modPow] base is not invertible");
+		MulMod(result, result, d, mod);
+	}
+}
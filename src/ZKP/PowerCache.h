@@ -1,77 +1,103 @@
-
 #ifndef _POWERCACHE_H_
 #define _POWERCACHE_H_
 
 #include <NTL/ZZ.h>
+#include <NTL/Montgomery.h>
 #include <vector>
+#include "../CashException.h"
+#include "LimbTable.h"
+#include "TableRegistry.h"
 #include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+NTL_CLIENT
 
+/*! \brief Fixed-base exponentiation tables for bases that are raised to
+ * many different exponents (group generators, mostly).
+ *
+ * Two kinds of table are built, whichever is estimated to be cheaper for
+ * the exponent length needed and still fits in memory:
+ *  - a Lim-Lee comb: h "teeth" spaced a = ceil(bits/h) bits apart, and v
+ *    tables of 2^h-1 entries, so one exponentiation costs about a/v
+ *    squarings and a multiplications
+ *  - a signed fixed-base window: one row of 2^(k-1) entries per k-bit
+ *    digit, with digits recoded into [-2^(k-1), 2^(k-1)], so one
+ *    exponentiation costs one multiplication per digit plus one inversion
+ *
+ * Table entries are kept in Montgomery form (so only odd moduli are
+ * cached), and exponentiations multiply them with MontgomeryContext
+ * without allocating or dividing.
+ *
+ * If the order of the base is known, exponents are reduced modulo it and
+ * the table only has to cover NumBits(order) bits.  Exponents longer than
+ * a table covers fall back to PowerMod.
+ *
+ * All tables (in every PowerCache in the process) are charged against a
+ * single memory budget; when a table doesn't fit,
+ * store() caches nothing and modPow() is never used for that base.
+ */
 class PowerCache {
 	public:
-		struct Table {
-			Table() {}
-			int k, bits, numLookups;		
-			ZZ mod;
-			vector<vector<ZZ> > table;
+		enum method_t { COMB, SIGNED_WINDOW };
+
+		struct Table : private boost::noncopyable {
+			Table() : method(COMB), k(0), v(0), bits(0), bytes(0) {}
+			~Table() { releaseMemory(bytes); }
+
+			method_t method;
+			int k;		// comb: number of teeth h; window: digit width
+			int v;		// comb: number of tables (unused for windows)
+			int bits;	// longest exponent the table covers
+			ZZ base, mod;
+			ZZ order;	// exponents are reduced mod order if it is nonzero
+			MontgomeryContext mont; // entries are in Montgomery form
+			size_t bytes; // charged against the memory budget
+			// comb: table(s, i) = prod_{j in i} base^(2^(j*a + s*b))
+			// window: table(row, d-1) = base^(d * 2^(k*row))
+			LimbTable table;
 		};
-		typedef boost::unordered_map<string, Table> cache_t;
+		typedef boost::shared_ptr<const Table> table_ptr;
+		typedef boost::unordered_map<string, table_ptr> cache_t;
 
 		PowerCache() {}
 		PowerCache(const PowerCache &o) : cache(o.cache) {}
 		~PowerCache() {}
 
-		void store(const string &baseName, const ZZ &base, const ZZ &mod, 
-				   int bits, int k) {
-			Table table;
-			int lookupSize = 1 << k;
-			table.numLookups = bits / k + 1;
-			table.k = k;
-			table.bits = bits;
-			table.mod = mod;
-			ZZ multiplier = base;
-			vector<vector<ZZ> > tab;
-			for (int i = 0; i < table.numLookups; i++) {
-				vector<ZZ> lookup(lookupSize);
-				lookup[0] = 1;
-				for (int j = 1; j < lookupSize; j++) {
-					// do square-and-multiply (sort of)
-					lookup[j] = MulMod(multiplier, lookup[j-1], mod);
-				}
-				multiplier = MulMod(multiplier, lookup[lookupSize - 1], mod);
-				tab.push_back(lookup);
-			}
-			table.table = tab;
-			cache[baseName] = table;
-		}
+		/*! precomputes powers of base for exponents of up to bits bits
+		 * (or NumBits(order) bits, if order is nonzero and base^order = 1);
+		 * returns false if no table fits in the memory budget.  Tables
+		 * are shared process-wide: see shared() */
+		bool store(const string &baseName, const ZZ &base, const ZZ &mod,
+				   int bits, const ZZ &order = ZZ());
+
+		/*! returns the process-wide table for (mod, base), building and
+		 * registering it first if there is none yet or the registered one
+		 * is too short for bits */
+		static table_ptr shared(const ZZ &base, const ZZ &mod, int bits,
+								const ZZ &order = ZZ());
+
+		/*! drops all shared tables (caches already holding them keep
+		 * them until they are cleared) */
+		static void clearShared();
+
+		/*! builds a table without adding it to the cache; returns an
+		 * empty pointer if none fits in the memory budget */
+		static table_ptr build(const ZZ &base, const ZZ &mod, int bits,
+							   const ZZ &order = ZZ());
 
-		ZZ modPow(const Table &table, const ZZ& n) const {
-			int word;                     /* the word to look up. 0<word<base */
-			int row, s;                   /* row and col in base table */
-			int num_lookups;
-			ZZ result = 1;
-			
-			// early abort if raising to power 0
-			if (n == 0)	return 1;
-
-			num_lookups = mpz_sizeinbase(MPZ(n), 2) / table.k + 1;
-			for (row = 0; row < num_lookups; row++) {
-				word = 0;
-				for (s = 0; s < table.k; s++) {
-					word |= mpz_tstbit(MPZ(n), table.k * row + s) << s;
-				}
-				if (word > 0) {
-					MulMod(result, result, table.table[row][word], table.mod);
-				}
-			}
-			return result;
+		static void modPow(ZZ &result, const Table &table, const ZZ& n);
+
+		static ZZ modPow(const Table &table, const ZZ& n) {
+			ZZ r; modPow(r, table, n); return r;
 		}
 
-		void modPow(ZZ& res, const string& baseName, const ZZ& n, 
+		void modPow(ZZ& res, const string& baseName, const ZZ& n,
 					const ZZ& mod) const {
 			// look up table
-			const Table &table = cache.at(baseName);
+			const Table &table = *cache.at(baseName);
 			assert(mod == table.mod);
-			res = modPow(table, n);
+			modPow(res, table, n);
 		}
 
 		ZZ modPow(const string& baseName, const ZZ& n, const ZZ& mod) const {
@@ -81,9 +107,35 @@ class PowerCache {
 		bool contains(const string &baseName) const
 					{return cache.count(baseName) != 0;}
 
+		/*! the table for baseName, or an empty pointer */
+		table_ptr find(const string &baseName) const {
+			cache_t::const_iterator it = cache.find(baseName);
+			return it == cache.end() ? table_ptr() : it->second;
+		}
+
 		void clear() { cache.clear(); }
 
+		/*! process-wide limit on memory used by precomputed tables */
+		static void setMemoryBudget(size_t bytes);
+		static size_t getMemoryBudget();
+		static size_t getMemoryUsed();
+
+		/*! largest single table that will be built */
+		static const size_t TABLE_MEMORY_LIMIT = 4 << 20;
+		static const size_t DEFAULT_MEMORY_BUDGET = 512 << 20;
+
+		/*! charge/release bytes against the budget; reserveMemory returns
+		 * false if they don't fit */
+		static bool reserveMemory(size_t bytes);
+		static void releaseMemory(size_t bytes);
+
+		/*! memory for one table entry modulo mod */
+		static size_t entryBytes(const ZZ &mod);
+
 	private:
+		friend class TableFile;
+		static TableRegistry<Table>& registry();
+
 		cache_t cache;
 };
 
@@ -0,0 +1,136 @@
+#include "ProgramFile.h"
+#include "InterpreterProver.h"
+#include "../Serialize.h"
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+// followed by the version (a decimal number and a newline), and then a
+// binary archive of a compiled_program
+#define PROGRAMFILE_MAGIC "CASHZKP "
+
+// every node type, so trees can be saved and loaded through base pointers
+BOOST_CLASS_EXPORT(ASTNode)
+BOOST_CLASS_EXPORT(ASTIdentifierLit)
+BOOST_CLASS_EXPORT(ASTIdentifierSub)
+BOOST_CLASS_EXPORT(ASTDeclGeneral)
+BOOST_CLASS_EXPORT(ASTDeclIdentifierLit)
+BOOST_CLASS_EXPORT(ASTDeclIdentifierSub)
+BOOST_CLASS_EXPORT(ASTExpr)
+BOOST_CLASS_EXPORT(ASTExprInt)
+BOOST_CLASS_EXPORT(ASTExprIdentifier)
+BOOST_CLASS_EXPORT(ASTUnaryOp)
+BOOST_CLASS_EXPORT(ASTNegative)
+BOOST_CLASS_EXPORT(ASTBinaryOp)
+BOOST_CLASS_EXPORT(ASTAdd)
+BOOST_CLASS_EXPORT(ASTSub)
+BOOST_CLASS_EXPORT(ASTMul)
+BOOST_CLASS_EXPORT(ASTDiv)
+BOOST_CLASS_EXPORT(ASTPow)
+BOOST_CLASS_EXPORT(ASTList)
+BOOST_CLASS_EXPORT(ASTListIdentifierLit)
+BOOST_CLASS_EXPORT(ASTListIdentifierSub)
+BOOST_CLASS_EXPORT(ASTListDecl)
+BOOST_CLASS_EXPORT(ASTListDeclIdentifierLit)
+BOOST_CLASS_EXPORT(ASTListDeclIdentifierSub)
+BOOST_CLASS_EXPORT(ASTDeclIDRange)
+BOOST_CLASS_EXPORT(ASTRelation)
+BOOST_CLASS_EXPORT(ASTForRel)
+BOOST_CLASS_EXPORT(ASTEqual)
+BOOST_CLASS_EXPORT(ASTCommitment)
+BOOST_CLASS_EXPORT(ASTGiven)
+BOOST_CLASS_EXPORT(ASTRandomPrime)
+BOOST_CLASS_EXPORT(ASTRandomBnd)
+BOOST_CLASS_EXPORT(ASTDeclGroup)
+BOOST_CLASS_EXPORT(ASTDeclIntegers)
+BOOST_CLASS_EXPORT(ASTListGiven)
+BOOST_CLASS_EXPORT(ASTListRandoms)
+BOOST_CLASS_EXPORT(ASTListRelation)
+BOOST_CLASS_EXPORT(ASTDeclElements)
+BOOST_CLASS_EXPORT(ASTDeclExponents)
+BOOST_CLASS_EXPORT(ASTDeclRandExponents)
+BOOST_CLASS_EXPORT(ASTDeclEqual)
+BOOST_CLASS_EXPORT(ASTRange)
+BOOST_CLASS_EXPORT(ASTForExpr)
+BOOST_CLASS_EXPORT(ASTComputation)
+BOOST_CLASS_EXPORT(ASTProof)
+BOOST_CLASS_EXPORT(ASTSpec)
+
+const unsigned ProgramFile::VERSION;
+
+struct compiled_program {
+	ASTSpecPtr parsed;
+	input_map inputs;
+	ASTSpecPtr checked;
+	Environment env;
+
+	template <class Archive>
+	void serialize(Archive& ar, const unsigned int ver) {
+		ar	& auto_nvp(parsed)
+			& auto_nvp(inputs)
+			& auto_nvp(checked)
+			& auto_nvp(env)
+			;
+	}
+};
+
+string ProgramFile::compile(const string &source, const input_map &inputs) {
+	compiled_program c;
+	c.parsed = Interpreter::parse(source, "program source");
+	c.inputs = inputs;
+
+	// checking rewrites the tree it runs on, so the parsed tree above is
+	// kept separately from the one checked here
+	InterpreterProver p;
+	p.checkSource(source, c.inputs, group_map());
+	c.checked = dynamic_pointer_cast<ASTSpec>(p.getTree());
+	c.env = p.getEnvironment();
+	return PROGRAMFILE_MAGIC + lexical_cast<string>(VERSION) + "\n" +
+		   saveString(c);
+}
+
+void ProgramFile::save(const string &outName, const string &sourceName,
+					   const input_map &inputs) {
+	ifstream in(sourceName.c_str());
+	if (!in)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[ProgramFile::save] Cannot open %s", sourceName.c_str());
+	stringstream source;
+	source << in.rdbuf();
+	string compiled = compile(source.str(), inputs);
+
+	ofstream out(outName.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out || !out.write(compiled.data(), compiled.size()))
+		throw CashException(CashException::CE_IO_ERROR,
+			"[ProgramFile::save] Cannot write %s", outName.c_str());
+}
+
+bool ProgramFile::isCompiled(const string &program) {
+	return program.compare(0, strlen(PROGRAMFILE_MAGIC),
+						   PROGRAMFILE_MAGIC) == 0;
+}
+
+bool ProgramFile::load(const string &program, const input_map &inputs,
+					   ASTSpecPtr &tree, Environment &env) {
+	size_t body = program.find('\n');
+	unsigned version = 0;
+	if (body != string::npos) {
+		size_t start = strlen(PROGRAMFILE_MAGIC);
+		version = atoi(program.substr(start, body - start).c_str());
+	}
+	if (version != VERSION)
+		throw CashException(CashException::CE_PARSE_ERROR,
+			"[ProgramFile::load] Compiled program has version %u, "
+			"expected %u", version, VERSION);
+
+	compiled_program c;
+	loadString(c, program.substr(body + 1));
+	if (c.checked && c.inputs == inputs) {
+		tree = c.checked;
+		env = c.env;
+		return true;
+	}
+	tree = c.parsed;
+	return false;
+}
@@ -0,0 +1,49 @@
+#ifndef _PROGRAMFILE_H_
+#define _PROGRAMFILE_H_
+
+#include <string>
+#include "ASTNode.h"
+#include "Environment.h"
+
+/*! \brief Saves programs in a compiled, binary form that Interpreter::check
+ * loads without running the ANTLR lexer and parser.
+ *
+ * A compiled program holds the tree as it comes out of the parser, plus
+ * the fully checked tree and Environment (everything Interpreter::check
+ * does before binding groups) for the inputs it was compiled with.
+ * Checking it with those same inputs just deserializes the checked
+ * program; with other inputs, the visitors are run on the parsed tree as
+ * usual.  Either way, the groups are bound and the ProofPlan built at
+ * load time.
+ *
+ * check() recognizes compiled programs by their header, so a compiled
+ * file can be used wherever its source was.  Like TableFile, compiled
+ * programs are only readable on machines with the same word size and
+ * byte order as the one that wrote them.
+ */
+class ProgramFile {
+	public:
+		static const unsigned VERSION = 1;
+
+		/*! compiles the program in source (its text), checking it with
+		 * inputs, and returns it in compiled form */
+		static string compile(const string &source,
+							  const input_map &inputs = input_map());
+
+		/*! compiles the program in the file sourceName and writes it to
+		 * outName */
+		static void save(const string &outName, const string &sourceName,
+						 const input_map &inputs = input_map());
+
+		/*! true if program is a compiled program rather than source */
+		static bool isCompiled(const string &program);
+
+		/*! reads a compiled program: if it was checked with inputs, sets
+		 * tree and env to the checked program and returns true; otherwise
+		 * sets tree to the parsed program (to be checked by the caller)
+		 * and returns false */
+		static bool load(const string &program, const input_map &inputs,
+						 ASTSpecPtr &tree, Environment &env);
+};
+
+#endif /*_PROGRAMFILE_H_*/
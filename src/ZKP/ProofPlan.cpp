@@ -0,0 +1,75 @@
+
+#include "ProofPlan.h"
+#include "../MultiExp.h"
+#include <algorithm>
+
+static void uniqueSlots(vector<unsigned> &v) {
+	sort(v.begin(), v.end());
+	v.erase(unique(v.begin(), v.end()), v.end());
+}
+
+ProofPlan::ProofPlan(Environment &env) {
+	VariableTable &vars = env.variables;
+	for (dlr_map::const_iterator it = env.descriptions.begin();
+								 it != env.descriptions.end(); ++it) {
+		const DLRepresentation &cd = it->second;
+		Relation rel;
+		rel.name = cd.toString();
+		rel.group = cd.group;
+		rel.left = vars.slot(cd.left->toString());
+		leftSlots.push_back(rel.left);
+		for (unsigned j = 0; j < cd.bases.size(); j++) {
+			string baseName = cd.bases[j]->toString();
+			rel.baseNames.push_back(baseName);
+			rel.bases.push_back(vars.slot(baseName));
+			rel.exps.push_back(vars.slot(cd.exps[j]->toString()));
+		}
+		baseSlots.insert(baseSlots.end(), rel.bases.begin(), rel.bases.end());
+		expSlots.insert(expSlots.end(), rel.exps.begin(), rel.exps.end());
+
+		if (rel.bases.size() == 1 && env.cache)
+			rel.power = env.cache->find(rel.baseNames[0]);
+		else if (rel.bases.size() > 1 && env.multiCache)
+			rel.multi = env.multiCache->find(rel.baseNames);
+		relations.push_back(rel);
+	}
+	uniqueSlots(leftSlots);
+	uniqueSlots(baseSlots);
+	uniqueSlots(expSlots);
+	for (unsigned i = 0; i < expSlots.size(); i++)
+		expNames.push_back(vars.name(expSlots[i]));
+	slots = vars.slotCount();
+}
+
+void ProofPlan::require(const VariableTable &vars,
+						const vector<unsigned> &which) const {
+	for (unsigned i = 0; i < which.size(); i++) {
+		if (!vars.has(which[i]))
+			throw CashException(CashException::CE_SIZE_ERROR,
+								"No value for %s", 
+								vars.name(which[i]).c_str());
+	}
+}
+
+void ProofPlan::loadExponents(vector<ZZ> &values, 
+							  const variable_map &exps) const {
+	if (values.size() < slots)
+		values.resize(slots);
+	for (unsigned i = 0; i < expSlots.size(); i++) {
+		variable_map::const_iterator it = exps.find(expNames[i]);
+		if (it == exps.end())
+			throw CashException(CashException::CE_SIZE_ERROR,
+								"No value for %s", expNames[i].c_str());
+		values[expSlots[i]] = it->second;
+	}
+}
+
+void ProofPlan::multiExp(ZZ &r, const Relation &rel, const vector<ZZ> &bases,
+						 const vector<ZZ> &exps, const ZZ &mod) {
+	if (rel.power)
+		PowerCache::modPow(r, *rel.power, exps[0]);
+	else if (rel.multi)
+		MultiExpCache::modPow(r, *rel.multi, bases, exps, mod);
+	else
+		r = MultiExp(bases, exps, mod);
+}
@@ -0,0 +1,74 @@
+#ifndef _PROOFPLAN_H_
+#define _PROOFPLAN_H_
+
+#include "Environment.h"
+
+/*! \brief The relations of a compiled program, flattened for proving and
+ * verifying.
+ *
+ * Every relation is stored with its name, group, the slots (in
+ * Environment::variables) of its left side, bases and exponents, and
+ * the precomputed table for its bases (if the environment had one).  A
+ * plan is built once, when Interpreter::check compiles the program, and
+ * never changes afterwards, so every Environment loaded from the
+ * InterpreterCache shares it.  A prove or verify call reads the values
+ * it needs straight out of the environment's slot vector, instead of
+ * converting AST nodes to strings and looking them up relation by
+ * relation.
+ */
+class ProofPlan {
+	public:
+		struct Relation {
+			/*! DLRepresentation::toString(), which keys the proof maps */
+			string name;
+			string group;
+			unsigned left;
+			vector<unsigned> bases;
+			vector<unsigned> exps;
+			vector<string> baseNames;
+			/*! tables for the bases, if they were cached: power for a
+			 * single base, multi for two to four */
+			PowerCache::table_ptr power;
+			MultiExpCache::table_ptr multi;
+		};
+
+		/*! gives every name used in a relation a slot in env.variables */
+		ProofPlan(Environment &env);
+
+		const vector<Relation>& getRelations() const { return relations; }
+
+		/*! number of slots when the plan was built (all slots it uses
+		 * are below this) */
+		size_t slotCount() const { return slots; }
+
+		/*! throws unless all bases (or left sides, or exponents) are set
+		 * in vars */
+		void requireBases(const VariableTable &vars) const
+			{ require(vars, baseSlots); }
+		void requireLefts(const VariableTable &vars) const
+			{ require(vars, leftSlots); }
+		void requireExponents(const VariableTable &vars) const
+			{ require(vars, expSlots); }
+
+		/*! for exponents given by name rather than in the environment
+		 * (randomized exponents, responses): values is resized to
+		 * slotCount() and the exponent slots are filled in from exps;
+		 * throws if any is missing */
+		void loadExponents(vector<ZZ> &values, const variable_map &exps) const;
+
+		/*! r = prod bases[j]^exps[j] for relation rel (bases and exps as
+		 * gathered from the slots of rel), using its table if it has one */
+		static void multiExp(ZZ &r, const Relation &rel, const vector<ZZ> &bases,
+							 const vector<ZZ> &exps, const ZZ &mod);
+
+	private:
+		void require(const VariableTable &vars,
+					 const vector<unsigned> &which) const;
+
+		vector<Relation> relations;
+		size_t slots;
+		vector<unsigned> baseSlots, leftSlots, expSlots;
+		vector<string> expNames; // same order as expSlots
+};
+
+#endif /*_PROOFPLAN_H_*/
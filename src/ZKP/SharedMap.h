@@ -0,0 +1,70 @@
+#ifndef _SHAREDMAP_H_
+#define _SHAREDMAP_H_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/nvp.hpp>
+
+/*! \brief A map that is shared between copies until one of them writes
+ * to it.
+ *
+ * The compile-time parts of an Environment (types, privacy settings,
+ * relations, ...) are the same for every Interpreter loaded from the
+ * InterpreterCache, and are only read while proving or verifying.
+ * Keeping them in SharedMaps makes copying an Environment cost a
+ * reference count per map instead of a copy of every map.
+ *
+ * Reading (count, at, find, iteration) never copies; the first write
+ * (operator[], insert, erase) to a map that is still shared copies it.
+ * Iterators are always const: write through operator[] or mut().
+ */
+template <class M>
+class SharedMap {
+	public:
+		typedef typename M::key_type key_type;
+		typedef typename M::mapped_type mapped_type;
+		typedef typename M::value_type value_type;
+		typedef typename M::size_type size_type;
+		typedef typename M::const_iterator const_iterator;
+		typedef const_iterator iterator;
+
+		SharedMap() : m(new M()) {}
+		SharedMap(const M &o) : m(new M(o)) {}
+
+		SharedMap& operator=(const M &o) { m.reset(new M(o)); return *this; }
+
+		operator const M&() const { return *m; }
+		const M& get() const { return *m; }
+
+		/*! the map itself, copied first if it is shared */
+		M& mut() {
+			if (!m.unique())
+				m.reset(new M(*m));
+			return *m;
+		}
+
+		size_type size() const { return m->size(); }
+		bool empty() const { return m->empty(); }
+		size_type count(const key_type &k) const { return m->count(k); }
+		const mapped_type& at(const key_type &k) const { return m->at(k); }
+		const_iterator find(const key_type &k) const { return m->find(k); }
+		const_iterator begin() const { return m->begin(); }
+		const_iterator end() const { return m->end(); }
+
+		mapped_type& operator[](const key_type &k) { return mut()[k]; }
+		size_type erase(const key_type &k) {
+			return m->count(k) ? mut().erase(k) : 0;
+		}
+		void insert(const value_type &v) { mut().insert(v); }
+		void clear() { m.reset(new M()); }
+
+	private:
+		friend class boost::serialization::access;
+		template <class Archive>
+		void serialize(Archive& ar, const unsigned int ver) {
+			ar & boost::serialization::make_nvp("map", mut());
+		}
+
+		boost::shared_ptr<M> m;
+};
+
+#endif /*_SHAREDMAP_H_*/
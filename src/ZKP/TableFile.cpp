@@ -0,0 +1,339 @@
+#include "TableFile.h"
+#include "../AtomicFile.h"
+#include "../Hash.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TABLEFILE_MAGIC "CASHTBL"
+#define TABLEFILE_BYTE_ORDER 0x0102030405060708ULL
+// record data is aligned to cache lines
+#define TABLEFILE_ALIGN 64
+
+struct file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t limbBytes;
+	uint64_t byteOrder;
+	uint64_t count;
+};
+
+struct record_header {
+	uint32_t kind;
+	uint32_t nparams;
+	uint32_t nnums;
+	uint32_t unused;
+	uint64_t rows, cols, limbs;
+	uint64_t dataOffset;
+	// SHA-256 of the entries
+	uint8_t digest[32];
+	// followed by nparams int64_t and nnums numbers, see putNum
+};
+
+static Digest entriesDigest(const mp_limb_t *data, size_t limbs) {
+	HashContext ctx(Hash::SHA256, "");
+	return ctx.digest((const char*) data, limbs * sizeof(mp_limb_t));
+}
+
+// a table about to be written
+struct record {
+	uint32_t kind;
+	vector<int64_t> params;
+	vector<ZZ> nums;
+	const LimbTable* table;
+};
+
+template <class T>
+static void put(string &out, const T &v) {
+	out.append((const char*) &v, sizeof(v));
+}
+
+// numbers are a signed limb count followed by the limbs
+static void putNum(string &out, const ZZ &n) {
+	int64_t size = mpz_size(MPZ(n));
+	put(out, sign(n) < 0 ? -size : size);
+	if (size)
+		out.append((const char*) mpz_limbs_read(MPZ(n)),
+				   size * sizeof(mp_limb_t));
+}
+
+static size_t metaSize(const record &r) {
+	size_t s = sizeof(record_header) + r.params.size() * sizeof(int64_t);
+	for (unsigned i = 0; i < r.nums.size(); i++)
+		s += sizeof(int64_t) + mpz_size(MPZ(r.nums[i])) * sizeof(mp_limb_t);
+	return s;
+}
+
+static size_t align(size_t n) {
+	return (n + TABLEFILE_ALIGN - 1) / TABLEFILE_ALIGN * TABLEFILE_ALIGN;
+}
+
+unsigned TableFile::save(const string &fname) {
+	vector<record> records;
+
+	vector<pair<TableRegistry<PowerCache::Table>::key_t,
+				PowerCache::table_ptr> > powers =
+		PowerCache::registry().entries();
+	for (unsigned i = 0; i < powers.size(); i++) {
+		const PowerCache::Table &t = *powers[i].second;
+		record r;
+		r.kind = POWER_TABLE;
+		r.params.push_back(t.method);
+		r.params.push_back(t.k);
+		r.params.push_back(t.v);
+		r.params.push_back(t.bits);
+		r.nums.push_back(t.mod);
+		r.nums.push_back(t.base);
+		r.nums.push_back(t.order);
+		r.table = &t.table;
+		records.push_back(r);
+	}
+
+	vector<pair<TableRegistry<multiexp_table>::key_t,
+				MultiExpCache::table_ptr> > multis =
+		MultiExpCache::registry().entries();
+	for (unsigned i = 0; i < multis.size(); i++) {
+		// key is mod, width, max_explen, bases...
+		const TableRegistry<multiexp_table>::key_t &key = multis[i].first;
+		const multiexp_table &t = *multis[i].second;
+		record r;
+		r.kind = MULTIEXP_TABLE;
+		r.params.push_back(t.blen);
+		r.params.push_back(t.width);
+		r.params.push_back(key[2].get_ui());
+		r.nums.push_back(t.mod);
+		r.nums.insert(r.nums.end(), key.begin() + 3, key.end());
+		r.table = &t.table;
+		records.push_back(r);
+	}
+
+	file_header h;
+	memset(&h, 0, sizeof(h));
+	strncpy(h.magic, TABLEFILE_MAGIC, sizeof(h.magic));
+	h.version = VERSION;
+	h.limbBytes = sizeof(mp_limb_t);
+	h.byteOrder = TABLEFILE_BYTE_ORDER;
+	h.count = records.size();
+
+	// metadata for all records comes first, then the (aligned) entries
+	size_t offset = sizeof(h);
+	for (unsigned i = 0; i < records.size(); i++)
+		offset += metaSize(records[i]);
+	string meta;
+	put(meta, h);
+	vector<size_t> offsets;
+	for (unsigned i = 0; i < records.size(); i++) {
+		const record &r = records[i];
+		offset = align(offset);
+		offsets.push_back(offset);
+
+		record_header rh;
+		memset(&rh, 0, sizeof(rh));
+		rh.kind = r.kind;
+		rh.nparams = r.params.size();
+		rh.nnums = r.nums.size();
+		rh.rows = r.table->getRows();
+		rh.cols = r.table->getCols();
+		rh.limbs = r.table->getLimbs();
+		rh.dataOffset = offset;
+		Digest d = entriesDigest(r.table->getData(), r.table->sizeInLimbs());
+		memcpy(rh.digest, d.bytes, sizeof(rh.digest));
+		put(meta, rh);
+		for (unsigned j = 0; j < r.params.size(); j++)
+			put(meta, r.params[j]);
+		for (unsigned j = 0; j < r.nums.size(); j++)
+			putNum(meta, r.nums[j]);
+
+		offset += r.table->sizeInLimbs() * sizeof(mp_limb_t);
+	}
+
+	// processes starting up meanwhile never map a half-written file
+	AtomicFile out(fname, "TableFile::save");
+	out.write(meta);
+	size_t pos = meta.size();
+	for (unsigned i = 0; i < records.size(); i++) {
+		out.write(string(offsets[i] - pos, '\0'));
+		size_t bytes = records[i].table->sizeInLimbs() * sizeof(mp_limb_t);
+		out.write(records[i].table->getData(), bytes);
+		pos = offsets[i] + bytes;
+	}
+	out.commit();
+	return records.size();
+}
+
+// unmaps the file once no table points into it any more
+struct unmapper {
+	unmapper(size_t len) : len(len) {}
+	void operator()(const void *p) const { munmap((void*) p, len); }
+	size_t len;
+};
+
+// bounds-checked reads from the mapped file
+struct reader {
+	reader(const char *p, size_t len, const string &fname)
+		: begin(p), cur(p), end(p + len), fname(fname) {}
+
+	void need(size_t n) const {
+		if (size_t(end - cur) < n)
+			fail("truncated");
+	}
+
+	template <class T>
+	T get() {
+		T v;
+		need(sizeof(v));
+		memcpy(&v, cur, sizeof(v));
+		cur += sizeof(v);
+		return v;
+	}
+
+	ZZ getNum() {
+		int64_t size = get<int64_t>();
+		size_t n = size < 0 ? -size : size;
+		if (n > size_t(end - cur) / sizeof(mp_limb_t))
+			fail("truncated");
+		ZZ r;
+		if (n) {
+			mp_limb_t *limbs = mpz_limbs_write(MPZ(r), n);
+			memcpy(limbs, cur, n * sizeof(mp_limb_t));
+			mpz_limbs_finish(MPZ(r), size);
+			cur += n * sizeof(mp_limb_t);
+		}
+		return r;
+	}
+
+	void fail(const char *why) const {
+		throw CashException(CashException::CE_IO_ERROR,
+			"[TableFile::load] %s: %s", fname.c_str(), why);
+	}
+
+	const char *begin, *cur, *end;
+	const string &fname;
+};
+
+unsigned TableFile::load(const string &fname) {
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[TableFile::load] Could not open %s", fname.c_str());
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(file_header)) {
+		close(fd);
+		throw CashException(CashException::CE_IO_ERROR,
+			"[TableFile::load] %s is not a table file", fname.c_str());
+	}
+	size_t len = st.st_size;
+	void *p = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		throw CashException(CashException::CE_IO_ERROR,
+			"[TableFile::load] Could not map %s", fname.c_str());
+	boost::shared_ptr<const void> owner(p, unmapper(len));
+
+	reader in((const char*) p, len, fname);
+	file_header h = in.get<file_header>();
+	if (strncmp(h.magic, TABLEFILE_MAGIC, sizeof(h.magic)) != 0)
+		in.fail("not a table file");
+	if (h.version != VERSION || h.limbBytes != sizeof(mp_limb_t) ||
+		h.byteOrder != TABLEFILE_BYTE_ORDER)
+		in.fail("written by an incompatible version or machine");
+
+	// parse everything before registering anything, so a bad file
+	// doesn't leave half its tables behind
+	vector<pair<TableRegistry<PowerCache::Table>::key_t,
+				PowerCache::table_ptr> > powers;
+	vector<pair<TableRegistry<multiexp_table>::key_t,
+				MultiExpCache::table_ptr> > multis;
+	for (uint64_t i = 0; i < h.count; i++) {
+		record_header rh = in.get<record_header>();
+		if (rh.nparams > 16 || rh.nnums > 16)
+			in.fail("bad record");
+		vector<int64_t> params(rh.nparams);
+		for (unsigned j = 0; j < rh.nparams; j++)
+			params[j] = in.get<int64_t>();
+		vector<ZZ> nums(rh.nnums);
+		for (unsigned j = 0; j < rh.nnums; j++)
+			nums[j] = in.getNum();
+
+		if (nums.empty() || !MontgomeryContext::usable(nums[0]) ||
+			rh.limbs != mpz_size(MPZ(nums[0])) ||
+			rh.rows > len || rh.cols > len ||
+			rh.dataOffset % TABLEFILE_ALIGN != 0 || rh.dataOffset > len ||
+			rh.rows * rh.cols > (len - rh.dataOffset) / sizeof(mp_limb_t) /
+								 max(rh.limbs, uint64_t(1)))
+			in.fail("bad record");
+		const mp_limb_t *data =
+			(const mp_limb_t*) (in.begin + rh.dataOffset);
+		// wrong entries would silently give wrong exponentiations, and
+		// every proof made with them would be wrong
+		Digest d = entriesDigest(data, rh.rows * rh.cols * rh.limbs);
+		if (memcmp(d.bytes, rh.digest, sizeof(rh.digest)) != 0)
+			in.fail("table entries don't match their digest");
+
+		if (rh.kind == POWER_TABLE && params.size() == 4 && nums.size() == 3) {
+			boost::shared_ptr<PowerCache::Table> t(new PowerCache::Table());
+			t->method = (PowerCache::method_t) params[0];
+			t->k = params[1];
+			t->v = params[2];
+			t->bits = params[3];
+			t->mod = nums[0];
+			t->base = nums[1];
+			t->order = nums[2];
+			t->mont.init(t->mod);
+			bool ok = (t->k >= 1 && t->k <= 16 && t->bits >= 0 &&
+					   sign(t->base) >= 0 && t->base < t->mod);
+			// exponents get reduced mod the order, so as in
+			// PowerCache::build it has to really be the base's order
+			if (ok && t->order != 0)
+				ok = (t->order > 1 && t->bits == NumBits(t->order) &&
+					  PowerMod(t->base, t->order, t->mod) == 1);
+			if (ok && t->method == PowerCache::COMB)
+				ok = (t->v >= 1 && rh.rows == unsigned(t->v) &&
+					  rh.cols == (1ULL << t->k));
+			else if (ok && t->method == PowerCache::SIGNED_WINDOW)
+				ok = (rh.rows == unsigned((t->bits + t->k - 1) / t->k + 1) &&
+					  rh.cols == (1ULL << (t->k - 1)));
+			else
+				ok = false;
+			if (!ok)
+				in.fail("bad power table");
+			t->table.attach(rh.rows, rh.cols, rh.limbs, data, owner);
+
+			TableRegistry<PowerCache::Table>::key_t key;
+			key.push_back(t->mod);
+			key.push_back(t->base);
+			powers.push_back(make_pair(key, t));
+		} else if (rh.kind == MULTIEXP_TABLE && params.size() == 3 &&
+				   nums.size() == unsigned(params[0]) + 1) {
+			boost::shared_ptr<multiexp_table> t(new multiexp_table());
+			t->blen = params[0];
+			t->width = params[1];
+			int64_t maxlen = params[2];
+			t->mod = nums[0];
+			t->mont.init(t->mod);
+			if (t->width < 1 || t->width * t->blen > 16 || maxlen < 0 ||
+				rh.rows != uint64_t((maxlen + t->width - 1) / t->width) ||
+				rh.cols != (1ULL << (t->width * t->blen)))
+				in.fail("bad multi-exponentiation table");
+			t->table.attach(rh.rows, rh.cols, rh.limbs, data, owner);
+
+			TableRegistry<multiexp_table>::key_t key;
+			key.push_back(t->mod);
+			key.push_back(t->width);
+			key.push_back(ZZ(long(maxlen)));
+			key.insert(key.end(), nums.begin() + 1, nums.end());
+			multis.push_back(make_pair(key, t));
+		} else {
+			in.fail("unknown record");
+		}
+	}
+
+	for (unsigned i = 0; i < powers.size(); i++)
+		PowerCache::registry().insert(powers[i].first, powers[i].second);
+	for (unsigned i = 0; i < multis.size(); i++)
+		MultiExpCache::registry().insert(multis[i].first, multis[i].second);
+	return powers.size() + multis.size();
+}
@@ -0,0 +1,43 @@
+#ifndef _TABLEFILE_H_
+#define _TABLEFILE_H_
+
+#include <string>
+#include "PowerCache.h"
+#include "MultiExpCache.h"
+
+/*! \brief Saves and loads the shared PowerCache and MultiExpCache tables
+ * (see TableRegistry) so that a restarted process doesn't have to
+ * precompute them again.
+ *
+ * The file is a header followed by one record per table; each record
+ * holds the table's parameters, the numbers it is keyed by (modulus and
+ * bases), and the offset of its entries, which are stored as flat limbs
+ * exactly as LimbTable keeps them in memory (in Montgomery form), and a
+ * SHA-256 digest of them.  load() maps the file read-only, checks each
+ * digest and points the tables straight at it, so loading costs one pass
+ * of hashing but no exponentiations, and processes loading the same file
+ * share its pages.
+ * Files are only readable on machines with the same limb size and byte
+ * order as the one that wrote them.
+ */
+class TableFile {
+	public:
+		// 2: entries in Montgomery form
+		// 3: a digest of each record's entries
+		static const unsigned VERSION = 3;
+
+		/*! writes every currently shared table to fname; returns the
+		 * number of tables written */
+		static unsigned save(const string &fname);
+
+		/*! maps fname and registers its tables, replacing any shared
+		 * tables with the same keys; returns the number of tables loaded.
+		 * Tables loaded this way don't count against the PowerCache
+		 * memory budget. */
+		static unsigned load(const string &fname);
+
+	private:
+		enum kind_t { POWER_TABLE = 1, MULTIEXP_TABLE = 2 };
+};
+
+#endif /*_TABLEFILE_H_*/
@@ -0,0 +1,95 @@
+#ifndef _TABLEREGISTRY_H_
+#define _TABLEREGISTRY_H_
+
+#include <NTL/ZZ.h>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+NTL_CLIENT
+
+/*! \brief Process-wide registry of precomputed tables, keyed by a list of
+ * numbers (typically the group modulus followed by the base values).
+ *
+ * The registry is read-mostly: tables are built once, when the first
+ * program using a given base is compiled, and then found by every later
+ * Environment in every thread.  Readers grab the current snapshot of the
+ * map without taking the writer lock; writers copy the map, add to the
+ * copy, and publish it.
+ */
+template <class T>
+class TableRegistry : private boost::noncopyable {
+	public:
+		typedef vector<ZZ> key_t;
+		typedef boost::shared_ptr<const T> value_ptr;
+
+		TableRegistry() : snapshot(new map_t()) {}
+
+		/*! returns the table registered under key, or an empty pointer */
+		value_ptr find(const key_t &key) const {
+			snapshot_ptr s = boost::atomic_load(&snapshot);
+			pair<typename map_t::const_iterator,
+				 typename map_t::const_iterator> r =
+				s->equal_range(hashKey(key));
+			for (typename map_t::const_iterator it = r.first;
+				 it != r.second; ++it) {
+				if (it->second.first == key)
+					return it->second.second;
+			}
+			return value_ptr();
+		}
+
+		/*! registers table under key, replacing any previous table (which
+		 * stays alive for as long as someone still holds it) */
+		void insert(const key_t &key, const value_ptr &table) {
+			boost::mutex::scoped_lock l(writeLock);
+			boost::shared_ptr<map_t> s(new map_t(*snapshot));
+			size_t h = hashKey(key);
+			pair<typename map_t::iterator, typename map_t::iterator> r =
+				s->equal_range(h);
+			for (typename map_t::iterator it = r.first; it != r.second; ++it) {
+				if (it->second.first == key) {
+					s->erase(it);
+					break;
+				}
+			}
+			s->insert(make_pair(h, make_pair(key, table)));
+			boost::atomic_store(&snapshot, snapshot_ptr(s));
+		}
+
+		void clear() {
+			boost::mutex::scoped_lock l(writeLock);
+			boost::atomic_store(&snapshot, snapshot_ptr(new map_t()));
+		}
+
+		size_t size() const { return boost::atomic_load(&snapshot)->size(); }
+
+		/*! everything currently registered */
+		vector<pair<key_t, value_ptr> > entries() const {
+			snapshot_ptr s = boost::atomic_load(&snapshot);
+			vector<pair<key_t, value_ptr> > r;
+			for (typename map_t::const_iterator it = s->begin();
+				 it != s->end(); ++it)
+				r.push_back(it->second);
+			return r;
+		}
+
+		static size_t hashKey(const key_t &key) {
+			size_t h = key.size();
+			for (unsigned i = 0; i < key.size(); i++)
+				h = HashLimbs(key[i], h);
+			return h;
+		}
+
+	private:
+		typedef boost::unordered_multimap<size_t, pair<key_t, value_ptr> >
+			map_t;
+		typedef boost::shared_ptr<const map_t> snapshot_ptr;
+
+		snapshot_ptr snapshot;
+		boost::mutex writeLock;
+};
+
+#endif /*_TABLEREGISTRY_H_*/
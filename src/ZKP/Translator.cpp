@@ -176,7 +176,7 @@ void Translator::describeRange(ASTExprPtr x, ASTIdentifierLitPtr group,
 		c.left = nameNode(cName);	
 		// XXX: this could probably be optimized
 		int i = 0;
-		for (variable_map::iterator it = env.generators.begin();
+		for (variable_map::const_iterator it = env.generators.begin();
 									it != env.generators.end(); ++it) {
 				// if we found a generator of the group, use it
 				if (env.varTypes.at(it->first).group == grpName){
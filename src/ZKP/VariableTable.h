@@ -0,0 +1,173 @@
+#ifndef _VARIABLETABLE_H_
+#define _VARIABLETABLE_H_
+
+#include <NTL/ZZ.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/split_member.hpp>
+
+NTL_CLIENT
+
+/*! \brief The values of a program's variables, kept in a vector indexed
+ * by slot.
+ *
+ * Every name gets a slot the first time it is used, and keeps it.  The
+ * names used by a program are given slots when it is compiled (see
+ * ProofPlan), and the name table is shared by every copy of the
+ * compiled Environment (it is only copied if one of them adds a new
+ * name), so at runtime a copy just holds its own vector of values.
+ * The prover and verifier work on slots; the string functions (at,
+ * operator[], count, erase) are for callers that look variables up by
+ * name, and behave like those of a variable_map.
+ *
+ * Must be included after MAP_TYPE is defined (see Environment.h).
+ */
+class VariableTable {
+	public:
+		typedef MAP_TYPE<string, ZZ> map_t; // i.e., variable_map
+
+		VariableTable() : names(new Names()), present(0) {}
+		VariableTable(const map_t &m) : names(new Names()), present(0)
+			{ *this = m; }
+
+		/*! forgets all values (but keeps the slots) and then stores m */
+		VariableTable& operator=(const map_t &m) {
+			clearValues();
+			for (map_t::const_iterator it = m.begin();
+				 it != m.end(); ++it)
+				(*this)[it->first] = it->second;
+			return *this;
+		}
+
+		/*! all values that are set, by name */
+		operator map_t() const {
+			map_t m;
+			for (unsigned s = 0; s < vals.size(); s++)
+				if (isSet[s])
+					m[name(s)] = vals[s];
+			return m;
+		}
+
+		// slots
+
+		/*! the slot for name, giving it a new one if it has none */
+		unsigned slot(const string &name) {
+			MAP_TYPE<string, unsigned>::const_iterator it =
+				names->index.find(name);
+			if (it != names->index.end())
+				return it->second;
+			if (!names.unique())
+				names.reset(new Names(*names));
+			unsigned s = names->names.size();
+			names->names.push_back(name);
+			names->index[name] = s;
+			vals.resize(s + 1);
+			isSet.resize(s + 1, 0);
+			return s;
+		}
+
+		/*! the slot for name, or -1 if it has none */
+		int findSlot(const string &name) const {
+			MAP_TYPE<string, unsigned>::const_iterator it =
+				names->index.find(name);
+			return it == names->index.end() ? -1 : (int) it->second;
+		}
+
+		size_t slotCount() const { return names->names.size(); }
+		const string& name(unsigned s) const { return names->names[s]; }
+		bool has(unsigned s) const { return s < isSet.size() && isSet[s]; }
+
+		/*! the value in slot s, which must be set */
+		const ZZ& value(unsigned s) const {
+			if (!has(s))
+				throw std::out_of_range("VariableTable::value");
+			return vals[s];
+		}
+
+		/*! the value in slot s, to be assigned to: marks it set */
+		ZZ& store(unsigned s) {
+			if (s >= vals.size()) {
+				vals.resize(slotCount());
+				isSet.resize(slotCount(), 0);
+			}
+			if (!isSet[s]) {
+				isSet[s] = 1;
+				present++;
+			}
+			return vals[s];
+		}
+
+		/*! all values, by slot (unset slots hold garbage) */
+		const vector<ZZ>& values() const { return vals; }
+
+		// names
+
+		size_t size() const { return present; }
+		bool empty() const { return present == 0; }
+
+		size_t count(const string &name) const {
+			int s = findSlot(name);
+			return s >= 0 && has(s);
+		}
+
+		const ZZ& at(const string &name) const {
+			int s = findSlot(name);
+			if (s < 0 || !has(s))
+				throw std::out_of_range("VariableTable::at: " + name);
+			return vals[s];
+		}
+
+		ZZ& operator[](const string &name) { return store(slot(name)); }
+
+		size_t erase(const string &name) {
+			int s = findSlot(name);
+			if (s < 0 || !has(s))
+				return 0;
+			isSet[s] = 0;
+			present--;
+			return 1;
+		}
+
+		/*! forgets all values, but keeps the slots */
+		void clearValues() {
+			isSet.assign(isSet.size(), 0);
+			present = 0;
+		}
+
+		/*! forgets all values and slots */
+		void clear() {
+			names.reset(new Names());
+			vals.clear();
+			isSet.clear();
+			present = 0;
+		}
+
+	private:
+		struct Names {
+			vector<string> names;
+			MAP_TYPE<string, unsigned> index;
+		};
+
+		friend class boost::serialization::access;
+		template <class Archive>
+		void save(Archive& ar, const unsigned int ver) const {
+			map_t m = *this;
+			ar & boost::serialization::make_nvp("variables", m);
+		}
+		template <class Archive>
+		void load(Archive& ar, const unsigned int ver) {
+			map_t m;
+			ar & boost::serialization::make_nvp("variables", m);
+			*this = m;
+		}
+		BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+		boost::shared_ptr<Names> names;
+		vector<ZZ> vals;
+		vector<char> isSet;
+		size_t present;
+};
+
+#endif /*_VARIABLETABLE_H_*/
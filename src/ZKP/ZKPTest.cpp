@@ -12,6 +12,7 @@
 #include "ForExpander.h"
 #include "ConstantSub.h"
 #include "ConstantProp.h"
+#include "ProgramFile.h"
 
 
 #include <typeinfo>
@@ -54,6 +55,7 @@ void setupEnvironment(Environment &e, const string& fname) {
 		e.variables["t"] = secrets[1];
 		e.variables["sk_u"] = secrets[2];
 		e.variables["J"] = to_ZZ(51);
+		e.variables["R"] = cashG->randomExponent();
 
 	} else if (fname.find("multiplication.txt") != string::npos) {
 
@@ -102,6 +104,8 @@ int main(int argc, char** argv) {
 		("expand,e", "expand for-loops")
 		("compute,c", "compute := lines")
 		("interpret,i", "run the Interpreter on this program")
+		("save-compiled,s", po::value<string>(), 
+		 "check the program and save it in compiled form to this file")
 		("input-file,f", po::value<string>(), "ZKP file to test")
 		;
 	po::positional_options_description p;
@@ -116,6 +120,17 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 		
+	if (vm.count("save-compiled")) {
+		try {
+			ProgramFile::save(vm["save-compiled"].as<string>(),
+							  vm["input-file"].as<string>());
+		} catch (CashException &e) {
+			cout << e.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	ifstream ifs(vm["input-file"].as<string>().c_str());
 
 	try { 
@@ -155,7 +170,7 @@ int main(int argc, char** argv) {
 
 				//GroupIdentifier groupGuy(e);
 				//groupGuy.apply(n);	
-				for (variable_type_map::iterator it = e.varTypes.begin();
+				for (variable_type_map::const_iterator it = e.varTypes.begin();
 					 it != e.varTypes.end(); ++it) {
 					cout << it->first << " " << it->second.group << endl;
 				}
@@ -164,13 +179,14 @@ int main(int argc, char** argv) {
 				binder.apply(n);
 				ComputationVisitor cv(e);
 				cv.apply(n);
-				for (variable_type_map::iterator it = e.varTypes.begin();
+				for (variable_type_map::const_iterator it = e.varTypes.begin();
 						it != e.varTypes.end(); ++it) {
 					cout << it->first << " " << it->second.group << endl;
 				}
-				for (variable_map::iterator it = e.variables.begin();
-						it != e.variables.end(); ++it) {
-					cout << it->first << " " << it->second << endl;
+				for (unsigned s = 0; s < e.variables.slotCount(); s++) {
+					if (e.variables.has(s))
+						cout << e.variables.name(s) << " " 
+							 << e.variables.value(s) << endl;
 				}
 			}
 			if (vm.count("interpret")) {
@@ -30,7 +30,8 @@ struct interpreter_env {
 		printTimer("prover.check");
 
 		startTimer();
-		prover.compute(env.groups, env.variables);
+		variable_map vars = env.variables;
+		prover.compute(env.groups, vars);
 		printTimer("prover.compute");
 
 		startTimer();
@@ -106,6 +107,7 @@ struct ecash_env : public interpreter_env {
 		env.variables["t"] = secrets[1];
 		env.variables["sk_u"] = secrets[2];
 		env.variables["J"] = to_ZZ(51);
+		env.variables["R"] = cashG->randomExponent();
 		env.variables["W"] = to_ZZ(power(2, 6));
 		env.variables["zero"] = to_ZZ(0);
 	}